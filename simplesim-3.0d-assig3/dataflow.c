@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "instr.h"
+#include "decode.def"
+
+#include "dataflow.h"
+
+//memory dependences are tracked per aligned word
+#define DF_GRAIN_SHIFT 2
+
+//empty entry of the memory table, not a word address
+#define DF_NO_GRAIN ((md_addr_t)-1)
+
+//the analysis keeps a column of times per window size, the last column is
+//the unbounded window of the dataflow limit; a time is the cycle a value is
+//ready or an instruction retires, the first instruction starts at cycle 0
+struct dataflow
+{
+  int ncols;                   //window sizes analyzed, and the unbounded one
+  int windows[DATAFLOW_MAX_WINDOWS];
+  int lat[NUM_FU_CLASSES];
+
+  //cycle each register is ready, by register then column
+  counter_t* reg_ready;
+
+  //retire cycles of the last windows[w] instructions of each bounded window,
+  //instruction i at i % windows[w]
+  counter_t* retire[DATAFLOW_MAX_WINDOWS];
+
+  //retire cycle of the last instruction, in program order, by column; it is
+  //the number of cycles the instructions so far take
+  counter_t cycles[DATAFLOW_MAX_WINDOWS + 1];
+
+  counter_t count;             //instructions analyzed
+
+  //cycle each word stored to is ready, an open-addressing table of the word
+  //addresses and a row of times per word
+  md_addr_t* mem_grain;
+  counter_t* mem_ready;
+  int mem_size;                //entries, a power of two
+  int mem_used;
+};
+
+static int mem_hash(dataflow_t* df, md_addr_t grain) {
+  return (int)((grain * 2654435761u) & (df->mem_size - 1));
+}
+
+//finds the entry of a word, or the empty entry it goes to
+static int mem_find(dataflow_t* df, md_addr_t grain) {
+  int i = mem_hash(df, grain);
+
+  while (df->mem_grain[i] != DF_NO_GRAIN && df->mem_grain[i] != grain)
+    i = (i + 1) & (df->mem_size - 1);
+  return i;
+}
+
+static void mem_alloc(dataflow_t* df, int size) {
+  int i;
+
+  df->mem_size = size;
+  df->mem_used = 0;
+  df->mem_grain = (md_addr_t*)malloc(size * sizeof(md_addr_t));
+  df->mem_ready = (counter_t*)calloc(size * df->ncols, sizeof(counter_t));
+  if (!df->mem_grain || !df->mem_ready)
+    fatal("out of virtual memory");
+  for (i = 0; i < size; i++)
+    df->mem_grain[i] = DF_NO_GRAIN;
+}
+
+//doubles the memory table, keeping it at most half full
+static void mem_grow(dataflow_t* df) {
+  md_addr_t* old_grain = df->mem_grain;
+  counter_t* old_ready = df->mem_ready;
+  int old_size = df->mem_size;
+  int i, j, w;
+
+  mem_alloc(df, 2 * old_size);
+  for (i = 0; i < old_size; i++) {
+    if (old_grain[i] == DF_NO_GRAIN)
+      continue;
+    j = mem_find(df, old_grain[i]);
+    df->mem_grain[j] = old_grain[i];
+    for (w = 0; w < df->ncols; w++)
+      df->mem_ready[j * df->ncols + w] = old_ready[i * df->ncols + w];
+    df->mem_used++;
+  }
+  free(old_grain);
+  free(old_ready);
+}
+
+//times of the word, NULL if it was never stored to
+static counter_t* mem_lookup(dataflow_t* df, md_addr_t grain) {
+  int i = mem_find(df, grain);
+
+  return df->mem_grain[i] == DF_NO_GRAIN ? NULL
+                                         : &df->mem_ready[i * df->ncols];
+}
+
+//times of the word, added if it was never stored to
+static counter_t* mem_insert(dataflow_t* df, md_addr_t grain) {
+  int i = mem_find(df, grain);
+
+  if (df->mem_grain[i] == DF_NO_GRAIN) {
+    if (2 * (df->mem_used + 1) > df->mem_size) {
+      mem_grow(df);
+      i = mem_find(df, grain);
+    }
+    df->mem_grain[i] = grain;
+    df->mem_used++;
+  }
+  return &df->mem_ready[i * df->ncols];
+}
+
+dataflow_t* dataflow_create(const int* windows, int nwindows,
+                            const int lat[NUM_FU_CLASSES]) {
+  dataflow_t* df;
+  int i;
+
+  if (nwindows < 0 || nwindows > DATAFLOW_MAX_WINDOWS)
+    fatal("at most %d window sizes are analyzed", DATAFLOW_MAX_WINDOWS);
+  for (i = 0; i < NUM_FU_CLASSES; i++)
+    if (lat[i] < 1)
+      fatal("dataflow latencies must be positive");
+
+  df = (dataflow_t*)calloc(1, sizeof(dataflow_t));
+  if (!df)
+    fatal("out of virtual memory");
+  df->ncols = nwindows + 1;
+  for (i = 0; i < NUM_FU_CLASSES; i++)
+    df->lat[i] = lat[i];
+  for (i = 0; i < nwindows; i++) {
+    if (windows[i] < 1)
+      fatal("dataflow window sizes must be positive");
+    df->windows[i] = windows[i];
+    df->retire[i] = (counter_t*)calloc(windows[i], sizeof(counter_t));
+    if (!df->retire[i])
+      fatal("out of virtual memory");
+  }
+
+  df->reg_ready = (counter_t*)calloc(MD_TOTAL_REGS * df->ncols,
+                                     sizeof(counter_t));
+  if (!df->reg_ready)
+    fatal("out of virtual memory");
+  mem_alloc(df, 4096);
+  return df;
+}
+
+void dataflow_free(dataflow_t* df) {
+  int i;
+
+  for (i = 0; i < df->ncols - 1; i++)
+    free(df->retire[i]);
+  free(df->reg_ready);
+  free(df->mem_grain);
+  free(df->mem_ready);
+  free(df);
+}
+
+void dataflow_push(dataflow_t* df, const trace_instr_t* instr) {
+  enum md_opcode op = (enum md_opcode)instr->op;
+  int lat = df->lat[MD_OP_FUCLASS(op)];
+  int is_load = (MD_OP_FLAGS(op) & F_LOAD) != 0;
+  int is_store = (MD_OP_FLAGS(op) & F_STORE) != 0;
+  md_addr_t first = 0, last = 0, grain;
+  counter_t ready, complete[DATAFLOW_MAX_WINDOWS + 1];
+  counter_t* times;
+  int i, w, slot = 0;
+
+  if (is_load || is_store) {
+    first = instr->addr >> DF_GRAIN_SHIFT;
+    last = (instr->addr + MAX(instr->mem_size, 1) - 1) >> DF_GRAIN_SHIFT;
+  }
+
+  for (w = 0; w < df->ncols; w++) {
+    //the instruction enters a bounded window once the instruction that many
+    //older retired
+    ready = 0;
+    if (w < df->ncols - 1) {
+      slot = (int)(df->count % df->windows[w]);
+      if (df->count >= df->windows[w])
+        ready = df->retire[w][slot];
+    }
+
+    //it waits for its source registers, the zero register is always ready
+    for (i = 0; i < 3; i++)
+      if (instr->r_in[i] != DNA && instr->r_in[i] != MD_REG_ZERO)
+        ready = MAX(ready, df->reg_ready[instr->r_in[i] * df->ncols + w]);
+
+    //a load waits for the stores to the words it reads
+    if (is_load)
+      for (grain = first; grain <= last; grain++)
+        if ((times = mem_lookup(df, grain)) != NULL)
+          ready = MAX(ready, times[w]);
+
+    complete[w] = ready + lat;
+    for (i = 0; i < 2; i++)
+      if (instr->r_out[i] != DNA && instr->r_out[i] != MD_REG_ZERO)
+        df->reg_ready[instr->r_out[i] * df->ncols + w] = complete[w];
+
+    //instructions retire in program order
+    df->cycles[w] = MAX(df->cycles[w], complete[w]);
+    if (w < df->ncols - 1)
+      df->retire[w][slot] = df->cycles[w];
+  }
+
+  //the words a store writes are ready when it completes
+  if (is_store) {
+    for (grain = first; grain <= last; grain++) {
+      times = mem_insert(df, grain);
+      for (w = 0; w < df->ncols; w++)
+        times[w] = complete[w];
+    }
+  }
+
+  df->count++;
+}
+
+void dataflow_reg_stats(dataflow_t* df, struct stat_sdb_t* sdb) {
+  char name[64], desc[128], formula[128];
+  int w;
+
+  for (w = 0; w < df->ncols - 1; w++) {
+    sprintf(name, "ilp_cycles_w%d", df->windows[w]);
+    sprintf(desc, "cycles of the dataflow limit with a window of %d insts",
+            df->windows[w]);
+    stat_reg_counter(sdb, name, desc, &df->cycles[w], 0, NULL);
+    sprintf(formula, "sim_num_insn / ilp_cycles_w%d", df->windows[w]);
+    sprintf(name, "ilp_IPC_w%d", df->windows[w]);
+    sprintf(desc, "IPC of the dataflow limit with a window of %d insts",
+            df->windows[w]);
+    stat_reg_formula(sdb, name, desc, formula, NULL);
+  }
+  stat_reg_counter(sdb, "ilp_crit_path",
+                   "critical path of the dataflow graph (cycles)",
+                   &df->cycles[df->ncols - 1], 0, NULL);
+  stat_reg_formula(sdb, "ilp_IPC_dataflow",
+                   "IPC of the dataflow limit with an unbounded window",
+                   "sim_num_insn / ilp_crit_path", NULL);
+}
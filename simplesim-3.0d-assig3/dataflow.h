@@ -0,0 +1,34 @@
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+
+#include "host.h"
+#include "machine.h"
+#include "stats.h"
+#include "instr.h"
+
+//most instruction window sizes analyzed at once
+#define DATAFLOW_MAX_WINDOWS 16
+
+//limit study of the executed instructions: each instruction executes as soon
+//as the instructions producing its register and memory operands are done,
+//with perfect branch prediction and unlimited functional units, within a
+//window of the given number of instructions that retire in order, and with
+//no window at all for the dataflow limit; one pass times all the windows
+typedef struct dataflow dataflow_t;
+
+//creates an analysis for the window sizes windows[0..nwindows-1], an
+//instruction of functional unit class c takes lat[c] cycles
+extern dataflow_t* dataflow_create(const int* windows, int nwindows,
+                                   const int lat[NUM_FU_CLASSES]);
+
+//frees an analysis
+extern void dataflow_free(dataflow_t* df);
+
+//provides the next executed instruction to the analysis
+extern void dataflow_push(dataflow_t* df, const trace_instr_t* instr);
+
+//registers the cycles and the IPC of each window, and the critical path and
+//IPC of the dataflow limit; sim_num_insn has to be registered first
+extern void dataflow_reg_stats(dataflow_t* df, struct stat_sdb_t* sdb);
+
+#endif
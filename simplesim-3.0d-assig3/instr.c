@@ -5,76 +5,181 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
-
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
 #include "instr.h"
 
+//bytes in a chunk, a multiple of the page size as INSTR_TRACE_SIZE is
+#define INSTR_CHUNK_BYTES (INSTR_TRACE_SIZE * sizeof(trace_instr_t))
+
+//register numbers and opcodes have to fit in the compact records
+typedef char trace_regs_fit[(MD_TOTAL_REGS <= SCHAR_MAX) ? 1 : -1];
+typedef char trace_ops_fit[(OP_MAX <= USHRT_MAX) ? 1 : -1];
+
 //prints a single instruction
-static void print_tom_instr(instruction_t* instr) {
+static void print_tom_instr(trace_instr_t* instr, tom_timing_t* timing) {
 
   md_print_insn(instr->inst, instr->pc, stdout);
-  myfprintf(stdout, "\t%d\t%d\t%d\t%d\n", 
-	    instr->tom_dispatch_cycle,
-	    instr->tom_issue_cycle,
-	    instr->tom_execute_cycle,
-	    instr->tom_cdb_cycle);
+  myfprintf(stdout, "\t%n\t%n\t%n\t%n\n", 
+	    timing->dispatch,
+	    timing->issue,
+	    timing->execute,
+	    timing->cdb);
+}
+
+
+//creates an empty trace, in memory if fname is NULL, otherwise backed by
+//the scratch file fname; instruction i is stored at index i, its timing is
+//kept as well if keep_timing is set
+instruction_trace_t* create_trace(char* fname, int keep_timing) {
+
+  instruction_trace_t* trace = calloc(1, sizeof(instruction_trace_t));
+  if (trace == NULL)
+    fatal("out of virtual memory");
+
+  trace->keep_timing = keep_timing;
+
+  trace->fd = -1;
+  if (fname != NULL) {
+    trace->fd = open(fname, O_RDWR|O_CREAT|O_TRUNC, 0600);
+    if (trace->fd < 0)
+      fatal("cannot create trace file `%s'", fname);
+    //the file is only scratch space, it goes away with the simulator
+    unlink(fname);
+  }
+
+  //skip the first entry
+  trace->size = 1;
+  return trace;
 }
 
+//frees the trace and its scratch file
+void free_trace(instruction_trace_t* trace) {
+
+  counter_t i;
+
+  for (i = 0; i < trace->num_chunks; i++) {
+    if (trace->fd >= 0)
+      munmap(trace->chunks[i], INSTR_CHUNK_BYTES);
+    else
+      free(trace->chunks[i]);
+    if (trace->keep_timing)
+      free(trace->timing[i]);
+  }
+  if (trace->fd >= 0)
+    close(trace->fd);
+  free(trace->chunks);
+  free(trace->timing);
+  free(trace);
+}
+
+//adds a chunk at the end of the trace
+static void add_chunk(instruction_trace_t* trace) {
+
+  trace_instr_t* chunk;
+
+  //grow the chunk directories
+  if (trace->num_chunks == trace->max_chunks) {
+    trace->max_chunks = trace->max_chunks ? 2 * trace->max_chunks : 64;
+    trace->chunks = realloc(trace->chunks,
+                            trace->max_chunks * sizeof(trace_instr_t*));
+    if (trace->chunks == NULL)
+      fatal("out of virtual memory");
+    if (trace->keep_timing) {
+      trace->timing = realloc(trace->timing,
+                              trace->max_chunks * sizeof(tom_timing_t*));
+      if (trace->timing == NULL)
+        fatal("out of virtual memory");
+    }
+  }
+
+  //the timing of the chunk, always in memory
+  if (trace->keep_timing) {
+    trace->timing[trace->num_chunks] =
+      calloc(INSTR_TRACE_SIZE, sizeof(tom_timing_t));
+    if (trace->timing[trace->num_chunks] == NULL)
+      fatal("out of virtual memory");
+  }
+
+  if (trace->fd >= 0) {
+    off_t offset = (off_t)trace->num_chunks * INSTR_CHUNK_BYTES;
+
+    //extend the scratch file, new pages read as zero
+    if (ftruncate(trace->fd, offset + INSTR_CHUNK_BYTES) != 0)
+      fatal("cannot extend trace file to %n chunks", trace->num_chunks + 1);
+    chunk = mmap(NULL, INSTR_CHUNK_BYTES, PROT_READ|PROT_WRITE, MAP_SHARED,
+                 trace->fd, offset);
+    if (chunk == MAP_FAILED)
+      fatal("cannot map trace file chunk %n", trace->num_chunks);
+  } else {
+    chunk = calloc(INSTR_TRACE_SIZE, sizeof(trace_instr_t));
+    if (chunk == NULL)
+      fatal("out of virtual memory");
+  }
+  trace->chunks[trace->num_chunks++] = chunk;
+}
 
 //prints all the instructions inside the given trace for pipeline
-void print_all_instr(instruction_trace_t* trace, int sim_num_insn) {
+void print_all_instr(instruction_trace_t* trace, counter_t sim_num_insn) {
 
+  counter_t index;
+
+  assert(trace->keep_timing);
   fprintf(stdout, "TOMASULO TABLE\n");
 
-  int printed_count = 0;
-  int index = 1;
-  while (true) {
- 
-     if (1) { // if (printed_count > 9999900) {
-        print_tom_instr(&trace->table[index]);
-     }
-
-     printed_count++;
-
-     if (printed_count == sim_num_insn)
-        break;
-      
-     if (++index == INSTR_TRACE_SIZE) {
-        trace = trace->next;
-	index = 0;
-	if (trace == NULL)
-	   break;
-     }
-   }
+  for (index = 1; index <= sim_num_insn && index < trace->size; index++)
+    print_tom_instr(get_instr(trace, index), get_timing(trace, index));
 }
 
 //inserts the instruction into the trace
-void put_instr(instruction_trace_t* trace, instruction_t* instr) {
+void put_instr(instruction_trace_t* trace, const trace_instr_t* instr) {
 
-  while ((trace->size == INSTR_TRACE_SIZE) && (trace->next != NULL)) {
-    trace = trace->next;
-  }
-  
-  if (trace->size == INSTR_TRACE_SIZE) {
-      
-     trace->next = malloc(sizeof(instruction_trace_t));
-     assert(trace->next != NULL);
-     //printf("trace=%p\n", trace);
-     trace = trace->next;
-     memset(trace, 0, sizeof(instruction_trace_t));
-  }
-  trace->table[trace->size++] = *instr;
+  if (trace->size >= trace->num_chunks * INSTR_TRACE_SIZE)
+    add_chunk(trace);
+
+  *get_instr(trace, trace->size++) = *instr;
 } 
 
 //gets the instruction at the index, from the trace
-instruction_t* get_instr(instruction_trace_t* trace, int index) {
+trace_instr_t* get_instr(const instruction_trace_t* trace, counter_t index) {
 
-  while (index >= INSTR_TRACE_SIZE) {
-     index -= INSTR_TRACE_SIZE;
-     trace = trace->next;
+  assert(index >= 0 && index < trace->num_chunks * INSTR_TRACE_SIZE);
 
-     assert(trace != NULL);
-  }
+  return &trace->chunks[index / INSTR_TRACE_SIZE][index % INSTR_TRACE_SIZE];
+}
 
-  return &trace->table[index];
+//gets the timing of the instruction at the index, from a trace keeping it
+tom_timing_t* get_timing(instruction_trace_t* trace, counter_t index) {
+
+  assert(trace->keep_timing);
+  assert(index >= 0 && index < trace->num_chunks * INSTR_TRACE_SIZE);
+
+  return &trace->timing[index / INSTR_TRACE_SIZE][index % INSTR_TRACE_SIZE];
 }
 
+//copies the trace record of the instruction at the index into an instruction
+//record of the pipeline, with no operand tags and no timing
+void unpack_instr(instruction_t* instr, const trace_instr_t* t_instr,
+                  counter_t index) {
+
+  instr->index = index;
+  instr->inst = t_instr->inst;
+  instr->pc = t_instr->pc;
+  instr->op = (enum md_opcode)t_instr->op;
+  instr->r_out[0] = t_instr->r_out[0];
+  instr->r_out[1] = t_instr->r_out[1];
+  instr->r_in[0] = t_instr->r_in[0];
+  instr->r_in[1] = t_instr->r_in[1];
+  instr->r_in[2] = t_instr->r_in[2];
+  instr->Q[0] = instr->Q[1] = instr->Q[2] = TOM_NO_TAG;
+  instr->tom_dispatch_cycle = 0;
+  instr->tom_issue_cycle = 0;
+  instr->tom_execute_cycle = 0;
+  instr->tom_cdb_cycle = 0;
+}
@@ -2,12 +2,20 @@
 #ifndef INSTR_H
 #define INSTR_H
 
+#include "host.h"
 #include "machine.h"
 
+//tag of an instruction in flight in a Tomasulo pipeline: its slot in the
+//pipeline window, and the generation of the slot so the tag of an
+//instruction that left never matches the instruction reusing its slot
+typedef int tom_tag_t;
+
+#define TOM_NO_TAG 0
+
 //data structure representing each instruction
 typedef struct my_instruction
 {
-  int index; //the unique index value of the instruction 
+  counter_t index; //the unique index value of the instruction 
              //it shows the order the instructions execute in
   md_inst_t inst;  
   int r_out[2]; //output registers
@@ -15,34 +23,83 @@ typedef struct my_instruction
   enum md_opcode op; //opcode
   md_addr_t pc; //program counter the instruction executes at
 
-  //the equivalents of Qj, Qk; these are pointers to the instructions producing the results
-  // for the input registers of this instruction
-  struct my_instruction * Q[3]; 
+  //the equivalents of Qj, Qk; these are the tags of the instructions producing the results
+  // for the input registers of this instruction, TOM_NO_TAG once they are ready
+  tom_tag_t Q[3]; 
 
   //Specify the cycle an instruction **entered** this stage
-  int tom_dispatch_cycle;  //dispatch
-  int tom_issue_cycle;     //issue
-  int tom_execute_cycle;   //execute
-  int tom_cdb_cycle;       //writeback via Common Data Bus (CDB)
+  tick_t tom_dispatch_cycle;  //dispatch
+  tick_t tom_issue_cycle;     //issue
+  tick_t tom_execute_cycle;   //execute
+  tick_t tom_cdb_cycle;       //writeback via Common Data Bus (CDB)
 
 }instruction_t;
 
+//compact record of an executed instruction in a trace, 24 bytes; its index
+//is its position in the trace, the Tomasulo pipeline keeps the operand tags
+//and the timing only for the instructions in flight
+typedef struct trace_instr
+{
+  md_inst_t inst;
+  md_addr_t pc;         //program counter the instruction executes at
+  md_addr_t addr;       //branch target if taken, or the address a load or
+                        //store accesses
+  unsigned short op;    //opcode, an enum md_opcode
+  signed char r_out[2]; //output registers, DNA if none
+  signed char r_in[3];  //input registers, DNA if none
+  unsigned char mem_size; //bytes a load or store accesses from addr
+}trace_instr_t;
+
+//cycles an instruction entered each stage of the Tomasulo pipeline
+typedef struct tom_timing
+{
+  tick_t dispatch;
+  tick_t issue;
+  tick_t execute;
+  tick_t cdb;
+}tom_timing_t;
+
 #define INSTR_TRACE_SIZE 16384
 
-typedef struct my_instruction_list
+//trace of executed instructions, stored in chunks of INSTR_TRACE_SIZE
+//records found through a chunk directory, in memory or in a memory-mapped
+//scratch file for traces larger than memory; the timing of the
+//instructions, if it is kept, is stored apart in memory
+typedef struct my_instruction_trace
 {
-  instruction_t table[INSTR_TRACE_SIZE];
-  int size;
-  struct my_instruction_list* next;
+  trace_instr_t** chunks; //chunk directory
+  tom_timing_t** timing;  //timing chunk directory
+  int keep_timing;        //true if the timing is kept
+  counter_t num_chunks;   //number of chunks allocated
+  counter_t max_chunks;   //size of the chunk directories
+  counter_t size;         //number of entries, including the unused entry 0
+  int fd;                 //scratch file descriptor, -1 if in memory
 }instruction_trace_t;
 
+//creates an empty trace, in memory if fname is NULL, otherwise backed by
+//the scratch file fname; instruction i is stored at index i, its timing is
+//kept as well if keep_timing is set
+extern instruction_trace_t* create_trace(char* fname, int keep_timing);
+
+//frees the trace and its scratch file
+extern void free_trace(instruction_trace_t* trace);
+
 //prints all the instructions inside the given trace
-extern void print_all_instr(instruction_trace_t* table, int sim_num_insn);
+extern void print_all_instr(instruction_trace_t* table, counter_t sim_num_insn);
 
 //inserts the instruction into the trace
-extern void put_instr(instruction_trace_t* trace, instruction_t* instr);
+extern void put_instr(instruction_trace_t* trace, const trace_instr_t* instr);
 
 //gets the instruction at the index, from the trace
-extern instruction_t* get_instr(instruction_trace_t* trace, int index);
+extern trace_instr_t* get_instr(const instruction_trace_t* trace,
+                                counter_t index);
+
+//gets the timing of the instruction at the index, from a trace keeping it
+extern tom_timing_t* get_timing(instruction_trace_t* trace, counter_t index);
+
+//copies the trace record of the instruction at the index into an instruction
+//record of the pipeline, with no operand tags and no timing
+extern void unpack_instr(instruction_t* instr, const trace_instr_t* t_instr,
+                         counter_t index);
 
 #endif
@@ -52,6 +52,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "host.h"
 #include "misc.h"
@@ -64,8 +67,12 @@
 #include "options.h"
 #include "stats.h"
 #include "sim.h"
+#include "bpred.h"
+#include "cache.h"
 
 #include "instr.h"
+#include "tomasulo.h"
+#include "dataflow.h"
 #include "decode.def"
 #include <assert.h>
 
@@ -90,9 +97,234 @@ static counter_t sim_num_refs = 0;
 static counter_t sim_num_tom_cycles = 0;
 /* ECE552 END */
 
+/* trace of the executed instructions, and of their Tomasulo timing if it is
+   printed, the option is none, mem, or the name of a scratch file to map the
+   trace to */
+static char *tom_trace_opt;
+static instruction_trace_t *tom_trace = NULL;
+
+/* print the Tomasulo table at the end of the simulation */
+static int tom_print;
+
+/* file the Tomasulo timing is logged to in program order, and the digest of
+   the timing, known once the pipeline drained */
+static char *tom_log_opt;
+static int tom_digest_valid = FALSE;
+static qword_t tom_timing_digest;
+
+/* Tomasulo pipeline options, the main pipeline and each configuration of a
+   sweep have their own; the branch predictor and the data caches are
+   configured as in sim-outorder */
+struct tom_opts_t
+{
+  tom_config_t config;		/* pipeline parameters */
+
+  char *pred_type;		/* branch predictor type */
+  int bimod_nelt;
+  int bimod_config[1];
+  int twolev_nelt;
+  int twolev_config[4];
+  int comb_nelt;
+  int comb_config[1];
+  int ras_size;
+  int btb_nelt;
+  int btb_config[2];
+
+  /* data caches the loads and stores in the LSQ access, and their memory */
+  char *dl1_opt;
+  int dl1_lat;
+  char *dl2_opt;
+  int dl2_lat;
+  int mem_nelt;
+  int mem_lat[2];
+  int mem_bus_width;
+  struct cache_t *dl2;
+};
+
+static struct tom_opts_t tom_opts = {
+  { /* ifq_size */TOM_DEFAULT_IFQ_SIZE,
+    /* rs_int_size */TOM_DEFAULT_RS_INT_SIZE,
+    /* rs_fp_size */TOM_DEFAULT_RS_FP_SIZE,
+    /* fu_int_size */TOM_DEFAULT_FU_INT_SIZE,
+    /* fu_fp_size */TOM_DEFAULT_FU_FP_SIZE,
+    /* fu_int_latency */TOM_DEFAULT_FU_INT_LATENCY,
+    /* fu_fp_latency */TOM_DEFAULT_FU_FP_LATENCY,
+    /* rob_size */TOM_DEFAULT_ROB_SIZE,
+    /* mispred_penalty */TOM_DEFAULT_MISPRED_PENALTY, /* bpred */NULL,
+    /* width */TOM_DEFAULT_WIDTH, /* issue_width */TOM_DEFAULT_ISSUE_WIDTH,
+    /* cdb_count */TOM_DEFAULT_CDB_COUNT, /* lsq_size */TOM_DEFAULT_LSQ_SIZE,
+    /* lsq_ports */TOM_DEFAULT_LSQ_PORTS, /* lsq_spec */TOM_DEFAULT_LSQ_SPEC,
+    /* dl1 */NULL },
+  /* pred_type */"bimod",
+  1, { /* bimod tbl size */2048 },
+  4, { /* l1size */1, /* l2size */1024, /* hist */8, /* xor */FALSE},
+  1, { /* meta_table_size */1024 },
+  /* ras_size */8,
+  2, { /* nsets */512, /* assoc */4 },
+  /* dl1_opt */"none", /* dl1_lat */1, /* dl2_opt */"none", /* dl2_lat */6,
+  2, { /* lat to first chunk */18, /* lat between remaining chunks */2 },
+  /* mem_bus_width */8, /* dl2 */NULL
+};
+
+/* the main Tomasulo pipeline, timed as the instructions execute */
+static tom_t *tom = NULL;
+
+/* options of the pipeline the current thread times, for the cache miss
+   handlers */
+static __thread struct tom_opts_t *tom_cur_opts = NULL;
+
+/* file of the configurations to time over the trace once the simulation
+   ends, one line of -tom:* options each, and the threads timing them */
+static char *tom_sweep_opt;
+static int tom_sweep_threads;
+
+/* dataflow limit study of the executed instructions, the window sizes it
+   times and the latency of each functional unit class but FUClass_NA, by
+   default those of sim-outorder */
+static int ilp_opt;
+static int ilp_nwindows = 9;
+static int ilp_windows[DATAFLOW_MAX_WINDOWS] =
+  { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+static int ilp_nlat = NUM_FU_CLASSES - 1;
+static int ilp_lat[NUM_FU_CLASSES - 1] =
+  { /* IntALU */1, /* IntMULT */3, /* IntDIV */20, /* FloatADD */2,
+    /* FloatCMP */2, /* FloatCVT */2, /* FloatMULT */4, /* FloatDIV */12,
+    /* FloatSQRT */24, /* RdPort */1, /* WrPort */1 };
+static dataflow_t *ilp = NULL;
+
+#define TOM_MAX_SWEEP		256
+#define TOM_MAX_SWEEP_ARGS	256
+
+static int tom_nsweep = 0;
+static struct tom_opts_t tom_sweep[TOM_MAX_SWEEP];
+static char *tom_sweep_desc[TOM_MAX_SWEEP];
+static counter_t tom_sweep_cycles[TOM_MAX_SWEEP];
+
+/* next configuration of the sweep to time, and the PC the instructions of
+   the trace end at */
+static int tom_sweep_next;
+static pthread_mutex_t tom_sweep_lock = PTHREAD_MUTEX_INITIALIZER;
+static md_addr_t tom_sweep_end_pc;
+
 /* maximum number of inst's to execute */
 static unsigned int max_insts;
 
+/* register the Tomasulo pipeline options, their defaults are the current
+   values of the options TO */
+static void
+tom_reg_options(struct opt_odb_t *odb, struct tom_opts_t *to)
+{
+  opt_reg_int(odb, "-tom:ifqsize", "Tomasulo instruction queue size",
+	      &to->config.ifq_size, /* default */to->config.ifq_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:rs:int", "integer reservation stations",
+	      &to->config.rs_int_size, /* default */to->config.rs_int_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:rs:fp", "floating-point reservation stations",
+	      &to->config.rs_fp_size, /* default */to->config.rs_fp_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:fu:int", "integer functional units",
+	      &to->config.fu_int_size, /* default */to->config.fu_int_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:fu:fp", "floating-point functional units",
+	      &to->config.fu_fp_size, /* default */to->config.fu_fp_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:lat:int", "integer functional unit latency",
+	      &to->config.fu_int_latency,
+	      /* default */to->config.fu_int_latency,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:lat:fp", "floating-point functional unit latency",
+	      &to->config.fu_fp_latency, /* default */to->config.fu_fp_latency,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-tom:width",
+	      "Tomasulo fetch and dispatch width (insts/cycle)",
+	      &to->config.width, /* default */to->config.width,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:issue:width",
+	      "Tomasulo issue width (insts/cycle), 0 for no limit but the FUs",
+	      &to->config.issue_width, /* default */to->config.issue_width,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:cdbs", "Tomasulo common data buses",
+	      &to->config.cdb_count, /* default */to->config.cdb_count,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:rob",
+	      "Tomasulo reorder buffer size, 0 for none (branches never stall)",
+	      &to->config.rob_size, /* default */to->config.rob_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:mplat",
+	      "extra branch mis-prediction latency (with a ROB)",
+	      &to->config.mispred_penalty,
+	      /* default */to->config.mispred_penalty,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_string(odb, "-tom:bpred",
+		 "branch predictor type (with a ROB) "
+		 "{nottaken|taken|perfect|bimod|2lev|comb}",
+		 &to->pred_type, /* default */to->pred_type,
+		 /* print */TRUE, /* format */NULL);
+  opt_reg_int_list(odb, "-tom:bpred:bimod",
+		   "bimodal predictor config (<table size>)",
+		   to->bimod_config, to->bimod_nelt, &to->bimod_nelt,
+		   /* default */to->bimod_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+  opt_reg_int_list(odb, "-tom:bpred:2lev",
+		   "2-level predictor config "
+		   "(<l1size> <l2size> <hist_size> <xor>)",
+		   to->twolev_config, to->twolev_nelt, &to->twolev_nelt,
+		   /* default */to->twolev_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+  opt_reg_int_list(odb, "-tom:bpred:comb",
+		   "combining predictor config (<meta_table_size>)",
+		   to->comb_config, to->comb_nelt, &to->comb_nelt,
+		   /* default */to->comb_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+  opt_reg_int(odb, "-tom:bpred:ras",
+	      "return address stack size (0 for no return stack)",
+	      &to->ras_size, /* default */to->ras_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int_list(odb, "-tom:bpred:btb",
+		   "BTB config (<num_sets> <associativity>)",
+		   to->btb_config, to->btb_nelt, &to->btb_nelt,
+		   /* default */to->btb_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int(odb, "-tom:lsq",
+	      "Tomasulo load/store queue size, 0 for none (loads and stores "
+	      "use the integer FUs)",
+	      &to->config.lsq_size, /* default */to->config.lsq_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:lsq:ports",
+	      "loads and stores generating their address per cycle",
+	      &to->config.lsq_ports, /* default */to->config.lsq_ports,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_flag(odb, "-tom:lsq:spec",
+	       "loads pass older stores whose address is unknown",
+	       &to->config.lsq_spec, /* default */to->config.lsq_spec,
+	       /* print */TRUE, NULL);
+  opt_reg_string(odb, "-tom:cache:dl1",
+		 "l1 data cache config (with a LSQ), i.e., {<config>|none}, "
+		 "see sim-outorder", &to->dl1_opt, to->dl1_opt,
+		 /* print */TRUE, NULL);
+  opt_reg_int(odb, "-tom:cache:dl1lat",
+	      "l1 data cache hit latency (in cycles)",
+	      &to->dl1_lat, /* default */to->dl1_lat,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_string(odb, "-tom:cache:dl2",
+		 "l2 data cache config, i.e., {<config>|none}",
+		 &to->dl2_opt, to->dl2_opt, /* print */TRUE, NULL);
+  opt_reg_int(odb, "-tom:cache:dl2lat",
+	      "l2 data cache hit latency (in cycles)",
+	      &to->dl2_lat, /* default */to->dl2_lat,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int_list(odb, "-tom:mem:lat",
+		   "memory access latency (<first_chunk> <inter_chunk>)",
+		   to->mem_lat, to->mem_nelt, &to->mem_nelt, to->mem_lat,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+  opt_reg_int(odb, "-tom:mem:width", "memory access bus width (in bytes)",
+	      &to->mem_bus_width, /* default */to->mem_bus_width,
+	      /* print */TRUE, /* format */NULL);
+}
+
 /* register simulator-specific options */
 void
 sim_reg_options(struct opt_odb_t *odb)
@@ -110,13 +342,335 @@ sim_reg_options(struct opt_odb_t *odb)
 	       &max_insts, /* default */0,
 	       /* print */TRUE, /* format */NULL);
 
+  tom_reg_options(odb, &tom_opts);
+
+  opt_reg_string(odb, "-tom:trace",
+		 "keep a trace of the executed instructions (and their timing "
+		 "with -tom:print), i.e., {none|mem|<scratch file>}",
+		 &tom_trace_opt, "none", /* print */TRUE, NULL);
+  opt_reg_flag(odb, "-tom:print",
+	       "print the Tomasulo table of the trace at the end",
+	       &tom_print, /* default */FALSE, /* print */TRUE, NULL);
+  opt_reg_string(odb, "-tom:log",
+		 "log the Tomasulo timing of each instruction to this file in "
+		 "a compact binary form, decoded by tomlogdump, i.e., "
+		 "{none|<file>}",
+		 &tom_log_opt, "none", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-tom:sweep",
+		 "time the configurations of this file, one line of -tom:* "
+		 "options each, over the trace once the simulation ends and "
+		 "print their cycles (needs -tom:trace), i.e., {none|<file>}",
+		 &tom_sweep_opt, "none", /* print */TRUE, NULL);
+  opt_reg_int(odb, "-tom:sweep:threads",
+	      "threads timing the sweep, 0 for one per processor",
+	      &tom_sweep_threads, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_flag(odb, "-ilp",
+	       "time the dataflow limit of the executed instructions for "
+	       "each window size",
+	       &ilp_opt, /* default */FALSE, /* print */TRUE, NULL);
+  opt_reg_int_list(odb, "-ilp:windows",
+		   "window sizes of the dataflow limit (insts)",
+		   ilp_windows, DATAFLOW_MAX_WINDOWS, &ilp_nwindows,
+		   /* default */ilp_windows,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+  opt_reg_int_list(odb, "-ilp:lat",
+		   "dataflow limit latencies (<int alu> <int mult> <int div> "
+		   "<fp add> <fp cmp> <fp cvt> <fp mult> <fp div> <fp sqrt> "
+		   "<load> <store>)",
+		   ilp_lat, NUM_FU_CLASSES - 1, &ilp_nlat,
+		   /* default */ilp_lat,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+}
+
+/* mem access latency, assumed to not cross a page boundary */
+static unsigned int			/* total latency of access */
+tom_mem_access_latency(int blk_sz)	/* block size accessed */
+{
+  int width = tom_cur_opts->mem_bus_width;
+  int chunks = (blk_sz + (width - 1)) / width;
+
+  assert(chunks > 0);
+
+  return (/* first chunk latency */tom_cur_opts->mem_lat[0] +
+	  (/* remainder chunk latency */tom_cur_opts->mem_lat[1] * (chunks - 1)));
+}
+
+/* l1 data cache l1 block miss handler function */
+static unsigned int			/* latency of block access */
+tom_dl1_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
+		  md_addr_t baddr,	/* block address to access */
+		  int bsize,		/* size of block to access */
+		  struct cache_blk_t *blk, /* ptr to block in upper level */
+		  tick_t now)		/* time of access */
+{
+  unsigned int lat;
+
+  if (tom_cur_opts->dl2)
+    {
+      /* access next level of data cache hierarchy */
+      lat = cache_access(tom_cur_opts->dl2, cmd, baddr, NULL, bsize,
+			 /* now */now, /* pudata */NULL, /* repl addr */NULL);
+      if (cmd == Read)
+	return lat;
+      else
+	{
+	  /* FIXME: unlimited write buffers */
+	  return 0;
+	}
+    }
+  else
+    {
+      /* access main memory */
+      if (cmd == Read)
+	return tom_mem_access_latency(bsize);
+      else
+	{
+	  /* FIXME: unlimited write buffers */
+	  return 0;
+	}
+    }
+}
+
+/* l2 data cache block miss handler function */
+static unsigned int			/* latency of block access */
+tom_dl2_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
+		  md_addr_t baddr,	/* block address to access */
+		  int bsize,		/* size of block to access */
+		  struct cache_blk_t *blk, /* ptr to block in upper level */
+		  tick_t now)		/* time of access */
+{
+  /* this is a miss to the lowest level, so access main memory */
+  if (cmd == Read)
+    return tom_mem_access_latency(bsize);
+  else
+    {
+      /* FIXME: unlimited write buffers */
+      return 0;
+    }
+}
+
+/* check the Tomasulo pipeline options TO, and create the branch predictor
+   and the data caches they configure */
+static void
+tom_check_options(struct tom_opts_t *to)
+{
+  char name[128], c;
+  int nsets, bsize, assoc;
+
+  if (to->config.ifq_size < 1 || to->config.rs_int_size < 1
+      || to->config.rs_fp_size < 1 || to->config.fu_int_size < 1
+      || to->config.fu_fp_size < 1)
+    fatal("Tomasulo queue, reservation station and FU counts must be >= 1");
+  if (to->config.fu_int_latency < 1 || to->config.fu_fp_latency < 1)
+    fatal("Tomasulo functional unit latencies must be >= 1 cycle");
+  if (to->config.rob_size < 0)
+    fatal("Tomasulo ROB size must not be negative");
+  if (to->config.width < 1 || to->config.issue_width < 0)
+    fatal("Tomasulo dispatch width must be >= 1, issue width >= 0");
+  if (to->config.cdb_count < 1)
+    fatal("Tomasulo needs at least one CDB");
+  if (to->config.mispred_penalty < 0)
+    fatal("mis-prediction penalty must not be negative");
+
+  /* without a ROB branches are never predicted */
+  to->config.bpred = NULL;
+  if (to->config.rob_size == 0 || !mystricmp(to->pred_type, "perfect"))
+    ;
+  else if (!mystricmp(to->pred_type, "taken"))
+    to->config.bpred = bpred_create(BPredTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  else if (!mystricmp(to->pred_type, "nottaken"))
+    to->config.bpred = bpred_create(BPredNotTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  else if (!mystricmp(to->pred_type, "bimod"))
+    {
+      if (to->bimod_nelt != 1)
+	fatal("bad bimod predictor config (<table_size>)");
+      if (to->btb_nelt != 2)
+	fatal("bad btb config (<num_sets> <associativity>)");
+
+      to->config.bpred = bpred_create(BPred2bit,
+				      /* bimod table size */to->bimod_config[0],
+				      /* 2lev l1 size */0,
+				      /* 2lev l2 size */0,
+				      /* meta table size */0,
+				      /* history reg size */0,
+				      /* history xor address */0,
+				      /* btb sets */to->btb_config[0],
+				      /* btb assoc */to->btb_config[1],
+				      /* ret-addr stack size */to->ras_size);
+    }
+  else if (!mystricmp(to->pred_type, "2lev"))
+    {
+      if (to->twolev_nelt != 4)
+	fatal("bad 2-level pred config (<l1size> <l2size> <hist_size> <xor>)");
+      if (to->btb_nelt != 2)
+	fatal("bad btb config (<num_sets> <associativity>)");
+
+      to->config.bpred = bpred_create(BPred2Level,
+				      /* bimod table size */0,
+				      /* 2lev l1 size */to->twolev_config[0],
+				      /* 2lev l2 size */to->twolev_config[1],
+				      /* meta table size */0,
+				      /* history reg size */to->twolev_config[2],
+				      /* history xor address */to->twolev_config[3],
+				      /* btb sets */to->btb_config[0],
+				      /* btb assoc */to->btb_config[1],
+				      /* ret-addr stack size */to->ras_size);
+    }
+  else if (!mystricmp(to->pred_type, "comb"))
+    {
+      if (to->twolev_nelt != 4)
+	fatal("bad 2-level pred config (<l1size> <l2size> <hist_size> <xor>)");
+      if (to->bimod_nelt != 1)
+	fatal("bad bimod predictor config (<table_size>)");
+      if (to->comb_nelt != 1)
+	fatal("bad combining predictor config (<meta_table_size>)");
+      if (to->btb_nelt != 2)
+	fatal("bad btb config (<num_sets> <associativity>)");
+
+      to->config.bpred = bpred_create(BPredComb,
+				      /* bimod table size */to->bimod_config[0],
+				      /* l1 size */to->twolev_config[0],
+				      /* l2 size */to->twolev_config[1],
+				      /* meta table size */to->comb_config[0],
+				      /* history reg size */to->twolev_config[2],
+				      /* history xor address */to->twolev_config[3],
+				      /* btb sets */to->btb_config[0],
+				      /* btb assoc */to->btb_config[1],
+				      /* ret-addr stack size */to->ras_size);
+    }
+  else
+    fatal("cannot parse predictor type `%s'", to->pred_type);
+
+  if (to->config.lsq_size < 0)
+    fatal("Tomasulo LSQ size must not be negative");
+  if (to->config.lsq_ports < 1)
+    fatal("Tomasulo LSQ needs at least one port");
+
+  /* use a level 1 D-cache? */
+  if (!mystricmp(to->dl1_opt, "none"))
+    {
+      to->config.dl1 = NULL;
+
+      /* the level 2 D-cache cannot be defined */
+      if (mystricmp(to->dl2_opt, "none"))
+	fatal("the l1 data cache must defined if the l2 cache is defined");
+      to->dl2 = NULL;
+    }
+  else /* dl1 is defined */
+    {
+      if (to->config.lsq_size == 0)
+	fatal("the data caches need a LSQ, use `-tom:lsq'");
+      if (sscanf(to->dl1_opt, "%[^:]:%d:%d:%d:%c",
+		 name, &nsets, &bsize, &assoc, &c) != 5)
+	fatal("bad l1 D-cache parms: <name>:<nsets>:<bsize>:<assoc>:<repl>");
+      to->config.dl1 = cache_create(name, nsets, bsize, /* balloc */FALSE,
+				    /* usize */0, assoc, cache_char2policy(c),
+				    tom_dl1_access_fn,
+				    /* hit lat */to->dl1_lat);
+
+      /* is the level 2 D-cache defined? */
+      if (!mystricmp(to->dl2_opt, "none"))
+	to->dl2 = NULL;
+      else
+	{
+	  if (sscanf(to->dl2_opt, "%[^:]:%d:%d:%d:%c",
+		     name, &nsets, &bsize, &assoc, &c) != 5)
+	    fatal("bad l2 D-cache parms: "
+		  "<name>:<nsets>:<bsize>:<assoc>:<repl>");
+	  to->dl2 = cache_create(name, nsets, bsize, /* balloc */FALSE,
+				 /* usize */0, assoc, cache_char2policy(c),
+				 tom_dl2_access_fn, /* hit lat */to->dl2_lat);
+	}
+    }
+
+  if (to->dl1_lat < 1)
+    fatal("l1 data cache latency must be greater than zero");
+  if (to->dl2_lat < 1)
+    fatal("l2 data cache latency must be greater than zero");
+  if (to->mem_nelt != 2)
+    fatal("bad memory access latency (<first_chunk> <inter_chunk>)");
+  if (to->mem_lat[0] < 1 || to->mem_lat[1] < 1)
+    fatal("all memory access latencies must be greater than zero");
+  if (to->mem_bus_width < 1 || (to->mem_bus_width & (to->mem_bus_width-1)) != 0)
+    fatal("memory bus width must be positive non-zero and a power of two");
+}
+
+/* read the configurations of the sweep from the file FNAME, each line holds
+   -tom:* options applied over the options of the main pipeline */
+static void
+tom_read_sweep(char *fname)
+{
+  char line[1024], *p;
+  char *argv[TOM_MAX_SWEEP_ARGS];
+  int argc;
+  struct opt_odb_t *odb;
+  FILE *fd;
+
+  fd = fopen(fname, "r");
+  if (!fd)
+    fatal("could not open sweep file `%s'", fname);
+
+  while (fgets(line, sizeof(line), fd) != NULL)
+    {
+      if (line[strlen(line)-1] == '\n')
+	line[strlen(line)-1] = '\0';
+      for (p = line; *p == ' ' || *p == '\t'; p++)
+	;
+      /* skip empty lines and comments */
+      if (*p == '\0' || *p == '#')
+	continue;
+
+      if (tom_nsweep == TOM_MAX_SWEEP)
+	fatal("too many sweep configurations, the maximum is %d",
+	      TOM_MAX_SWEEP);
+      tom_sweep_desc[tom_nsweep] = mystrdup(p);
+
+      /* split the line into arguments, after a dummy program name */
+      argc = 0;
+      argv[argc++] = "sweep";
+      for (p = strtok(p, " \t"); p != NULL; p = strtok(NULL, " \t"))
+	{
+	  if (argc == TOM_MAX_SWEEP_ARGS)
+	    fatal("too many arguments in sweep configuration `%s'",
+		  tom_sweep_desc[tom_nsweep]);
+	  argv[argc++] = p;
+	}
+
+      /* the options start from those of the main pipeline */
+      tom_sweep[tom_nsweep] = tom_opts;
+      odb = opt_new(NULL);
+      tom_reg_options(odb, &tom_sweep[tom_nsweep]);
+      opt_process_options(odb, argc, argv);
+      opt_delete(odb);
+
+      tom_check_options(&tom_sweep[tom_nsweep]);
+      tom_nsweep++;
+    }
+  fclose(fd);
 }
 
 /* check simulator-specific option values */
 void
 sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
 {
-  /* nada */
+  tom_check_options(&tom_opts);
+
+  if (tom_print && !mystricmp(tom_trace_opt, "none"))
+    fatal("`-tom:print' needs a trace, use `-tom:trace mem' or a file");
+  if (tom_sweep_threads < 0)
+    fatal("sweep thread count must not be negative");
+  if (mystricmp(tom_sweep_opt, "none"))
+    {
+      if (!mystricmp(tom_trace_opt, "none"))
+	fatal("`-tom:sweep' needs a trace, use `-tom:trace mem' or a file");
+      tom_read_sweep(tom_sweep_opt);
+    }
+  if (ilp_opt && ilp_nlat != NUM_FU_CLASSES - 1)
+    fatal("`-ilp:lat' needs a latency for each of the %d FU classes",
+	  NUM_FU_CLASSES - 1);
 }
 
 /* register simulator-specific statistics */
@@ -141,6 +695,18 @@ sim_reg_stats(struct stat_sdb_t *sdb)
   stat_reg_counter(sdb, "sim_num_tom_cycles",
 		   "total number of cycles with tomasulo",
 		   &sim_num_tom_cycles, 0, NULL);
+  stat_reg_formula(sdb, "sim_tom_IPC",
+		   "instructions per cycle with tomasulo",
+		   "sim_num_insn / sim_num_tom_cycles", NULL);
+  tom_reg_stats(tom, sdb);
+  if (tom_opts.config.bpred)
+    bpred_reg_stats(tom_opts.config.bpred, sdb);
+  if (tom_opts.config.dl1)
+    cache_reg_stats(tom_opts.config.dl1, sdb);
+  if (tom_opts.dl2)
+    cache_reg_stats(tom_opts.dl2, sdb);
+  if (ilp)
+    dataflow_reg_stats(ilp, sdb);
   /* ECE552 END */
 
   ld_reg_stats(sdb);
@@ -160,6 +726,27 @@ sim_init(void)
   /* allocate and initialize memory space */
   mem = mem_create("mem");
   mem_init(mem);
+
+  /* ECE552 BEGIN */
+  //the Tomasulo pipeline is timed as the instructions execute
+  if (mystricmp(tom_trace_opt, "none"))
+    tom_trace = create_trace(!mystricmp(tom_trace_opt, "mem")
+			     ? NULL : tom_trace_opt, /* keep timing */tom_print);
+  tom_cur_opts = &tom_opts;
+  tom = tom_create(&tom_opts.config, tom_trace,
+		   mystricmp(tom_log_opt, "none") ? tom_log_opt : NULL);
+
+  //instructions with no FU class take a cycle in the dataflow limit
+  if (ilp_opt)
+    {
+      int lat[NUM_FU_CLASSES], i;
+
+      lat[FUClass_NA] = 1;
+      for (i = 1; i < NUM_FU_CLASSES; i++)
+	lat[i] = ilp_lat[i - 1];
+      ilp = dataflow_create(ilp_windows, ilp_nwindows, lat);
+    }
+  /* ECE552 END */
 }
 
 /* load program into simulated state */
@@ -186,7 +773,12 @@ sim_aux_config(FILE *stream)		/* output stream */
 void
 sim_aux_stats(FILE *stream)		/* output stream */
 {
-  /* nada */
+  /* two runs agree on the timing of every instruction if they agree on
+     the digest */
+  if (tom_digest_valid)
+    fprintf(stream, "%-20s 0x%08lx%08lx # digest of the Tomasulo timing\n",
+	    "tom_timing_digest", (unsigned long)(tom_timing_digest >> 32),
+	    (unsigned long)(tom_timing_digest & 0xffffffff));
 }
 
 /* un-initialize simulator-specific state */
@@ -208,6 +800,10 @@ sim_uninit(void)
 /* next program counter */
 #define SET_NPC(EXPR)		(regs.regs_NPC = (EXPR))
 
+/* target program counter, for the Tomasulo branch predictor */
+#undef  SET_TPC
+#define SET_TPC(EXPR)		(target_PC = (EXPR))
+
 /* current program counter */
 #define CPC			(regs.regs_PC)
 
@@ -262,55 +858,137 @@ sim_uninit(void)
 #error No ISA target defined...
 #endif
 
+/* ECE552 BEGIN */
+/* extent of the memory accessed by the instruction, for the Tomasulo load/
+   store queue; DLW/DSW access two words, and SWL/SWR read the word they
+   write, always at ascending addresses */
+#define TOM_MEM_REF(N)							\
+  (mem_size == 0							\
+   ? (mem_addr = addr, mem_size = (N))					\
+   : (mem_size = MAX(mem_addr + mem_size, addr + (N)) - mem_addr))
+/* ECE552 END */
+
 /* precise architected memory state accessor macros */
 #define READ_BYTE(SRC, FAULT)						\
-  ((FAULT) = md_fault_none, addr = (SRC), MEM_READ_BYTE(mem, addr))
+  ((FAULT) = md_fault_none, addr = (SRC), TOM_MEM_REF(1),		\
+   MEM_READ_BYTE(mem, addr))
 #define READ_HALF(SRC, FAULT)						\
-  ((FAULT) = md_fault_none, addr = (SRC), MEM_READ_HALF(mem, addr))
+  ((FAULT) = md_fault_none, addr = (SRC), TOM_MEM_REF(2),		\
+   MEM_READ_HALF(mem, addr))
 #define READ_WORD(SRC, FAULT)						\
-  ((FAULT) = md_fault_none, addr = (SRC), MEM_READ_WORD(mem, addr))
+  ((FAULT) = md_fault_none, addr = (SRC), TOM_MEM_REF(4),		\
+   MEM_READ_WORD(mem, addr))
 #ifdef HOST_HAS_QWORD
 #define READ_QWORD(SRC, FAULT)						\
-  ((FAULT) = md_fault_none, addr = (SRC), MEM_READ_QWORD(mem, addr))
+  ((FAULT) = md_fault_none, addr = (SRC), TOM_MEM_REF(8),		\
+   MEM_READ_QWORD(mem, addr))
 #endif /* HOST_HAS_QWORD */
 
 #define WRITE_BYTE(SRC, DST, FAULT)					\
-  ((FAULT) = md_fault_none, addr = (DST), MEM_WRITE_BYTE(mem, addr, (SRC)))
+  ((FAULT) = md_fault_none, addr = (DST), TOM_MEM_REF(1),		\
+   MEM_WRITE_BYTE(mem, addr, (SRC)))
 #define WRITE_HALF(SRC, DST, FAULT)					\
-  ((FAULT) = md_fault_none, addr = (DST), MEM_WRITE_HALF(mem, addr, (SRC)))
+  ((FAULT) = md_fault_none, addr = (DST), TOM_MEM_REF(2),		\
+   MEM_WRITE_HALF(mem, addr, (SRC)))
 #define WRITE_WORD(SRC, DST, FAULT)					\
-  ((FAULT) = md_fault_none, addr = (DST), MEM_WRITE_WORD(mem, addr, (SRC)))
+  ((FAULT) = md_fault_none, addr = (DST), TOM_MEM_REF(4),		\
+   MEM_WRITE_WORD(mem, addr, (SRC)))
 #ifdef HOST_HAS_QWORD
 #define WRITE_QWORD(SRC, DST, FAULT)					\
-  ((FAULT) = md_fault_none, addr = (DST), MEM_WRITE_QWORD(mem, addr, (SRC)))
+  ((FAULT) = md_fault_none, addr = (DST), TOM_MEM_REF(8),		\
+   MEM_WRITE_QWORD(mem, addr, (SRC)))
 #endif /* HOST_HAS_QWORD */
 
-/* system call handler macro */
-#define SYSCALL(INST)	sys_syscall(&regs, mem_access, mem, INST, TRUE)
+/* time the configurations of the sweep, taken in turn by each thread, over
+   the trace recorded */
+static void *
+tom_sweep_worker(void *arg)
+{
+  int k;
 
-/* ECE552 BEGIN */
-instruction_trace_t* instruction_trace;
-/* ECE552 END */
+  for (;;)
+    {
+      pthread_mutex_lock(&tom_sweep_lock);
+      k = tom_sweep_next++;
+      pthread_mutex_unlock(&tom_sweep_lock);
+      if (k >= tom_nsweep)
+	break;
+
+      tom_cur_opts = &tom_sweep[k];
+      tom_sweep_cycles[k] = tom_time_trace(&tom_sweep[k].config, tom_trace,
+					   tom_sweep_end_pc);
+    }
+  return NULL;
+}
+
+/* time the configurations of the sweep in parallel, and print the cycles
+   and the IPC of each, after those of the main pipeline */
+static void
+tom_run_sweep(void)
+{
+  pthread_t threads[TOM_MAX_SWEEP];
+  int nthreads = tom_sweep_threads, i;
+
+  if (nthreads == 0)
+    nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  nthreads = MAX(1, MIN(nthreads, tom_nsweep));
+
+  tom_sweep_next = 0;
+  for (i = 0; i < nthreads; i++)
+    if (pthread_create(&threads[i], NULL, tom_sweep_worker, NULL) != 0)
+      fatal("cannot create sweep thread %d", i);
+  for (i = 0; i < nthreads; i++)
+    pthread_join(threads[i], NULL);
+
+  fprintf(stdout, "TOMASULO SWEEP\n");
+  myfprintf(stdout, "%4s %12s %8s  %s\n", "#", "cycles", "IPC",
+	    "configuration");
+  myfprintf(stdout, "%4d %12n %8.4f  %s\n", 0, sim_num_tom_cycles,
+	    (double)sim_num_insn / (double)sim_num_tom_cycles, "(main)");
+  for (i = 0; i < tom_nsweep; i++)
+    myfprintf(stdout, "%4d %12n %8.4f  %s\n", i + 1, tom_sweep_cycles[i],
+	      (double)sim_num_insn / (double)tom_sweep_cycles[i],
+	      tom_sweep_desc[i]);
+}
+
+/* drain the Tomasulo pipeline once the last instruction executed */
+static void
+sim_tom_finish(void)
+{
+  sim_num_tom_cycles = tom_finish(tom);
+  tom_timing_digest = tom_digest(tom);
+  tom_digest_valid = TRUE;
+
+  if (tom_print)
+    print_all_instr(tom_trace, sim_num_insn);
+
+  /* the last instruction of the trace is followed by the one at the PC */
+  tom_sweep_end_pc = regs.regs_PC;
+  if (tom_nsweep > 0)
+    tom_run_sweep();
+}
+
+/* system call handler macro, exit() ends the simulation without returning
+   so the Tomasulo pipeline is drained first */
+#define SYSCALL(INST)							\
+  ((MD_EXIT_SYSCALL(&regs) ? sim_tom_finish() : (void)0),		\
+   sys_syscall(&regs, mem_access, mem, INST, TRUE))
 
 /* start simulation, program loaded, processor precise state initialized */
 void
 sim_main(void)
 {
   md_inst_t inst;
-  register md_addr_t addr;
+  register md_addr_t addr, target_PC = 0;
+  md_addr_t mem_addr;
+  int mem_size;
   enum md_opcode op;
   register int is_write;
   enum md_fault_type fault;
 
   /* ECE552 BEGIN */
-  instruction_t m_instr;
-  memset(&m_instr, 0, sizeof(instruction_t));
-
-  instruction_trace = malloc(sizeof(instruction_trace_t));
-  assert(instruction_trace != NULL);
-  memset(instruction_trace, 0, sizeof(instruction_trace_t));
-  //skip the first entry
-  instruction_trace->size++;
+  trace_instr_t m_instr;
+  memset(&m_instr, 0, sizeof(trace_instr_t));
   /* ECE552 END */
 
   fprintf(stderr, "sim: ** starting functional simulation **\n");
@@ -339,6 +1017,7 @@ sim_main(void)
 	  
       /* set default reference address and access mode */
       addr = 0; is_write = FALSE;
+      mem_addr = 0; mem_size = 0;
 
       /* set default fault - none */
       fault = md_fault_none;
@@ -347,7 +1026,6 @@ sim_main(void)
       MD_SET_OPCODE(op, inst);
 
       /* ECE552 BEGIN */
-      m_instr.index = sim_num_insn;
       m_instr.inst = inst;
       m_instr.pc = regs.regs_PC;
       m_instr.op = op;
@@ -374,7 +1052,18 @@ sim_main(void)
       }
 
       /* ECE552 BEGIN */
-      put_instr(instruction_trace, &m_instr);
+      if (MD_OP_FLAGS(op) & F_MEM) {
+	m_instr.addr = mem_addr;
+	m_instr.mem_size = mem_size;
+      } else {
+	m_instr.addr = target_PC;
+	m_instr.mem_size = 0;
+      }
+      if (tom_trace)
+	put_instr(tom_trace, &m_instr);
+      tom_push(tom, &m_instr, sim_num_insn, regs.regs_NPC);
+      if (ilp)
+	dataflow_push(ilp, &m_instr);
       /* ECE552 END */
 
       if (fault != md_fault_none)
@@ -415,11 +1104,8 @@ sim_main(void)
     }
 
     /* ECE552 BEGIN */
-
-    sim_num_tom_cycles = runTomasulo(instruction_trace);
-  
-    //print_all_instr(instruction_trace, sim_num_insn);
-
-    free(instruction_trace);
+    sim_tom_finish();
+    if (tom_trace)
+      free_trace(tom_trace);
     /* ECE552 END */
 }
@@ -0,0 +1,381 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "instr.h"
+#include "timelog.h"
+
+//bytes of each of the two buffers the records are coded into
+#define TIMELOG_BUF_SIZE (1 << 20)
+
+//most bytes a record takes: a varint holds up to 10 bytes
+#define TIMELOG_MAX_REC (10 * (2 + sizeof(md_inst_t) / sizeof(word_t) + 4))
+
+//FNV-1a 64-bit hash parameters
+#define FNV_OFFSET ULL(0xcbf29ce484222325)
+#define FNV_PRIME  ULL(0x100000001b3)
+
+//records of a log are coded, hashed and written in program order
+struct timelog
+{
+  //instructions released ahead of older ones, a ring indexed by index
+  //modulo its size, a power of two; an unused entry has index 0
+  timelog_rec_t* pending;
+  int pending_size;
+  counter_t next_index; //index of the next record to code
+
+  //previous record coded, the deltas are taken from it
+  md_addr_t prev_pc;
+  tick_t prev_dispatch;
+
+  qword_t digest;     //digest of the records coded so far
+
+  //file writing: the records are coded into buffer cur, and a full buffer is
+  //handed over to the writer thread
+  FILE* fd;
+  unsigned char* buf[2];
+  int cur;
+  int used;           //bytes of buffer cur used
+  int full;           //buffer handed over to the writer, -1 if none
+  int full_used;      //bytes of the buffer handed over
+  int done;           //true once the writer has to stop
+  int error;          //true if a write failed
+  pthread_t writer;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+};
+
+struct timelog_reader
+{
+  FILE* fd;
+  counter_t next_index;
+  md_addr_t prev_pc;
+  tick_t prev_dispatch;
+  qword_t digest;
+};
+
+static qword_t zigzag(sqword_t x) {
+  return ((qword_t)x << 1) ^ (qword_t)(x >> 63);
+}
+
+static sqword_t unzigzag(qword_t x) {
+  return (sqword_t)(x >> 1) ^ -(sqword_t)(x & 1);
+}
+
+static unsigned char* put_varint(unsigned char* p, qword_t x) {
+  while (x >= 0x80) {
+    *p++ = (unsigned char)(x | 0x80);
+    x >>= 7;
+  }
+  *p++ = (unsigned char)x;
+  return p;
+}
+
+static qword_t hash_bytes(qword_t digest, const unsigned char* p, int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    digest ^= p[i];
+    digest *= FNV_PRIME;
+  }
+  return digest;
+}
+
+//codes a stage cycle from the dispatch cycle, 0 if the stage was not entered
+static qword_t code_stage(tick_t cycle, tick_t dispatch) {
+  return cycle == 0 ? 0 : zigzag(cycle - dispatch) + 1;
+}
+
+static tick_t decode_stage(qword_t code, tick_t dispatch) {
+  return code == 0 ? 0 : unzigzag(code - 1) + dispatch;
+}
+
+//codes a record into p, returns the end of the record
+static unsigned char* code_rec(md_addr_t* prev_pc, tick_t* prev_dispatch,
+                               const timelog_rec_t* rec, unsigned char* p) {
+  const word_t* words = (const word_t*)&rec->inst;
+  int i;
+
+  p = put_varint(p, zigzag((int)(rec->pc - *prev_pc - sizeof(md_inst_t))));
+  for (i = 0; i < (int)(sizeof(md_inst_t) / sizeof(word_t)); i++)
+    p = put_varint(p, words[i]);
+  p = put_varint(p, zigzag(rec->timing.dispatch - *prev_dispatch));
+  p = put_varint(p, code_stage(rec->timing.issue, rec->timing.dispatch));
+  p = put_varint(p, code_stage(rec->timing.execute, rec->timing.dispatch));
+  p = put_varint(p, code_stage(rec->timing.cdb, rec->timing.dispatch));
+
+  *prev_pc = rec->pc;
+  *prev_dispatch = rec->timing.dispatch;
+  return p;
+}
+
+//background thread writing out the full buffers
+static void* timelog_writer(void* arg) {
+  timelog_t* log = (timelog_t*)arg;
+
+  pthread_mutex_lock(&log->lock);
+  for (;;) {
+    while (log->full < 0 && !log->done)
+      pthread_cond_wait(&log->cond, &log->lock);
+    if (log->full < 0)
+      break;
+
+    //write without the lock, the producer fills the other buffer meanwhile
+    pthread_mutex_unlock(&log->lock);
+    if (fwrite(log->buf[log->full], 1, log->full_used, log->fd)
+        != (size_t)log->full_used)
+      log->error = TRUE;
+    pthread_mutex_lock(&log->lock);
+
+    log->full = -1;
+    pthread_cond_broadcast(&log->cond);
+  }
+  pthread_mutex_unlock(&log->lock);
+  return NULL;
+}
+
+//hands the current buffer over to the writer and switches to the other one
+static void timelog_flush(timelog_t* log) {
+  pthread_mutex_lock(&log->lock);
+  while (log->full >= 0)
+    pthread_cond_wait(&log->cond, &log->lock);
+  log->full = log->cur;
+  log->full_used = log->used;
+  pthread_cond_broadcast(&log->cond);
+  pthread_mutex_unlock(&log->lock);
+
+  log->cur = 1 - log->cur;
+  log->used = 0;
+}
+
+//codes the next record in program order into the digest and the file
+static void timelog_emit(timelog_t* log, const timelog_rec_t* rec) {
+  unsigned char tmp[TIMELOG_MAX_REC];
+  unsigned char* start;
+  unsigned char* end;
+
+  assert(rec->index == log->next_index);
+  log->next_index++;
+
+  if (log->fd == NULL) {
+    end = code_rec(&log->prev_pc, &log->prev_dispatch, rec, tmp);
+    log->digest = hash_bytes(log->digest, tmp, (int)(end - tmp));
+    return;
+  }
+
+  if (log->used + (int)TIMELOG_MAX_REC > TIMELOG_BUF_SIZE)
+    timelog_flush(log);
+  start = log->buf[log->cur] + log->used;
+  end = code_rec(&log->prev_pc, &log->prev_dispatch, rec, start);
+  log->digest = hash_bytes(log->digest, start, (int)(end - start));
+  log->used += (int)(end - start);
+}
+
+//doubles the reorder ring, keeping each pending record at its index
+static void grow_pending(timelog_t* log) {
+  int old_size = log->pending_size;
+  timelog_rec_t* old = log->pending;
+  int i;
+
+  log->pending_size = old_size * 2;
+  log->pending = (timelog_rec_t*)calloc(log->pending_size,
+                                        sizeof(timelog_rec_t));
+  if (!log->pending)
+    fatal("out of virtual memory");
+  for (i = 0; i < old_size; i++)
+    if (old[i].index != 0)
+      log->pending[old[i].index & (log->pending_size - 1)] = old[i];
+  free(old);
+}
+
+timelog_t* timelog_create(const char* fname) {
+  timelog_t* log = (timelog_t*)calloc(1, sizeof(timelog_t));
+  if (!log)
+    fatal("out of virtual memory");
+
+  log->pending_size = 1024;
+  log->pending = (timelog_rec_t*)calloc(log->pending_size,
+                                        sizeof(timelog_rec_t));
+  if (!log->pending)
+    fatal("out of virtual memory");
+  log->next_index = 1;
+  log->prev_pc = 0;
+  log->prev_dispatch = 0;
+  log->digest = FNV_OFFSET;
+  log->full = -1;
+
+  if (fname != NULL) {
+    unsigned char header[sizeof(TIMELOG_MAGIC) + 10];
+    unsigned char* p;
+
+    log->fd = fopen(fname, "wb");
+    if (!log->fd)
+      fatal("cannot open timing log `%s'", fname);
+    log->buf[0] = (unsigned char*)malloc(TIMELOG_BUF_SIZE);
+    log->buf[1] = (unsigned char*)malloc(TIMELOG_BUF_SIZE);
+    if (!log->buf[0] || !log->buf[1])
+      fatal("out of virtual memory");
+
+    memcpy(header, TIMELOG_MAGIC, sizeof(TIMELOG_MAGIC));
+    p = put_varint(header + sizeof(TIMELOG_MAGIC), log->next_index - 1);
+    memcpy(log->buf[0], header, p - header);
+    log->used = (int)(p - header);
+
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->cond, NULL);
+    if (pthread_create(&log->writer, NULL, timelog_writer, log) != 0)
+      fatal("cannot create the timing log writer thread");
+  }
+  return log;
+}
+
+void timelog_put(timelog_t* log, const timelog_rec_t* rec) {
+  assert(rec->index >= log->next_index);
+
+  if (rec->index != log->next_index) {
+    //an older instruction is still in flight, hold the record back
+    while (rec->index - log->next_index >= log->pending_size)
+      grow_pending(log);
+    log->pending[rec->index & (log->pending_size - 1)] = *rec;
+    return;
+  }
+
+  timelog_emit(log, rec);
+  for (;;) {
+    timelog_rec_t* next = &log->pending[log->next_index
+                                        & (log->pending_size - 1)];
+    if (next->index != log->next_index)
+      break;
+    timelog_emit(log, next);
+    next->index = 0;
+  }
+}
+
+qword_t timelog_close(timelog_t* log) {
+  qword_t digest;
+  int i;
+  counter_t left;
+
+  //records still held back have older instructions that never left, such
+  //as the ones fetched last; they are logged in order regardless
+  do {
+    left = 0;
+    for (i = 0; i < log->pending_size; i++) {
+      timelog_rec_t* rec = &log->pending[i];
+      if (rec->index != 0 && (left == 0 || rec->index < left))
+        left = rec->index;
+    }
+    if (left != 0) {
+      timelog_rec_t rec = log->pending[left & (log->pending_size - 1)];
+      log->pending[left & (log->pending_size - 1)].index = 0;
+      log->next_index = left;
+      timelog_put(log, &rec);
+    }
+  } while (left != 0);
+
+  if (log->fd != NULL) {
+    timelog_flush(log);
+    pthread_mutex_lock(&log->lock);
+    log->done = TRUE;
+    pthread_cond_broadcast(&log->cond);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->writer, NULL);
+    if (log->error || fclose(log->fd) != 0)
+      fatal("cannot write the timing log");
+    pthread_mutex_destroy(&log->lock);
+    pthread_cond_destroy(&log->cond);
+    free(log->buf[0]);
+    free(log->buf[1]);
+  }
+
+  digest = log->digest;
+  free(log->pending);
+  free(log);
+  return digest;
+}
+
+//reads a varint, hashing its bytes; returns false at the end of the file
+static int get_varint(timelog_reader_t* reader, qword_t* x, int first) {
+  int shift = 0, c;
+  unsigned char byte;
+
+  *x = 0;
+  do {
+    c = fgetc(reader->fd);
+    if (c == EOF) {
+      if (first && shift == 0)
+        return FALSE;
+      fatal("truncated timing log");
+    }
+    if (shift > 63)
+      fatal("corrupt timing log");
+    byte = (unsigned char)c;
+    reader->digest = hash_bytes(reader->digest, &byte, 1);
+    *x |= (qword_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return TRUE;
+}
+
+timelog_reader_t* timelog_open(const char* fname) {
+  timelog_reader_t* reader;
+  char magic[sizeof(TIMELOG_MAGIC)];
+  qword_t first;
+
+  reader = (timelog_reader_t*)calloc(1, sizeof(timelog_reader_t));
+  if (!reader)
+    fatal("out of virtual memory");
+  reader->fd = !strcmp(fname, "-") ? stdin : fopen(fname, "rb");
+  if (!reader->fd)
+    fatal("cannot open timing log `%s'", fname);
+
+  if (fread(magic, 1, sizeof(magic), reader->fd) != sizeof(magic)
+      || memcmp(magic, TIMELOG_MAGIC, sizeof(magic)) != 0)
+    fatal("`%s' is not a timing log", fname);
+  if (!get_varint(reader, &first, FALSE))
+    fatal("truncated timing log");
+
+  //the header is not part of the digest
+  reader->digest = FNV_OFFSET;
+  reader->next_index = (counter_t)first + 1;
+  return reader;
+}
+
+int timelog_read(timelog_reader_t* reader, timelog_rec_t* rec) {
+  word_t* words = (word_t*)&rec->inst;
+  qword_t x;
+  int i;
+
+  if (!get_varint(reader, &x, TRUE))
+    return FALSE;
+  rec->index = reader->next_index++;
+  rec->pc = reader->prev_pc + sizeof(md_inst_t) + (int)unzigzag(x);
+  for (i = 0; i < (int)(sizeof(md_inst_t) / sizeof(word_t)); i++) {
+    get_varint(reader, &x, FALSE);
+    words[i] = (word_t)x;
+  }
+  get_varint(reader, &x, FALSE);
+  rec->timing.dispatch = reader->prev_dispatch + unzigzag(x);
+  get_varint(reader, &x, FALSE);
+  rec->timing.issue = decode_stage(x, rec->timing.dispatch);
+  get_varint(reader, &x, FALSE);
+  rec->timing.execute = decode_stage(x, rec->timing.dispatch);
+  get_varint(reader, &x, FALSE);
+  rec->timing.cdb = decode_stage(x, rec->timing.dispatch);
+
+  reader->prev_pc = rec->pc;
+  reader->prev_dispatch = rec->timing.dispatch;
+  return TRUE;
+}
+
+qword_t timelog_reader_close(timelog_reader_t* reader) {
+  qword_t digest = reader->digest;
+  if (reader->fd != stdin)
+    fclose(reader->fd);
+  free(reader);
+  return digest;
+}
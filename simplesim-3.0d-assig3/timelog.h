@@ -0,0 +1,58 @@
+#ifndef TIMELOG_H
+#define TIMELOG_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "machine.h"
+#include "instr.h"
+
+//a timing log starts with this magic string, its terminating NUL included,
+//and the index of its first instruction minus one; then come the records of
+//the instructions, in program order, each one coded as varints of deltas
+//from the previous record:
+//  the PC, from the address after the previous one (zigzag)
+//  each word of the instruction
+//  the dispatch cycle, from the previous one (zigzag)
+//  the issue, execute and CDB cycles, from the dispatch cycle (zigzag) plus
+//  one, or 0 if the instruction did not enter the stage
+#define TIMELOG_MAGIC "TOMLOG1"
+
+//an instruction of a timing log, and its timing
+typedef struct timelog_rec
+{
+  counter_t index;
+  md_addr_t pc;
+  md_inst_t inst;
+  tom_timing_t timing;
+}timelog_rec_t;
+
+//log of the timing of the instructions, in program order; the digest of the
+//log is always kept, the log is written to a file only if one is given
+typedef struct timelog timelog_t;
+
+//creates a log of the instructions from index 1 on, written to the file
+//fname by a background thread unless fname is NULL
+extern timelog_t* timelog_create(const char* fname);
+
+//logs an instruction that left the pipeline; they may leave out of order,
+//each is logged once all the older ones are
+extern void timelog_put(timelog_t* log, const timelog_rec_t* rec);
+
+//logs the instructions still waiting for older ones, writes out the file
+//and frees the log; returns the digest of all the records logged
+extern qword_t timelog_close(timelog_t* log);
+
+//reader of a timing log file
+typedef struct timelog_reader timelog_reader_t;
+
+//opens the timing log file fname, or stdin if fname is "-"
+extern timelog_reader_t* timelog_open(const char* fname);
+
+//reads the next record of the log, returns false at its end
+extern int timelog_read(timelog_reader_t* reader, timelog_rec_t* rec);
+
+//closes the log, returns the digest of the records read
+extern qword_t timelog_reader_close(timelog_reader_t* reader);
+
+#endif
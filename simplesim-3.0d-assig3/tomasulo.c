@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "host.h"
@@ -16,20 +17,69 @@
 #include "options.h"
 #include "stats.h"
 #include "sim.h"
+#include "bpred.h"
+#include "cache.h"
 #include "decode.def"
 
 #include "instr.h"
+#include "tomasulo.h"
+#include "timelog.h"
 
 /* PARAMETERS OF THE TOMASULO'S ALGORITHM */
-#define INSTR_QUEUE_SIZE         10
 
-#define RESERV_INT_SIZE    4
-#define RESERV_FP_SIZE     2
-#define FU_INT_SIZE        2
-#define FU_FP_SIZE         1
+//the parameters are set at run time with the -tom:* options; each pipeline
+//has its own parameters, the macros refer to those of the pipeline tom,
+//except in the copy of the pipeline that has the defaults compiled in (see
+//the end of this file)
 
-#define FU_INT_LATENCY     4
-#define FU_FP_LATENCY      9
+#define INSTR_QUEUE_SIZE   (tom->cfg.ifq_size)
+
+#define RESERV_INT_SIZE    (tom->cfg.rs_int_size)
+#define RESERV_FP_SIZE     (tom->cfg.rs_fp_size)
+#define FU_INT_SIZE        (tom->cfg.fu_int_size)
+#define FU_FP_SIZE         (tom->cfg.fu_fp_size)
+
+#define FU_INT_LATENCY     (tom->cfg.fu_int_latency)
+#define FU_FP_LATENCY      (tom->cfg.fu_fp_latency)
+
+#define ROB_SIZE           (tom->cfg.rob_size)
+#define MISPRED_PENALTY    (tom->cfg.mispred_penalty)
+
+#define FETCH_WIDTH        (tom->cfg.width)
+#define ISSUE_WIDTH        (tom->cfg.issue_width)
+#define CDB_COUNT          (tom->cfg.cdb_count)
+
+#define LSQ_SIZE           (tom->cfg.lsq_size)
+#define LSQ_PORTS          (tom->cfg.lsq_ports)
+#define LSQ_SPEC           (tom->cfg.lsq_spec)
+
+/* with a reorder buffer, branches are predicted and resolved by an integer
+   FU, and instructions commit in order */
+#define TOM_SPECULATE      (ROB_SIZE > 0)
+
+/* fetch and dispatch move up to the same number of instructions per cycle */
+#define DISPATCH_WIDTH     FETCH_WIDTH
+
+/* instruction records in flight: the instructions waiting to be fetched, the
+   instruction queue, and the reorder buffer if any, otherwise the reservation
+   stations, the load/store queue and the instructions whose results are on
+   the CDBs (they have already left their reservation stations) */
+#define TOM_WINDOW_SIZE    (FETCH_WIDTH + INSTR_QUEUE_SIZE + \
+                            (TOM_SPECULATE ? ROB_SIZE : RESERV_INT_SIZE + \
+                             RESERV_FP_SIZE + LSQ_SIZE + CDB_COUNT))
+
+/* a tag holds the window slot of an instruction in its low TOM_TAG_SLOT_BITS
+   bits, and the generation of the slot, from 1 to TOM_TAG_GEN_MAX, above */
+#define TOM_TAG_SLOT_BITS  16
+#define TOM_TAG_SLOT_MASK  ((1 << TOM_TAG_SLOT_BITS) - 1)
+#define TOM_TAG_GEN_MAX    (INT_MAX >> TOM_TAG_SLOT_BITS)
+
+/* a cycle no stage ever reaches, cycles are 64 bits wide so long runs do not
+   overflow them */
+#define TOM_NEVER          ((tick_t)(~(qword_t)0 >> 1))
+
+/* the timing of the first TOM_CHECK_INSNS instructions is sanity checked */
+#define TOM_CHECK_INSNS    1000000
 
 /* IDENTIFYING INSTRUCTIONS */
 
@@ -40,6 +90,9 @@
 //conditional branch instruction
 #define IS_COND_CTRL(op) (MD_OP_FLAGS(op) & F_COND)
 
+//any control instruction
+#define IS_CTRL(op) (IS_UNCOND_CTRL(op) || IS_COND_CTRL(op))
+
 //floating-point computation
 #define IS_FCOMP(op) (MD_OP_FLAGS(op) & F_FCOMP)
 
@@ -55,611 +108,606 @@
 //trap instruction
 #define IS_TRAP(op) (MD_OP_FLAGS(op) & F_TRAP) 
 
-#define USES_INT_FU(op) (IS_ICOMP(op) || IS_LOAD(op) || IS_STORE(op))
+//with a load/store queue, loads and stores use neither a RS nor an FU
+#define USES_LSQ(op) (LSQ_SIZE > 0 && (IS_LOAD(op) || IS_STORE(op)))
+
+#define USES_INT_FU(op) (IS_ICOMP(op) || \
+                         ((IS_LOAD(op) || IS_STORE(op)) && !USES_LSQ(op)) || \
+                         (TOM_SPECULATE && IS_CTRL(op)))
 #define USES_FP_FU(op) (IS_FCOMP(op))
 
-#define WRITES_CDB(op) (IS_ICOMP(op) || IS_LOAD(op) || IS_FCOMP(op))
+//writes a register, calls write the return address
+#define WRITES_CDB(op) (IS_ICOMP(op) || IS_LOAD(op) || IS_FCOMP(op) || \
+                        MD_IS_CALL(op))
 
 /* FOR DEBUGGING */
 
 //prints info about an instruction
 #define PRINT_INST(out,instr,str,cycle)	\
-  myfprintf(out, "%d: %s", cycle, str);		\
+  myfprintf(out, "%n: %s", cycle, str);		\
   md_print_insn(instr->inst, instr->pc, out); \
-  myfprintf(stdout, "(%d)\n",instr->index);
+  myfprintf(stdout, "(%n)\n",instr->index);
 
 #define PRINT_REG(out,reg,str,instr) \
   myfprintf(out, "reg#%d %s ", reg, str);	\
   md_print_insn(instr->inst, instr->pc, out); \
-  myfprintf(stdout, "(%d)\n",instr->index);
+  myfprintf(stdout, "(%n)\n",instr->index);
 
 /* VARIABLES */
 
-//instruction queue for tomasulo
-static instruction_t* instr_queue[INSTR_QUEUE_SIZE];
-//number of instructions in the instruction queue
-static int instr_queue_size = 0;
-static int instr_queue_head = 0;
-static int instr_queue_tail = 0;
-
-//reservation stations (each reservation station entry contains a pointer to an instruction)
-static instruction_t* reservINT[RESERV_INT_SIZE];
-static instruction_t* reservFP[RESERV_FP_SIZE];
-
-//functional units
-static instruction_t* fuINT[FU_INT_SIZE];
-static instruction_t* fuFP[FU_FP_SIZE];
-
-//common data bus
-static instruction_t* commonDataBus = NULL;
-
-//the index of the last instruction fetched
-static int fetch_index = 1;
-
-//The map table keeps track of which instruction produces the value for each register
-static instruction_t * map_table[MD_TOTAL_REGS];
-
-//prints a single instruction
-/* ECE552: Assignment 3 - BEGIN CODE */
-static void print_check_instr(instruction_t* instr) {
-  static instruction_t * previous = NULL;
-
-#ifdef _DEBUG_
-  md_print_insn(instr->inst, instr->pc, stdout);
-#endif
-  if (USES_INT_FU(instr->op) || USES_FP_FU(instr->op)) {
-    if(IS_STORE(instr->op)) {
-      assert(instr->tom_dispatch_cycle > 0 && instr->tom_dispatch_cycle == (instr->tom_issue_cycle -1) && 
-      instr->tom_dispatch_cycle < instr->tom_execute_cycle);
-    } else {
-      assert(instr->tom_dispatch_cycle > 0 && instr->tom_dispatch_cycle == (instr->tom_issue_cycle -1) && 
-      instr->tom_dispatch_cycle < instr->tom_execute_cycle && instr->tom_dispatch_cycle < instr->tom_cdb_cycle);
-      assert(instr->tom_cdb_cycle == (instr->tom_execute_cycle + 4) 
-        || instr->tom_cdb_cycle == (instr->tom_execute_cycle + 5)
-        || instr->tom_cdb_cycle == (instr->tom_execute_cycle + 6)
-        || instr->tom_cdb_cycle == (instr->tom_execute_cycle + 9)
-        || instr->tom_cdb_cycle == (instr->tom_execute_cycle + 10)
-        || instr->tom_cdb_cycle == (instr->tom_execute_cycle + 11));
-    }
-
-    if (previous != NULL) {
-      assert(instr->tom_dispatch_cycle > previous->tom_dispatch_cycle);
-      assert(instr->tom_issue_cycle > previous->tom_issue_cycle);
-    }
-    previous = instr;
-  }
-#ifdef _DEBUG_
-  myfprintf(stdout, "\t%d\t%d\t%d\t%d\n", 
-	    instr->tom_dispatch_cycle,
-	    instr->tom_issue_cycle,
-	    instr->tom_execute_cycle,
-	    instr->tom_cdb_cycle);
-#endif
+//scheduling side-state of the instruction records in flight, indexed by
+//window slot
+typedef struct tom_sched
+{
+  int gen;               //generation of the slot, it changes each time an
+                         //instruction leaves it
+  int wait_mask;         //source operands the instruction waits for to
+                         //issue, a bit each
+  int wake_head;         //first waiting operand of the consumers, as
+                         //slot * 3 + operand, -1 if none
+  int wake_next[3];      //next operand waiting for the same producer
+  tick_t complete_cycle; //cycle the FU finishes executing the instruction
+  instruction_t* next;   //next instruction in the list it is in
+
+  //with a reorder buffer only
+  tick_t done_cycle;     //first cycle the instruction can commit, 0 if
+                         //it did not finish yet
+  md_addr_t target_pc;   //branch target if taken
+  md_addr_t next_pc;     //address of the next instruction executed
+  md_addr_t pred_pc;     //predicted address of the next instruction
+  bool mispred;          //true if pred_pc is wrong
+  struct bpred_update_t dir_update; //predictor state to update
+
+  //with a load/store queue only
+  md_addr_t mem_addr;    //address the load or store accesses
+  int mem_size;          //bytes it accesses
+  int lsq_slot;          //its LSQ entry
+  tick_t addr_cycle;     //store: first cycle younger loads see its address,
+                         //0 if it is not generated yet
+  tick_t data_cycle;     //store: first cycle its data can be forwarded, 0 if
+                         //it is not produced yet
+  bool violated;         //load: passed an older store to the same address
+}tom_sched_t;
+
+//state of a Tomasulo pipeline, each pipeline times its own stream of
+//instructions, so several of them can run at once on different threads
+struct tom_t
+{
+  //the parameters of the pipeline
+  tom_config_t cfg;
+  //simulates cycles with the stages for these parameters, see tom_run()
+  void (*run)(tom_t* tom);
+
+  //instruction queue for tomasulo
+  instruction_t** instr_queue;
+  //number of instructions in the instruction queue
+  int instr_queue_size;
+  int instr_queue_head;
+  int instr_queue_tail;
+
+  //reservation stations in use
+  int reservINT_used;
+  int reservFP_used;
+
+  //functional units in use, an instruction holds its FU until it leaves for
+  //the CDB
+  int fuINT_used;
+  int fuFP_used;
+
+  //common data buses, the first cdb_used ones carry a result
+  instruction_t** commonDataBus;
+  int cdb_used;
+
+  //instruction records in flight, and a stack of the free ones
+  instruction_t* tom_window;
+  instruction_t** tom_window_free;
+  int tom_window_nfree;
+
+  //scheduling side-state of the instruction records, indexed by window slot
+  tom_sched_t* tom_sched;
+
+  //instructions whose operands are ready, oldest first, waiting for an FU
+  instruction_t* readyINT;
+  instruction_t* readyFP;
+
+  //instructions executing, by the cycle they complete (FU-completion events)
+  instruction_t* executing;
+
+  //instructions done executing, oldest first, waiting for the CDB
+  instruction_t* completed;
+
+  //stores, and branches writing no register, that left their FU this cycle,
+  //their RS is freed at the end of it
+  instruction_t* storesDone;
+
+  //loads and stores whose address operands are ready, oldest first, waiting
+  //to generate their address
+  instruction_t* readyMEM;
+
+  //loads whose address is known, oldest first, waiting for an older store
+  instruction_t* blockedLD;
+
+  //instructions dispatched to a reservation station in the last two cycles,
+  //oldest first, until they issue (dispatch of the current cycle precedes
+  //issue of the last one)
+  instruction_t** dispatched;
+  int dispatched_head;
+  int dispatched_count;
+
+  //the next instructions to fetch, oldest first, provided by the functional
+  //simulator; a cycle is simulated once a full fetch group is pending
+  instruction_t** fetch_pending;
+  int fetch_pending_head;
+  int fetch_pending_count;
+
+  //true once the functional simulator provided its last instruction
+  bool fetch_done;
+
+  //the cycle simulated next
+  tick_t tom_cycle;
+
+  //trace that receives the timing of each instruction if it keeps it, NULL
+  //if none
+  instruction_trace_t* tom_trace;
+
+  //log of the timing of the instructions in program order, closed once the
+  //pipeline drains, and the digest of the timing it leaves
+  timelog_t* timelog;
+  qword_t digest;
+
+  //The map table keeps track of which instruction produces the value for each register,
+  //by its tag
+  tom_tag_t map_table[MD_TOTAL_REGS];
+
+  //reorder buffer, instructions from dispatch to commit in program order
+  instruction_t** rob;
+  int rob_count;
+  int rob_head;
+
+  //load/store queue, loads and stores from dispatch in program order; they
+  //leave in order, at commit with a ROB, otherwise once a load broadcast its
+  //result or a store knows its address and data and writes the cache
+  instruction_t** lsq;
+  int lsq_count;
+  int lsq_head;
+
+  //fetch stops after a mispredicted branch, there is no wrong path in the
+  //trace to fetch, and resumes in this cycle once the branch resolved
+  tick_t fetch_resume_cycle;
+  tick_t fetch_stall_start;
+
+  //statistics, the occupancy counts are summed over the cycles
+  counter_t tom_branches;
+  counter_t tom_mispredicts;
+  counter_t tom_mispred_stall;
+  counter_t tom_ifq_count;
+  counter_t tom_rs_int_count;
+  counter_t tom_rs_fp_count;
+  counter_t tom_fu_int_count;
+  counter_t tom_fu_fp_count;
+  counter_t tom_rob_count;
+  counter_t tom_cdb_stall;
+  counter_t tom_cdb_stall_cycles;
+  counter_t tom_lsq_count;
+  counter_t tom_lsq_forwards;
+  counter_t tom_lsq_blocked;
+  counter_t tom_lsq_violations;
+
+  //true once fetch reached the end of the instructions
+  bool end;
+
+  //dispatch cycle of the last instruction checked for dispatch order
+  tick_t previous_dispatch_cycle;
+};
+
+#define SLOT(instr)      ((int)((instr) - tom->tom_window))
+#define SCHED(instr)     (&tom->tom_sched[SLOT(instr)])
+
+//tag of an instruction in flight, the instruction a tag refers to, and
+//whether that instruction is still in flight
+#define TAG(instr)       ((SCHED(instr)->gen << TOM_TAG_SLOT_BITS) \
+                          | SLOT(instr))
+#define TAG_INSTR(tag)   (&tom->tom_window[(tag) & TOM_TAG_SLOT_MASK])
+#define TAG_LIVE(tag)    ((tag) != TOM_NO_TAG \
+                          && tom->tom_sched[(tag) & TOM_TAG_SLOT_MASK].gen \
+                             == (tag) >> TOM_TAG_SLOT_BITS)
+
+//true if the pipeline has the default parameters
+static bool tom_default_config(tom_t* tom) {
+  return (INSTR_QUEUE_SIZE == TOM_DEFAULT_IFQ_SIZE
+          && RESERV_INT_SIZE == TOM_DEFAULT_RS_INT_SIZE
+          && RESERV_FP_SIZE == TOM_DEFAULT_RS_FP_SIZE
+          && FU_INT_SIZE == TOM_DEFAULT_FU_INT_SIZE
+          && FU_FP_SIZE == TOM_DEFAULT_FU_FP_SIZE
+          && FU_INT_LATENCY == TOM_DEFAULT_FU_INT_LATENCY
+          && FU_FP_LATENCY == TOM_DEFAULT_FU_FP_LATENCY
+          && ROB_SIZE == TOM_DEFAULT_ROB_SIZE
+          && FETCH_WIDTH == TOM_DEFAULT_WIDTH
+          && ISSUE_WIDTH == TOM_DEFAULT_ISSUE_WIDTH
+          && CDB_COUNT == TOM_DEFAULT_CDB_COUNT
+          && LSQ_SIZE == TOM_DEFAULT_LSQ_SIZE);
 }
 
-//prints all the instructions inside the given trace for pipeline
-void check_all(instruction_trace_t* trace, int sim_num_insn) {
-
-  int printed_count = 0;
-  int index = 1;
-  while (true) {
- 
-     if (1) { // if (printed_count > 9999900) {
-        print_check_instr(&trace->table[index]);
-     }
-     printed_count++;
-     if (printed_count == sim_num_insn)
-        break;
-     if (++index == INSTR_TRACE_SIZE) {
-        trace = trace->next;
-	index = 0;
-	if (trace == NULL)
-	   break;
-     }
-   }
-}
-/* ECE552: Assignment 3 - END CODE */
+/* THE STAGES OF THE PIPELINE */
 
-/* 
- * Description: 
- * 	Checks if simulation is done by finishing the very last instruction
- *      Remember that simulation is done only if the entire pipeline is empty
- * Inputs:
- * 	sim_insn: the total number of instructions simulated
- * Returns:
- * 	True: if simulation is finished
- */
-static bool is_simulation_done(counter_t sim_insn) {
-  /* ECE552: Assignment 3 - BEGIN CODE */
-  int i;
-  bool retval = false;
-  bool clear = true;
-  if (fetch_index > sim_insn)
-  {
-    for (i=0; i<RESERV_INT_SIZE; i=i+1) {
-      if (reservINT[i] != NULL)
-         clear = false;
-    }
-    for (i=0; i<RESERV_FP_SIZE; i=i+1) {
-      if (reservFP[i] != NULL)
-         clear = false;
-    }
-    retval = clear;
-  }
-  return retval;
-  /* ECE552: Assignment 3 - END CODE */
-}
+//the stages with the parameters of the pipeline tom, and the copy with the
+//default parameters, at the end of this file
+#include "tompipe.def"
+static void tom_fixed_run(tom_t* tom);
 
 /* 
  * Description: 
- * 	Retires the instruction from writing to the Common Data Bus
+ * 	Creates a pipeline to start a new simulation, the functional simulator
+ *      then provides the executed instructions one by one with tom_push()
  * Inputs:
- * 	current_cycle: the cycle we are at
+ *      config: the parameters of the pipeline, the predictor and the cache
+ *              they refer to belong to the new pipeline
+ *      trace: trace the functional simulator records the instructions in,
+ *             their timing is written back to it, or NULL
+ *      log_fname: file the timing log is written to, or NULL to only keep
+ *                 its digest
  * Returns:
- * 	None
+ * 	The new pipeline
  */
-void CDB_To_retire(int current_cycle) {
-  /* ECE552: Assignment 3 - BEGIN CODE */
+tom_t* tom_create(const tom_config_t* config, instruction_trace_t* trace,
+                  const char* log_fname)
+{
+  tom_t * tom;
   int i;
-  instruction_t * r_instr = NULL;
-
-  //free the RS on CDB
-  for (i=0; i<RESERV_INT_SIZE; i=i+1) {
-     if (reservINT[i] != NULL && reservINT[i]->tom_cdb_cycle == current_cycle + 1) {
-       if(!IS_STORE(reservINT[i]->op)) {
-         r_instr = reservINT[i];
-       } else {
-         //remove temporary CDB cycle assigned to store instruction
-         reservINT[i]->tom_cdb_cycle = 0;
-       }
-       assert(r_instr == commonDataBus || IS_STORE(reservINT[i]->op));
-       reservINT[i] = NULL;
-     }
-  }
-  for (i=0; i<RESERV_FP_SIZE; i=i+1) {
-     if (reservFP[i] != NULL && reservFP[i]->tom_cdb_cycle == current_cycle + 1) {
-       if(!IS_STORE(reservFP[i]->op)) {
-         r_instr = reservFP[i];
-       } else {
-         reservFP[i]->tom_cdb_cycle = 0;
-       }
-       //remove temporary CDB cycle assigned to store instruction
-       assert(r_instr == commonDataBus || IS_STORE(reservFP[i]->op));
-       reservFP[i] = NULL;
-     }
+
+  if (config->ifq_size < 1 || config->rs_int_size < 1
+      || config->rs_fp_size < 1 || config->fu_int_size < 1
+      || config->fu_fp_size < 1 || config->fu_int_latency < 1
+      || config->fu_fp_latency < 1)
+    fatal("Tomasulo queue, RS and FU sizes and latencies must be positive");
+  if (config->rob_size < 0 || config->mispred_penalty < 0)
+    fatal("Tomasulo ROB size and misprediction penalty must not be negative");
+  if (config->width < 1 || config->issue_width < 0 || config->cdb_count < 1)
+    fatal("Tomasulo widths must be positive, and there must be a CDB");
+  if (config->lsq_size < 0 || config->lsq_ports < 1)
+    fatal("Tomasulo LSQ size must not be negative, and it needs a port");
+  if (config->dl1 != NULL && config->lsq_size == 0)
+    fatal("Tomasulo loads only access the data cache through a LSQ");
+
+  //all the queues, lists and counters start empty
+  tom = calloc(1, sizeof(tom_t));
+  if (!tom)
+    fatal("out of virtual memory");
+  tom->cfg = *config;
+  //the default parameters run the copy of the pipeline that has them
+  //compiled in
+  tom->run = tom_default_config(tom) ? tom_fixed_run : tom_run;
+  if (TOM_WINDOW_SIZE > TOM_TAG_SLOT_MASK + 1)
+    fatal("Tomasulo window too large, the tags hold %d slots",
+          TOM_TAG_SLOT_MASK + 1);
+
+  //size the structures for the configuration
+  tom->instr_queue = calloc(INSTR_QUEUE_SIZE, sizeof(instruction_t*));
+  tom->tom_window = calloc(TOM_WINDOW_SIZE, sizeof(instruction_t));
+  tom->tom_window_free = calloc(TOM_WINDOW_SIZE, sizeof(instruction_t*));
+  tom->tom_sched = calloc(TOM_WINDOW_SIZE, sizeof(tom_sched_t));
+  tom->rob = calloc(TOM_SPECULATE ? ROB_SIZE : 1, sizeof(instruction_t*));
+  tom->commonDataBus = calloc(CDB_COUNT, sizeof(instruction_t*));
+  tom->dispatched = calloc(2 * DISPATCH_WIDTH, sizeof(instruction_t*));
+  tom->fetch_pending = calloc(FETCH_WIDTH, sizeof(instruction_t*));
+  tom->lsq = calloc(LSQ_SIZE > 0 ? LSQ_SIZE : 1, sizeof(instruction_t*));
+  if (!tom->instr_queue || !tom->tom_window || !tom->tom_window_free
+      || !tom->tom_sched || !tom->rob || !tom->commonDataBus
+      || !tom->dispatched || !tom->fetch_pending || !tom->lsq)
+    fatal("out of virtual memory");
+
+  //all instruction records are free, with no live tag
+  for (i = 0; i < TOM_WINDOW_SIZE; i++) {
+    tom->tom_window_free[i] = &tom->tom_window[i];
+    tom->tom_sched[i].gen = 1;
   }
-  /* ECE552: Assignment 3 - END CODE */
+  tom->tom_window_nfree = TOM_WINDOW_SIZE;
+
+  tom->tom_cycle = 1;
+  tom->tom_trace = trace;
+  tom->timelog = timelog_create(log_fname);
+  return tom;
 }
 
 /* 
  * Description: 
- * 	Moves an instruction from the execution stage to common data bus (if possible)
+ * 	Frees a pipeline, but not the predictor, the cache and the trace it
+ *      refers to
  * Inputs:
- * 	current_cycle: the cycle we are at
+ * 	tom: the pipeline
  * Returns:
  * 	None
  */
-void execute_To_CDB(int current_cycle) {
-  /* ECE552: Assignment 3 - BEGIN CODE */
-  int i, complete_x_cycle; 
-  int fu_idx = -1;
-  bool fp_fu = false;
-  
-  if (commonDataBus != NULL) {
-     assert(current_cycle == commonDataBus->tom_cdb_cycle); 
-
-     if (map_table[commonDataBus->r_out[0]] == commonDataBus)
-         map_table[commonDataBus->r_out[0]] = NULL;
-     if (map_table[commonDataBus->r_out[1]] == commonDataBus)
-         map_table[commonDataBus->r_out[1]] = NULL;
-
-     //clear matching TAGS in RS entries
-     for (i=0; i<RESERV_INT_SIZE; i=i+1) {
-       if (reservINT[i] != NULL && reservINT[i]->Q[0] == commonDataBus)
-          reservINT[i]->Q[0] = NULL;
-       if (reservINT[i] != NULL && reservINT[i]->Q[1] == commonDataBus)
-          reservINT[i]->Q[1] = NULL;
-       if (reservINT[i] != NULL && reservINT[i]->Q[2] == commonDataBus)
-          reservINT[i]->Q[2] = NULL;
-     }
-     for (i=0; i<RESERV_FP_SIZE; i=i+1) {
-       if (reservFP[i] != NULL && reservFP[i]->Q[0] == commonDataBus)
-          reservFP[i]->Q[0] = NULL;
-       if (reservFP[i] != NULL && reservFP[i]->Q[1] == commonDataBus)
-          reservFP[i]->Q[1] = NULL;
-       if (reservFP[i] != NULL && reservFP[i]->Q[2] == commonDataBus)
-          reservFP[i]->Q[2] = NULL;
-     }
-  }
-
-  //CDB instruction <= resource contention
-  instruction_t * c_instr = NULL;
-  commonDataBus = NULL;
-
-  for(i=0; i<FU_INT_SIZE; i=i+1)
-  {
-    if (fuINT[i] != NULL && fuINT[i]->tom_execute_cycle > 0) {
-       //cdb_cycle = fuINT[i]->tom_execute_cycle + 4;
-       complete_x_cycle = fuINT[i]->tom_execute_cycle + 3;
-       if(complete_x_cycle <= current_cycle) {
-         if(IS_STORE(fuINT[i]->op)) {
-           //temporarily assign cdb_cycle to store instruction
-           fuINT[i]->tom_cdb_cycle = current_cycle + 1; 
-           fuINT[i] = NULL;
-         } else if(c_instr == NULL) {
-           c_instr = fuINT[i];
-           fu_idx = i;
-         } else if(fuINT[i]->tom_dispatch_cycle < c_instr->tom_dispatch_cycle) {
-           c_instr = fuINT[i];
-           fu_idx = i;
-         }
-       }
-    }
-  }
-  for(i=0; i<FU_FP_SIZE; i=i+1)
-  {
-    if (fuFP[i] != NULL && fuFP[i]->tom_execute_cycle > 0) {
-       //cdb_cycle = fuFP[i]->tom_execute_cycle + 9;
-       complete_x_cycle = fuFP[i]->tom_execute_cycle + 8;
-       if(complete_x_cycle <= current_cycle) {
-         if(IS_STORE(fuFP[i]->op)) {
-           //temporarily assign cdb_cycle to store instruction
-           fuFP[i]->tom_cdb_cycle = current_cycle + 1; 
-           fuFP[i] = NULL;
-         } else if(c_instr == NULL) {
-           c_instr = fuFP[i];
-           fu_idx = i;
-           fp_fu = true;
-         } else if(fuFP[i]->tom_dispatch_cycle < c_instr->tom_dispatch_cycle) {
-           c_instr = fuFP[i];
-           fu_idx = i;
-           fp_fu = true;
-         }
-       }
-    }
-  }
-
-  commonDataBus = c_instr;
-  if (commonDataBus == NULL)
-    return;
-  commonDataBus->tom_cdb_cycle = current_cycle + 1; 
-
-
-  //clear FU, RS of the completed instruction
-  if (fp_fu) {
-   fuFP[fu_idx] = NULL;
-  } else {
-   fuINT[fu_idx] = NULL;
-  }
-  /* ECE552: Assignment 3 - END CODE */
+void tom_free(tom_t* tom)
+{
+  if (tom->timelog != NULL)
+    timelog_close(tom->timelog);
+  free(tom->instr_queue);
+  free(tom->tom_window);
+  free(tom->tom_window_free);
+  free(tom->tom_sched);
+  free(tom->rob);
+  free(tom->commonDataBus);
+  free(tom->dispatched);
+  free(tom->fetch_pending);
+  free(tom->lsq);
+  free(tom);
 }
-
-
 /* 
  * Description: 
- * 	Moves instruction(s) from the issue to the execute stage (if possible). We prioritize old instructions
- *      (in program order) over new ones, if they both contend for the same functional unit.
- *      All RAW dependences need to have been resolved with stalls before an instruction enters execute.
+ * 	Provides the next executed instruction to the pipeline, and simulates
+ *      cycles until it is fetched, so only a window of instructions in flight
+ *      is ever buffered
  * Inputs:
- * 	current_cycle: the cycle we are at
+ * 	tom: the pipeline
+ *      instr: the record of the instruction executed by the functional
+ *             simulator, it is copied
+ *      index: the index of the instruction, in execution order
+ *      next_pc: the address of the instruction executed next
  * Returns:
  * 	None
  */
-void issue_To_execute(int current_cycle) {
-  /* ECE552: Assignment 3 - BEGIN CODE */
-  int i, j; 
-  instruction_t * e_instr = NULL;
-  instruction_t * tmp = NULL;
-
-  //check for an available INT FU
-  for(i=0; i<FU_INT_SIZE; i=i+1)
-  {
-    if (fuINT[i] == NULL)
-    {
-       e_instr = NULL; 
-       //select the oldest instruction in RS tables that is ready to exec.
-       for(j=0; j<RESERV_INT_SIZE; j=j+1)
-       {
-          tmp = reservINT[j];
-          //NULL & RAW check -- continue if a tag is not NULL
-          if(tmp == NULL || tmp->Q[0] != NULL || tmp->Q[1] != NULL || tmp->Q[2] != NULL)
-            continue;
-          assert(tmp->tom_dispatch_cycle > 0);
-
-          //select not yet executed RS entry, but issued 
-          if (tmp->tom_execute_cycle == 0 && tmp->tom_issue_cycle > 1 &&
-              tmp->tom_issue_cycle < current_cycle) {
-             if (e_instr == NULL)
-               e_instr = tmp; 
-             else if (tmp->tom_dispatch_cycle < e_instr->tom_dispatch_cycle)
-               e_instr = tmp; 
-          }
-       }
-       if(e_instr == NULL)
-         break;
-       e_instr->tom_execute_cycle = current_cycle;
-       fuINT[i] = e_instr;
-    }
+void tom_push(tom_t* tom, const trace_instr_t* instr, counter_t index,
+              md_addr_t next_pc)
+{
+  instruction_t * p_instr;
+  int tail;
+
+  //TRAP instructions are skipped by fetch, they are logged with no timing
+  if (IS_TRAP((enum md_opcode)instr->op)) {
+    timelog_rec_t rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.index = index;
+    rec.pc = instr->pc;
+    rec.inst = instr->inst;
+    timelog_put(tom->timelog, &rec);
+    return;
   }
 
-  //check for an available FP FU
-  for(i=0; i<FU_FP_SIZE; i=i+1)
-  {
-    if (fuFP[i] == NULL)
-    {
-       e_instr = NULL; 
-       for(j=0; j<RESERV_FP_SIZE; j=j+1)
-       {
-          tmp = reservFP[j];
-          //NULL & RAW check -- continue if a tag is not NULL
-          if(tmp == NULL || tmp->Q[0] != NULL || tmp->Q[1] != NULL || tmp->Q[2] != NULL)
-            continue;
-          assert(tmp->tom_dispatch_cycle > 0);
-
-          //select not yet executed RS entry, but issued 
-          if (tmp->tom_execute_cycle == 0 && tmp->tom_issue_cycle > 1 &&
-              tmp->tom_issue_cycle < current_cycle) {
-             if(e_instr == NULL)
-               e_instr = tmp; 
-             else if (tmp->tom_dispatch_cycle < e_instr->tom_dispatch_cycle)
-               e_instr = tmp; 
-          }
-       }
-       if(e_instr == NULL)
-         continue;
-       e_instr->tom_execute_cycle = current_cycle;
-       fuFP[i] = e_instr;
-    }
-  }
-  /* ECE552: Assignment 3 - END CODE */
+  assert(tom->fetch_pending_count < FETCH_WIDTH && !tom->fetch_done);
+  assert(tom->tom_window_nfree > 0);
+  p_instr = tom->tom_window_free[--tom->tom_window_nfree];
+
+  unpack_instr(p_instr, instr, index);
+  SCHED(p_instr)->target_pc = instr->addr;
+  SCHED(p_instr)->next_pc = next_pc;
+  SCHED(p_instr)->mem_addr = instr->addr;
+  SCHED(p_instr)->mem_size = instr->mem_size;
+  tail = tom->fetch_pending_head + tom->fetch_pending_count;
+  if (tail >= FETCH_WIDTH)
+    tail -= FETCH_WIDTH;
+  tom->fetch_pending[tail] = p_instr;
+  tom->fetch_pending_count++;
+
+  tom->run(tom);
 }
 
 /* 
  * Description: 
- * 	Moves instruction(s) from the dispatch stage to the issue stage
+ * 	Simulates until the instructions in flight leave the pipeline, after the
+ *      functional simulator provided the last one
  * Inputs:
- * 	current_cycle: the cycle we are at
+ * 	tom: the pipeline
  * Returns:
- * 	None
+ * 	The total number of cycles it takes to execute the instructions.
  */
-void dispatch_To_issue(int current_cycle) {
-  /* ECE552: Assignment 3 - BEGIN CODE */
+counter_t tom_finish(tom_t* tom)
+{
   int i;
-  bool issued = false;
-
-  for(i=0; i<RESERV_INT_SIZE; i=i+1)
-  {
-    if (reservINT[i] != NULL && reservINT[i]->tom_issue_cycle == 0  &&
-       reservINT[i]->tom_dispatch_cycle == (current_cycle - 1)) {
-       assert(current_cycle >= 2);
-       assert(!issued);
-       reservINT[i]->tom_issue_cycle = current_cycle;
-       issued = true;
-    }
-  }
-  for(i=0; i<RESERV_FP_SIZE; i=i+1)
-  {
-    if (reservFP[i] != NULL && reservFP[i]->tom_issue_cycle == 0  &&
-        reservFP[i]->tom_dispatch_cycle == (current_cycle - 1)) {
-       assert(current_cycle >= 2);
-       assert(!issued);
-       reservFP[i]->tom_issue_cycle = current_cycle;
-       issued = true;
-    }
+
+  if (!tom->fetch_done) {
+    tom->fetch_done = true;
+    tom->run(tom);
+
+    //the last results on the CDBs are never broadcast, unless they wait
+    //to commit
+    for (i = 0; i < tom->cdb_used && !TOM_SPECULATE; i++)
+      release_instr(tom, tom->commonDataBus[i]);
+    tom->cdb_used = 0;
+
+    tom->digest = timelog_close(tom->timelog);
+    tom->timelog = NULL;
   }
-  /* ECE552: Assignment 3 - END CODE */
+  return tom->tom_cycle;
 }
 
 /* 
  * Description: 
- * 	Grabs an instruction from the instruction trace (if possible)
+ * 	Returns the digest of the timing of all the instructions, in program
+ *      order, once the pipeline drained
  * Inputs:
- *      trace: instruction trace with all the instructions executed
+ * 	tom: the pipeline
  * Returns:
- * 	None
+ * 	The digest of the timing log
  */
-static bool end = false;
-void fetch(instruction_trace_t* trace) {
-  /* ECE552: Assignment 3 - BEGIN CODE */
-  instruction_t * f_instr;
-
-  if (fetch_index > sim_num_insn)
-  {
-#ifdef _DEBUG_
-    if(!end)
-      printf("INFO: reached the end of instruction trace execution ...\n");
-#endif
-    end = true;
-    return;
-  }
-
-  //IFQ full
-  if (instr_queue_size == INSTR_QUEUE_SIZE)
-     return;
- 
-  //skip over TRAP instructions
-  do {
-    f_instr = get_instr(trace, fetch_index++);
-  } while(IS_TRAP(f_instr->op) && instr_queue_size <= INSTR_QUEUE_SIZE);
-
-  assert(instr_queue_head >= 0 && instr_queue_head < INSTR_QUEUE_SIZE);
-
-  instr_queue[instr_queue_head++] = f_instr; 
-  if (instr_queue_head == INSTR_QUEUE_SIZE)
-     instr_queue_head = 0; 
-  ++instr_queue_size;
-  /* ECE552: Assignment 3 - END CODE */
-}
-
-/* ECE552: Assignment 3 - BEGIN CODE */
-//update the MAP table during dispatch
-void d_update_mt(instruction_t * d_instr)
+qword_t tom_digest(tom_t* tom)
 {
-  //update MAP table
-  if (d_instr->r_out[0] != DNA)
-  {
-     map_table[d_instr->r_out[0]] = d_instr;
-  } 
-  if (d_instr->r_out[1] != DNA)
-  {
-     map_table[d_instr->r_out[1]] = d_instr;
-  } 
+  assert(tom->fetch_done);
+  return tom->digest;
 }
-/* ECE552: Assignment 3 - END CODE */
 
 /* 
  * Description: 
- * 	Calls fetch and dispatches an instruction at the same cycle (if possible)
+ * 	Times the instructions of a trace recorded before with a new pipeline,
+ *      as if the functional simulator provided them; the trace is only read
  * Inputs:
- *      trace: instruction trace with all the instructions executed
- * 	current_cycle: the cycle we are at
+ *      config: the parameters of the pipeline
+ *      trace: the trace, its timing is not written back
+ *      end_pc: the address of the instruction executed after the trace
  * Returns:
- * 	None
+ * 	The total number of cycles it takes to execute the instructions.
  */
-void fetch_To_dispatch(instruction_trace_t* trace, int current_cycle) {
-  /* ECE552: Assignment 3 - BEGIN CODE */
-  int i;
-  instruction_t * d_rs;
-  fetch(trace);
-
-  assert(instr_queue_tail >= 0 && instr_queue_tail < INSTR_QUEUE_SIZE);
-  if (instr_queue_size == 0) {
-    assert(end);
-    return;
-  }
-  assert(instr_queue_size > 0 && instr_queue_size <= INSTR_QUEUE_SIZE);
-
-  d_rs = instr_queue[instr_queue_tail]; 
-
-  d_rs->tom_dispatch_cycle = 0;
-  d_rs->tom_issue_cycle = 0;
-  d_rs->tom_execute_cycle = 0;
-  d_rs->tom_cdb_cycle = 0;
-
-  if (USES_INT_FU(d_rs->op))
-  {
-    for(i=0; i<RESERV_INT_SIZE; ++i)
-    {
-      if (reservINT[i] == NULL) {
-         d_rs->tom_dispatch_cycle = current_cycle;
-         reservINT[i] = d_rs;
-         //check for RAWs, update TAGs
-         for (i = 0; i < 3; ++i)
-         {
-            //note: NULL value == free of RAW (i.e. tag)
-            d_rs->Q[i] = map_table[d_rs->r_in[i]];
-         } 
-         //update map table
-         d_update_mt(d_rs);
-        break;
-      }
-    }
-  }
-  else if (USES_FP_FU(d_rs->op))
-  {
-    for(i=0; i<RESERV_FP_SIZE; ++i)
-    {
-      if (reservFP[i] == NULL) {
-         d_rs->tom_dispatch_cycle = current_cycle;
-         reservFP[i] = d_rs;
-         //check for RAWs, update TAGs
-         for (i = 0; i < 3; ++i)
-         {
-            //note: NULL value == free of RAW (i.e. tag)
-            d_rs->Q[i] = map_table[d_rs->r_in[i]];
-         } 
-         //update map table
-         d_update_mt(d_rs);
-         break;
-      }
-    }
-  }
-  else if (IS_UNCOND_CTRL(d_rs->op) || IS_COND_CTRL(d_rs->op))
-  {
-    d_rs->tom_dispatch_cycle = current_cycle;
-    /*
-    *  unconditional & conditional branches ar enot issued to the reservation stations
-    *  they do not use any FU, they do not write to the CDB
-    *  they do not cause a control hazard
-    */
-  }
-  else
-  {
-    d_rs->tom_dispatch_cycle = current_cycle;
-  }
-
-  //skip update if a RS was not found
-  if (d_rs->tom_dispatch_cycle == 0)
-    return;
-
-
-  //IFQ tail ptr update
-  ++instr_queue_tail;
-  if (instr_queue_tail == INSTR_QUEUE_SIZE)
-     instr_queue_tail = 0;
-  --instr_queue_size;
-
-  /* ECE552: Assignment 3 - END CODE */
+counter_t tom_time_trace(const tom_config_t* config,
+                         const instruction_trace_t* trace, md_addr_t end_pc)
+{
+  tom_t * tom = tom_create(config, NULL, NULL);
+  counter_t cycles;
+  counter_t index;
+
+  for (index = 1; index < trace->size; index++)
+    tom_push(tom, get_instr(trace, index), index,
+             (index + 1 < trace->size) ? get_instr(trace, index + 1)->pc
+                                       : end_pc);
+  cycles = tom_finish(tom);
+  tom_free(tom);
+  return cycles;
 }
 
 /* 
  * Description: 
- * 	Performs a cycle-by-cycle simulation of the 4-stage pipeline
+ * 	Registers the statistics of the pipeline, the occupancies are averaged
+ *      over sim_num_tom_cycles
  * Inputs:
- *      trace: instruction trace with all the instructions executed
+ * 	tom: the pipeline
+ * 	sdb: the stats database
  * Returns:
- * 	The total number of cycles it takes to execute the instructions.
- * Extra Notes:
- * 	sim_num_insn: the number of instructions in the trace
+ * 	None
  */
-counter_t runTomasulo(instruction_trace_t* trace)
+void tom_reg_stats(tom_t* tom, struct stat_sdb_t* sdb)
 {
-  //initialize instruction queue
-  int i, reg;
-  
-  for (i = 0; i < INSTR_QUEUE_SIZE; i++) {
-    instr_queue[i] = NULL;
-  }
-
-  //initialize reservation stations
-  for (i = 0; i < RESERV_INT_SIZE; i++) {
-      reservINT[i] = NULL;
-  }
-
-  for(i = 0; i < RESERV_FP_SIZE; i++) {
-      reservFP[i] = NULL;
+  //branches are only predicted with a ROB
+  if (TOM_SPECULATE) {
+    stat_reg_counter(sdb, "tom_branches",
+		     "total number of branches fetched",
+		     &tom->tom_branches, 0, NULL);
+    stat_reg_counter(sdb, "tom_mispredicts",
+		     "total number of mispredicted branches",
+		     &tom->tom_mispredicts, 0, NULL);
+    stat_reg_formula(sdb, "tom_mispred_rate",
+		     "branch misprediction rate",
+		     "tom_mispredicts / tom_branches", NULL);
+    stat_reg_counter(sdb, "tom_mispred_stall",
+		     "cycles fetch waited for mispredicted branches",
+		     &tom->tom_mispred_stall, 0, NULL);
   }
-
-  //initialize functional units
-  for (i = 0; i < FU_INT_SIZE; i++) {
-    fuINT[i] = NULL;
-  }
-
-  for (i = 0; i < FU_FP_SIZE; i++) {
-    fuFP[i] = NULL;
-  }
-
-  //initialize map_table to no producers int reg;
-  for (reg = 0; reg < MD_TOTAL_REGS; reg++) {
-    map_table[reg] = NULL;
-  }
-  
-  int cycle = 1;
-  /* ECE552: Assignment 3 - BEGIN CODE */
-  while (true) {
-     fetch_To_dispatch(trace, cycle);
-     dispatch_To_issue(cycle);
-     issue_To_execute(cycle);
-     execute_To_CDB(cycle);
-     CDB_To_retire(cycle);
-     cycle++;
-
-     if (is_simulation_done(sim_num_insn)) {
-        check_all(trace, 1000000); 
-        break;
-     }
-  }
-  
-  /* ECE552: Assignment 3 - END CODE */
-  return cycle;
+  stat_reg_counter(sdb, "tom_cdb_stall",
+		   "instruction-cycles a completed instruction waited for a CDB",
+		   &tom->tom_cdb_stall, 0, NULL);
+  stat_reg_counter(sdb, "tom_cdb_stall_cycles",
+		   "cycles a completed instruction waited for a CDB",
+		   &tom->tom_cdb_stall_cycles, 0, NULL);
+  stat_reg_formula(sdb, "tom_cdb_stall_rate",
+		   "fraction of cycles a completed instruction waited for a CDB",
+		   "tom_cdb_stall_cycles / sim_num_tom_cycles", NULL);
+  stat_reg_counter(sdb, "tom_ifq_count",
+		   "cumulative IFQ occupancy", &tom->tom_ifq_count, 0, NULL);
+  stat_reg_formula(sdb, "tom_ifq_occupancy", "avg IFQ occupancy (insn's)",
+		   "tom_ifq_count / sim_num_tom_cycles", NULL);
+  stat_reg_counter(sdb, "tom_rs_int_count",
+		   "cumulative integer RS occupancy",
+		   &tom->tom_rs_int_count, 0, NULL);
+  stat_reg_formula(sdb, "tom_rs_int_occupancy",
+		   "avg integer RS occupancy (insn's)",
+		   "tom_rs_int_count / sim_num_tom_cycles", NULL);
+  stat_reg_counter(sdb, "tom_rs_fp_count",
+		   "cumulative floating-point RS occupancy",
+		   &tom->tom_rs_fp_count, 0, NULL);
+  stat_reg_formula(sdb, "tom_rs_fp_occupancy",
+		   "avg floating-point RS occupancy (insn's)",
+		   "tom_rs_fp_count / sim_num_tom_cycles", NULL);
+  stat_reg_counter(sdb, "tom_fu_int_count",
+		   "cumulative integer FU occupancy",
+		   &tom->tom_fu_int_count, 0, NULL);
+  stat_reg_formula(sdb, "tom_fu_int_occupancy",
+		   "avg integer FU occupancy (insn's)",
+		   "tom_fu_int_count / sim_num_tom_cycles", NULL);
+  stat_reg_counter(sdb, "tom_fu_fp_count",
+		   "cumulative floating-point FU occupancy",
+		   &tom->tom_fu_fp_count, 0, NULL);
+  stat_reg_formula(sdb, "tom_fu_fp_occupancy",
+		   "avg floating-point FU occupancy (insn's)",
+		   "tom_fu_fp_count / sim_num_tom_cycles", NULL);
+  stat_reg_counter(sdb, "tom_rob_count",
+		   "cumulative ROB occupancy", &tom->tom_rob_count, 0, NULL);
+  stat_reg_formula(sdb, "tom_rob_occupancy", "avg ROB occupancy (insn's)",
+		   "tom_rob_count / sim_num_tom_cycles", NULL);
+  stat_reg_counter(sdb, "tom_lsq_count",
+		   "cumulative LSQ occupancy", &tom->tom_lsq_count, 0, NULL);
+  stat_reg_formula(sdb, "tom_lsq_occupancy", "avg LSQ occupancy (insn's)",
+		   "tom_lsq_count / sim_num_tom_cycles", NULL);
+  stat_reg_counter(sdb, "tom_lsq_forwards",
+		   "total number of loads forwarded from an older store",
+		   &tom->tom_lsq_forwards, 0, NULL);
+  stat_reg_counter(sdb, "tom_lsq_blocked",
+		   "total number of loads that waited for an older store",
+		   &tom->tom_lsq_blocked, 0, NULL);
+  stat_reg_counter(sdb, "tom_lsq_violations",
+		   "total number of speculative loads that passed a store "
+		   "to the same address", &tom->tom_lsq_violations, 0, NULL);
 }
+
+/* THE PIPELINE WITH THE DEFAULT PARAMETERS */
+
+//a second copy of the stages, with the default parameters as constants so
+//the compiler folds the tests and loops over them; tom_create() runs it when
+//the -tom:* options equal the defaults, and the results are the same
+
+#undef INSTR_QUEUE_SIZE
+#undef RESERV_INT_SIZE
+#undef RESERV_FP_SIZE
+#undef FU_INT_SIZE
+#undef FU_FP_SIZE
+#undef FU_INT_LATENCY
+#undef FU_FP_LATENCY
+#undef ROB_SIZE
+#undef MISPRED_PENALTY
+#undef FETCH_WIDTH
+#undef ISSUE_WIDTH
+#undef CDB_COUNT
+#undef LSQ_SIZE
+#undef LSQ_PORTS
+#undef LSQ_SPEC
+
+#define INSTR_QUEUE_SIZE   TOM_DEFAULT_IFQ_SIZE
+
+#define RESERV_INT_SIZE    TOM_DEFAULT_RS_INT_SIZE
+#define RESERV_FP_SIZE     TOM_DEFAULT_RS_FP_SIZE
+#define FU_INT_SIZE        TOM_DEFAULT_FU_INT_SIZE
+#define FU_FP_SIZE         TOM_DEFAULT_FU_FP_SIZE
+
+#define FU_INT_LATENCY     TOM_DEFAULT_FU_INT_LATENCY
+#define FU_FP_LATENCY      TOM_DEFAULT_FU_FP_LATENCY
+
+#define ROB_SIZE           TOM_DEFAULT_ROB_SIZE
+#define MISPRED_PENALTY    TOM_DEFAULT_MISPRED_PENALTY
+
+#define FETCH_WIDTH        TOM_DEFAULT_WIDTH
+#define ISSUE_WIDTH        TOM_DEFAULT_ISSUE_WIDTH
+#define CDB_COUNT          TOM_DEFAULT_CDB_COUNT
+
+#define LSQ_SIZE           TOM_DEFAULT_LSQ_SIZE
+#define LSQ_PORTS          TOM_DEFAULT_LSQ_PORTS
+#define LSQ_SPEC           TOM_DEFAULT_LSQ_SPEC
+
+#define print_check_instr    tom_fixed_print_check_instr
+#define check_dispatch_order tom_fixed_check_dispatch_order
+#define release_instr        tom_fixed_release_instr
+#define insert_by_age        tom_fixed_insert_by_age
+#define schedule_completion  tom_fixed_schedule_completion
+#define ready_list           tom_fixed_ready_list
+#define mem_overlap          tom_fixed_mem_overlap
+#define store_known          tom_fixed_store_known
+#define lsq_disambiguate     tom_fixed_lsq_disambiguate
+#define load_access          tom_fixed_load_access
+#define lsq_remove           tom_fixed_lsq_remove
+#define predict_branch       tom_fixed_predict_branch
+#define resolve_branch       tom_fixed_resolve_branch
+#define commit               tom_fixed_commit
+#define is_simulation_done   tom_fixed_is_simulation_done
+#define CDB_To_retire        tom_fixed_CDB_To_retire
+#define execute_To_CDB       tom_fixed_execute_To_CDB
+#define issue_To_execute     tom_fixed_issue_To_execute
+#define lsq_To_execute       tom_fixed_lsq_To_execute
+#define dispatch_To_issue    tom_fixed_dispatch_To_issue
+#define fetch                tom_fixed_fetch
+#define d_update_mt          tom_fixed_d_update_mt
+#define d_read_tags          tom_fixed_d_read_tags
+#define dispatch_instr       tom_fixed_dispatch_instr
+#define fetch_To_dispatch    tom_fixed_fetch_To_dispatch
+#define next_active_cycle    tom_fixed_next_active_cycle
+#define tom_count_occupancy  tom_fixed_count_occupancy
+#define tom_step             tom_fixed_step
+#define tom_run              tom_fixed_run
+
+#include "tompipe.def"
@@ -0,0 +1,95 @@
+#ifndef TOMASULO_H
+#define TOMASULO_H
+
+#include "host.h"
+#include "machine.h"
+#include "stats.h"
+#include "instr.h"
+
+struct bpred_t;
+struct cache_t;
+
+//default parameters of the Tomasulo pipeline
+#define TOM_DEFAULT_IFQ_SIZE        10
+#define TOM_DEFAULT_RS_INT_SIZE     4
+#define TOM_DEFAULT_RS_FP_SIZE      2
+#define TOM_DEFAULT_FU_INT_SIZE     2
+#define TOM_DEFAULT_FU_FP_SIZE      1
+#define TOM_DEFAULT_FU_INT_LATENCY  4
+#define TOM_DEFAULT_FU_FP_LATENCY   9
+#define TOM_DEFAULT_ROB_SIZE        0    //no ROB, branches never stall
+#define TOM_DEFAULT_MISPRED_PENALTY 3
+#define TOM_DEFAULT_WIDTH           1    //fetch and dispatch width
+#define TOM_DEFAULT_ISSUE_WIDTH     0    //no limit besides the FUs
+#define TOM_DEFAULT_CDB_COUNT       1
+#define TOM_DEFAULT_LSQ_SIZE        0    //no LSQ, loads and stores use the
+                                         //integer RS and FUs
+#define TOM_DEFAULT_LSQ_PORTS       2
+#define TOM_DEFAULT_LSQ_SPEC        0    //loads wait for older stores
+
+//parameters of the Tomasulo pipeline
+typedef struct tom_config
+{
+  int ifq_size;        //instruction queue entries
+  int rs_int_size;     //integer reservation stations
+  int rs_fp_size;      //floating-point reservation stations
+  int fu_int_size;     //integer functional units
+  int fu_fp_size;      //floating-point functional units
+  int fu_int_latency;  //integer FU latency, in cycles
+  int fu_fp_latency;   //floating-point FU latency, in cycles
+  int rob_size;        //reorder buffer entries, 0 for none
+  int mispred_penalty; //cycles to refetch after a misprediction resolves
+  struct bpred_t* bpred; //branch predictor, NULL for perfect prediction,
+                         //only used with a reorder buffer
+  int width;           //instructions fetched and dispatched per cycle
+  int issue_width;     //instructions issued to the FUs per cycle, 0 for
+                       //no limit besides the FUs
+  int cdb_count;       //common data buses
+  int lsq_size;        //load/store queue entries, 0 for none
+  int lsq_ports;       //loads and stores generating their address per cycle
+  int lsq_spec;        //true if loads may pass older stores whose address
+                       //is not known yet
+  struct cache_t* dl1; //data cache loads access through the LSQ, NULL for
+                       //the integer FU latency
+}tom_config_t;
+
+//state of a Tomasulo pipeline, each one is independent of the others
+typedef struct tom_t tom_t;
+
+//creates a pipeline to start a new simulation with the given parameters,
+//the timing of each instruction is written back to trace unless it is NULL,
+//and logged in program order to the file log_fname unless it is NULL
+extern tom_t* tom_create(const tom_config_t* config,
+                         instruction_trace_t* trace, const char* log_fname);
+
+//frees a pipeline, but not its predictor, cache or trace
+extern void tom_free(tom_t* tom);
+
+//registers the statistics of the pipeline, sim_num_tom_cycles has to be
+//registered first
+extern void tom_reg_stats(tom_t* tom, struct stat_sdb_t* sdb);
+
+//provides the next executed instruction, the index-th, to the pipeline,
+//simulating cycles until the pipeline fetches it; next_pc is the address of
+//the next instruction executed
+extern void tom_push(tom_t* tom, const trace_instr_t* instr, counter_t index,
+                     md_addr_t next_pc);
+
+//simulates until the pipeline drains after the last instruction was
+//provided, returns the total number of cycles
+extern counter_t tom_finish(tom_t* tom);
+
+//returns the digest of the timing of all the instructions in program order,
+//after tom_finish(); runs agree on the timing if and only if (but for hash
+//collisions) they agree on the digest
+extern qword_t tom_digest(tom_t* tom);
+
+//times all the instructions of a recorded trace with a new pipeline, and
+//returns the total number of cycles; the trace is only read, so several
+//threads can time it at once, each with its own predictor and cache;
+//end_pc is the address of the instruction executed after the trace
+extern counter_t tom_time_trace(const tom_config_t* config,
+                                const instruction_trace_t* trace,
+                                md_addr_t end_pc);
+
+#endif
@@ -0,0 +1,44 @@
+//tomlogdump - prints a Tomasulo timing log written by sim-safe -tom:log as
+//the Tomasulo table -tom:print prints, and its digest to stderr
+//
+//usage: tomlogdump <log file>|-
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "instr.h"
+#include "timelog.h"
+
+int main(int argc, char** argv) {
+  timelog_reader_t* reader;
+  timelog_rec_t rec;
+  qword_t digest;
+
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <log file>|-\n", argv[0]);
+    exit(1);
+  }
+
+  //the instructions are disassembled
+  md_init_decoder();
+
+  reader = timelog_open(argv[1]);
+  fprintf(stdout, "TOMASULO TABLE\n");
+  while (timelog_read(reader, &rec)) {
+    md_print_insn(rec.inst, rec.pc, stdout);
+    myfprintf(stdout, "\t%n\t%n\t%n\t%n\n",
+              rec.timing.dispatch,
+              rec.timing.issue,
+              rec.timing.execute,
+              rec.timing.cdb);
+  }
+  digest = timelog_reader_close(reader);
+
+  fprintf(stderr, "%-20s 0x%08lx%08lx # digest of the Tomasulo timing\n",
+          "tom_timing_digest", (unsigned long)(digest >> 32),
+          (unsigned long)(digest & 0xffffffff));
+  return 0;
+}
@@ -483,6 +483,191 @@ bpred_after_priming(struct bpred_t *bpred)
   bpred->ras_hits = 0;
 }
 
+/* save the table of direction predictor PRED_DIR to checkpoint CK, or
+   restore it from it */
+static void
+bpred_dir_chkpt(struct bpred_dir_t *pred_dir,	/* branch dir predictor inst */
+		struct chkpt_t *ck)		/* checkpoint */
+{
+  chkpt_check(ck, "a direction predictor class", pred_dir->class);
+
+  switch (pred_dir->class) {
+  case BPred2Level:
+    chkpt_check(ck, "a 2-level predictor l1 size",
+		pred_dir->config.two.l1size);
+    chkpt_check(ck, "a 2-level predictor l2 size",
+		pred_dir->config.two.l2size);
+    chkpt_check(ck, "a 2-level predictor history width",
+		pred_dir->config.two.shift_width);
+    chkpt_xfer(ck, pred_dir->config.two.shiftregs,
+	       pred_dir->config.two.l1size * sizeof(int));
+    chkpt_xfer(ck, pred_dir->config.two.l2table,
+	       pred_dir->config.two.l2size * sizeof(unsigned char));
+    break;
+
+  case BPred2bit:
+    chkpt_check(ck, "a bimodal predictor size", pred_dir->config.bimod.size);
+    chkpt_xfer(ck, pred_dir->config.bimod.table,
+	       pred_dir->config.bimod.size * sizeof(unsigned char));
+    break;
+
+  default:
+    panic("bogus branch direction predictor class");
+  }
+}
+
+/* save the class and table sizes of predictor PRED to checkpoint CK, or
+   check the saved ones are those of PRED, naming both if they are not */
+void
+bpred_chkpt_config(struct bpred_t *pred,/* branch predictor instance */
+		   struct chkpt_t *ck)	/* checkpoint */
+{
+  static char *class_names[BPred_NUM] =
+    { "comb", "2lev", "bimod", "taken", "nottaken" };
+  char buf[256], *p = buf;
+  struct bpred_dir_t *dir;
+
+  /* in the syntax of the options that configure them */
+  p += sprintf(p, "-bpred %s", class_names[pred->class]);
+  if ((dir = pred->dirpred.bimod) != NULL && dir->class == BPred2bit)
+    p += sprintf(p, " -bpred:bimod %u", dir->config.bimod.size);
+  if ((dir = pred->dirpred.twolev) != NULL)
+    p += sprintf(p, " -bpred:2lev %d %d %d %d",
+		 dir->config.two.l1size, dir->config.two.l2size,
+		 dir->config.two.shift_width, dir->config.two.xor);
+  if ((dir = pred->dirpred.meta) != NULL)
+    p += sprintf(p, " -bpred:comb %u", dir->config.bimod.size);
+  if (pred->class != BPredTaken && pred->class != BPredNotTaken)
+    p += sprintf(p, " -bpred:ras %d -bpred:btb %d %d",
+		 pred->retstack.size, pred->btb.sets, pred->btb.assoc);
+
+  chkpt_string(ck, "a branch predictor", buf);
+}
+
+/* index of BTB entry ENT of PRED, -1 for NULL */
+#define BTB_INDEX(PRED, ENT)						\
+  ((ENT) ? (int)((ENT) - (PRED)->btb.btb_data) : -1)
+
+/* BTB entry of PRED at index I, NULL for -1 */
+#define BTB_ENTRY(PRED, I)						\
+  ((I) >= 0 ? &(PRED)->btb.btb_data[(I)] : NULL)
+
+/* save the tables, BTB and return-address stack of predictor PRED to
+   checkpoint CK, or restore them from it; its stats are not saved */
+void
+bpred_chkpt(struct bpred_t *pred,	/* branch predictor instance */
+	    struct chkpt_t *ck)		/* checkpoint */
+{
+  int i, prev, next;
+  struct bpred_btb_ent_t *ent;
+
+  chkpt_check(ck, "a branch predictor class", pred->class);
+
+  if (pred->dirpred.bimod)
+    bpred_dir_chkpt(pred->dirpred.bimod, ck);
+  if (pred->dirpred.twolev)
+    bpred_dir_chkpt(pred->dirpred.twolev, ck);
+  if (pred->dirpred.meta)
+    bpred_dir_chkpt(pred->dirpred.meta, ck);
+
+  /* BTB entries with their LRU chaining as indices */
+  chkpt_check(ck, "a BTB set count", pred->btb.sets);
+  chkpt_check(ck, "a BTB associativity", pred->btb.assoc);
+  for (i=0; i < pred->btb.sets * pred->btb.assoc; i++)
+    {
+      ent = &pred->btb.btb_data[i];
+      CHKPT_XFER(ck, ent->addr);
+      CHKPT_XFER(ck, ent->op);
+      CHKPT_XFER(ck, ent->target);
+      prev = BTB_INDEX(pred, ent->prev);
+      next = BTB_INDEX(pred, ent->next);
+      CHKPT_XFER(ck, prev);
+      CHKPT_XFER(ck, next);
+      ent->prev = BTB_ENTRY(pred, prev);
+      ent->next = BTB_ENTRY(pred, next);
+    }
+
+  chkpt_check(ck, "a return-address stack size", pred->retstack.size);
+  CHKPT_XFER(ck, pred->retstack.tos);
+  for (i=0; i < pred->retstack.size; i++)
+    {
+      CHKPT_XFER(ck, pred->retstack.stack[i].addr);
+      CHKPT_XFER(ck, pred->retstack.stack[i].op);
+      CHKPT_XFER(ck, pred->retstack.stack[i].target);
+    }
+}
+
+/* save the counter pointer *PCTR of predictor PRED to checkpoint CK as the
+   direction predictor it is in and its index there, or restore it */
+static void
+bpred_chkpt_ctr(struct bpred_t *pred,	/* branch predictor instance */
+		char **pctr,		/* counter pointer */
+		struct chkpt_t *ck)	/* checkpoint */
+{
+  int i, dir = 0, index = 0;
+  unsigned char *table = NULL;
+  unsigned int size = 0;
+  struct bpred_dir_t *dirs[3];
+
+  dirs[0] = pred ? pred->dirpred.bimod : NULL;
+  dirs[1] = pred ? pred->dirpred.twolev : NULL;
+  dirs[2] = pred ? pred->dirpred.meta : NULL;
+
+  /* direction predictor 1 to 3, 0 for NULL */
+  for (i=0; !ck->restore && *pctr && i < 3; i++)
+    {
+      if (!dirs[i])
+	continue;
+      if (dirs[i]->class == BPred2Level)
+	{
+	  table = dirs[i]->config.two.l2table;
+	  size = dirs[i]->config.two.l2size;
+	}
+      else
+	{
+	  table = dirs[i]->config.bimod.table;
+	  size = dirs[i]->config.bimod.size;
+	}
+      if ((unsigned char *)*pctr >= table
+	  && (unsigned char *)*pctr < table + size)
+	{
+	  dir = i + 1;
+	  index = (unsigned char *)*pctr - table;
+	  break;
+	}
+    }
+  if (!ck->restore && *pctr && !dir)
+    panic("bogus branch predictor counter pointer");
+
+  CHKPT_XFER(ck, dir);
+  CHKPT_XFER(ck, index);
+
+  if (ck->restore)
+    {
+      if (!dir)
+	*pctr = NULL;
+      else if (dir > 3 || !dirs[dir-1])
+	fatal("checkpoint `%s' has a bogus branch predictor counter",
+	      ck->fname);
+      else if (dirs[dir-1]->class == BPred2Level)
+	*pctr = (char *)&dirs[dir-1]->config.two.l2table[index];
+      else
+	*pctr = (char *)&dirs[dir-1]->config.bimod.table[index];
+    }
+}
+
+/* save the predictor counter pointers of update *DIR_UPDATE_PTR of PRED to
+   checkpoint CK, or restore them from it, the rest of it is plain data */
+void
+bpred_chkpt_update(struct bpred_t *pred,/* branch predictor instance */
+		   struct bpred_update_t *dir_update_ptr, /* pred state ptr */
+		   struct chkpt_t *ck)	/* checkpoint */
+{
+  bpred_chkpt_ctr(pred, &dir_update_ptr->pdir1, ck);
+  bpred_chkpt_ctr(pred, &dir_update_ptr->pdir2, ck);
+  bpred_chkpt_ctr(pred, &dir_update_ptr->pmeta, ck);
+}
+
 #define BIMOD_HASH(PRED, ADDR)						\
   ((((ADDR) >> 19) ^ ((ADDR) >> MD_BR_SHIFT)) & ((PRED)->config.bimod.size-1))
     /* was: ((baddr >> 16) ^ baddr) & (pred->dirpred.bimod.size-1) */
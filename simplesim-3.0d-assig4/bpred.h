@@ -58,6 +58,7 @@
 
 #include "host.h"
 #include "misc.h"
+#include "chkpt.h"
 #include "machine.h"
 #include "stats.h"
 
@@ -272,6 +273,25 @@ bpred_update(struct bpred_t *pred,	/* branch predictor instance */
 	     enum md_opcode op,		/* opcode of instruction */
 	     struct bpred_update_t *dir_update_ptr); /* pred state pointer */
 
+/* save the class and table sizes of predictor PRED to checkpoint CK, or
+   check the saved ones are those of PRED, naming both if they are not */
+void
+bpred_chkpt_config(struct bpred_t *pred,/* branch predictor instance */
+		   struct chkpt_t *ck);	/* checkpoint */
+
+/* save the tables, BTB and return-address stack of predictor PRED to
+   checkpoint CK, or restore them from it; its stats are not saved */
+void
+bpred_chkpt(struct bpred_t *pred,	/* branch predictor instance */
+	    struct chkpt_t *ck);	/* checkpoint */
+
+/* save the predictor counter pointers of update *DIR_UPDATE_PTR of PRED to
+   checkpoint CK, or restore them from it, the rest of it is plain data */
+void
+bpred_chkpt_update(struct bpred_t *pred,/* branch predictor instance */
+		   struct bpred_update_t *dir_update_ptr, /* pred state ptr */
+		   struct chkpt_t *ck);	/* checkpoint */
+
 
 #ifdef foo0
 /* OBSOLETE */
@@ -153,17 +153,27 @@ extern "C" {
 struct evicted_tag {
   bool prefetched;
   md_addr_t tag;
+  md_addr_t pc;		/* PC that triggered the evicting prefetch */
 };
 
-std::vector<prediction_t> rpt;
-std::vector<prediction_t> p_table;
-std::vector< std::list<evicted_tag> > evicted_blks;
-std::vector< std::queue<cache_blk_t> > blk_fifos;
-std::vector<prediction_t> stream_table;
+/* ECE552 Assignment 4 - END CODE */
 
-void stream_blk_fetch(cache_t *, md_addr_t, int);
+/* prefetcher state of a cache, kept out of struct cache_t as its tables are
+   C++ containers */
+struct cache_pf_t {
+  /* ECE552 Assignment 4 - BEGIN CODE */
+  std::vector<prediction_t> rpt;
+  std::vector<prediction_t> p_table;
+  std::vector< std::list<evicted_tag> > evicted_blks;
+  std::vector< std::queue<cache_blk_t> > blk_fifos;
+  std::vector<prediction_t> stream_table;
+  /* ECE552 Assignment 4 - END CODE */
 
-/* ECE552 Assignment 4 - END CODE */
+  /* time of the demand access that triggers the prefetches being generated */
+  tick_t now;
+};
+
+void stream_blk_fetch(cache_t *, md_addr_t, int);
 
 /* unlink BLK from the hash table bucket chain in SET */
 static void
@@ -282,6 +292,596 @@ update_way_list(struct cache_set_t *set,	/* set contained way chain */
     panic("bogus WHERE designator");
 }
 
+/* locate the valid block containing ADDR in cache CP, returns NULL if the
+   block is not resident */
+static struct cache_blk_t *
+cache_find_blk(struct cache_t *cp,		/* cache to search */
+	       md_addr_t addr)			/* address of block */
+{
+  md_addr_t tag = CACHE_TAG(cp, addr);
+  md_addr_t set = CACHE_SET(cp, addr);
+  struct cache_blk_t *blk;
+
+  if (cp->hsize)
+    {
+      /* higly-associativity cache, access through the per-set hash tables */
+      int hindex = CACHE_HASH(cp, tag);
+
+      for (blk=cp->sets[set].hash[hindex]; blk; blk=blk->hash_next)
+	{
+	  if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
+	    return blk;
+	}
+    }
+  else
+    {
+      /* low-associativity cache, linear search the way list */
+      for (blk=cp->sets[set].way_head; blk; blk=blk->way_next)
+	{
+	  if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
+	    return blk;
+	}
+    }
+  return NULL;
+}
+
+/* drop the copies of the block containing ADDR held in the stream buffers
+   of cache CP, returns the number of copies dropped */
+static int					/* copies dropped */
+cache_pf_invalidate(struct cache_t *cp,		/* cache to probe */
+		    md_addr_t addr)		/* address of block */
+{
+  md_addr_t tag = CACHE_TAG(cp, addr);
+  size_t i;
+  int n, dropped = 0;
+
+  for (i=0; i < cp->pf->blk_fifos.size(); i++)
+    {
+      std::queue<cache_blk_t> &fifo = cp->pf->blk_fifos[i];
+
+      /* rotate the fifo once, keeping its order, without the stale copies */
+      for (n=fifo.size(); n > 0; n--)
+	{
+	  if (fifo.front().tag != tag)
+	    fifo.push(fifo.front());
+	  else
+	    dropped++;
+	  fifo.pop();
+	}
+    }
+  return dropped;
+}
+
+/* broadcast bus transaction CMD for the block containing ADDR from cache CP
+   to every other cache in its coherence domain, returns non-zero if another
+   cache held a valid copy; *SUPPLIED is set if a modified copy forwarded the
+   block cache-to-cache, the snooping caches perform their MESI transitions */
+static int					/* other copies existed? */
+cache_coh_snoop(struct cache_t *cp,		/* requesting cache */
+		enum cache_coh_cmd cmd,		/* bus transaction */
+		md_addr_t addr,			/* address of block */
+		tick_t now,			/* time of transaction */
+		int *supplied)			/* copy forwarded? */
+{
+  struct cache_coh_t *coh = cp->coh;
+  struct cache_t *peer;
+  struct cache_blk_t *blk;
+  int i, shared = FALSE;
+
+  switch (cmd) {
+  case BusRd:	coh->bus_reads++;	break;
+  case BusRdX:	coh->bus_readxs++;	break;
+  case BusUpgr:	coh->bus_upgrades++;	break;
+  default:
+    panic("bogus bus transaction");
+  }
+
+  for (i=0; i < coh->nsharers; i++)
+    {
+      peer = coh->sharers[i];
+      if (peer == cp)
+	continue;
+
+      /* stream buffers hold clean copies outside the MESI states, a write
+	 makes them stale so they are dropped, on a read they stay valid and
+	 snoop the bus themselves when they are moved into the cache */
+      if (peer->pf && cmd != BusRd)
+	{
+	  int dropped = cache_pf_invalidate(peer, addr);
+
+	  coh->invalidations += dropped;
+	  peer->invalidations += dropped;
+	}
+
+      if (!(blk = cache_find_blk(peer, addr)))
+	continue;
+
+      shared = TRUE;
+      coh->snoop_hits++;
+
+      /* a modified copy is the only up-to-date copy, it supplies the block */
+      if ((blk->status & CACHE_BLK_DIRTY) && cmd != BusUpgr)
+	{
+	  coh->c2c_transfers++;
+	  if (supplied)
+	    *supplied = TRUE;
+
+	  /* on a read the owner also updates the shared level and keeps a
+	     clean copy, on a write miss the dirty data moves to the requester */
+	  if (cmd == BusRd)
+	    {
+	      peer->writebacks++;
+	      peer->blk_access_fn(Write, CACHE_BADDR(peer, addr), peer->bsize,
+				  blk, now, 0);
+	    }
+	}
+
+      if (cmd == BusRd)
+	{
+	  /* M/E/S -> S */
+	  blk->status &= ~(CACHE_BLK_EXCL|CACHE_BLK_DIRTY);
+	}
+      else
+	{
+	  /* M/E/S -> I */
+	  coh->invalidations++;
+	  peer->invalidations++;
+	  blk->status &= ~(CACHE_BLK_VALID|CACHE_BLK_EXCL|CACHE_BLK_DIRTY);
+
+	  /* blow away the last block to hit */
+	  if (peer->last_blk == blk)
+	    {
+	      peer->last_tagset = 0;
+	      peer->last_blk = NULL;
+	    }
+
+	  /* move this block to tail of the way (LRU) list */
+	  update_way_list(&peer->sets[CACHE_SET(peer, addr)], blk, Tail);
+	}
+    }
+  return shared;
+}
+
+/* create a coherence domain, private caches are attached to it with
+   cache_coh_attach() */
+struct cache_coh_t *			/* pointer to domain created */
+cache_coh_create(char *name)		/* name of the coherence domain */
+{
+  struct cache_coh_t *coh;
+
+  coh = (struct cache_coh_t *)calloc(1, sizeof(struct cache_coh_t));
+  if (!coh)
+    fatal("out of virtual memory");
+
+  coh->name = mystrdup(name);
+  coh->nsharers = 0;
+  return coh;
+}
+
+/* attach private cache CP to coherence domain COH, all caches in a domain
+   must use the same block size */
+void
+cache_coh_attach(struct cache_coh_t *coh,/* coherence domain */
+		 struct cache_t *cp)	/* private cache to attach */
+{
+  if (cp->coh)
+    fatal("cache `%s' is already attached to coherence domain `%s'",
+	  cp->name, cp->coh->name);
+  if (coh->nsharers == CACHE_COH_MAX_SHARERS)
+    fatal("coherence domain `%s' supports at most %d caches",
+	  coh->name, CACHE_COH_MAX_SHARERS);
+  if (coh->nsharers && coh->sharers[0]->bsize != cp->bsize)
+    fatal("cache `%s' block size `%d' differs from coherence domain `%s'",
+	  cp->name, cp->bsize, coh->name);
+
+  coh->sharers[coh->nsharers++] = cp;
+  cp->coh = coh;
+}
+
+/* register coherence domain stats */
+void
+cache_coh_reg_stats(struct cache_coh_t *coh,/* coherence domain */
+		    struct stat_sdb_t *sdb)/* stats database */
+{
+  char buf[512], buf1[512], *name = coh->name;
+
+  sprintf(buf, "%s.bus_reads", name);
+  stat_reg_counter(sdb, buf, "total number of BusRd transactions",
+		   &coh->bus_reads, 0, NULL);
+  sprintf(buf, "%s.bus_readxs", name);
+  stat_reg_counter(sdb, buf, "total number of BusRdX transactions",
+		   &coh->bus_readxs, 0, NULL);
+  sprintf(buf, "%s.bus_upgrades", name);
+  stat_reg_counter(sdb, buf, "total number of BusUpgr transactions",
+		   &coh->bus_upgrades, 0, NULL);
+  sprintf(buf, "%s.snoop_hits", name);
+  stat_reg_counter(sdb, buf, "total number of snoops that found a copy",
+		   &coh->snoop_hits, 0, NULL);
+  sprintf(buf, "%s.c2c_transfers", name);
+  stat_reg_counter(sdb, buf, "total number of cache-to-cache transfers",
+		   &coh->c2c_transfers, 0, NULL);
+  sprintf(buf, "%s.invalidations", name);
+  stat_reg_counter(sdb, buf, "total number of snoop invalidations",
+		   &coh->invalidations, 0, NULL);
+  sprintf(buf, "%s.snoop_hit_rate", name);
+  sprintf(buf1, "%s.snoop_hits / (%s.bus_reads + %s.bus_readxs + %s.bus_upgrades)",
+	  name, name, name, name);
+  stat_reg_formula(sdb, buf, "fraction of bus transactions finding a copy",
+		   buf1, NULL);
+}
+
+/* way index of block BLK within set SET of cache CP */
+#define CACHE_BWAY(cp, set, blk)					\
+  ((int)(((char *)(blk) - (char *)(cp)->sets[set].blks)			\
+	 / (sizeof(struct cache_blk_t)					\
+	    + ((cp)->balloc ? (cp)->bsize*sizeof(byte_t) : 0))))
+
+/* partition the ways of cache CP among NREQS requestors, requestor I
+   allocates only into the ways set in WAY_MASKS[I] */
+void
+cache_part_create(struct cache_t *cp,	/* cache instance to partition */
+		  int nreqs,		/* number of requestors */
+		  unsigned int *way_masks)/* way mask of each requestor */
+{
+  struct cache_part_t *part;
+  unsigned int all_ways;
+  int i, j;
+
+  if (cp->assoc > (int)(sizeof(unsigned int) * 8))
+    fatal("cache `%s' is too associative (%d ways) to partition",
+	  cp->name, cp->assoc);
+  if (nreqs < 1 || nreqs > CACHE_PART_MAX_REQS)
+    fatal("cache `%s' partitioned among `%d' requestors, must be 1..%d",
+	  cp->name, nreqs, CACHE_PART_MAX_REQS);
+
+  all_ways = (cp->assoc == (int)(sizeof(unsigned int) * 8)
+	      ? ~0u : (1u << cp->assoc) - 1);
+
+  part = (struct cache_part_t *)calloc(1, sizeof(struct cache_part_t));
+  if (!part)
+    fatal("out of virtual memory");
+
+  part->nreqs = nreqs;
+  part->req = 0;
+  for (i=0; i < nreqs; i++)
+    {
+      if ((way_masks[i] & all_ways) == 0 || (way_masks[i] & ~all_ways) != 0)
+	fatal("way mask `0x%x' of requestor %d is not a valid mask for "
+	      "%d-way cache `%s'", way_masks[i], i, cp->assoc, cp->name);
+      part->way_mask[i] = way_masks[i];
+      for (part->ways[i]=0, j=0; j < cp->assoc; j++)
+	{
+	  if (way_masks[i] & (1u << j))
+	    part->ways[i]++;
+	}
+    }
+  cp->part = part;
+}
+
+/* let a utility-based (UCP) controller repartition the ways of cache CP every
+   EPOCH accesses, its utility monitors sample every (1 << UMON_SHIFT)-th set,
+   the cache must already be partitioned with cache_part_create() */
+void
+cache_part_ucp(struct cache_t *cp,	/* partitioned cache instance */
+	       counter_t epoch,		/* accesses between repartitions */
+	       int umon_shift)		/* log2 of UMON set sampling rate */
+{
+  struct cache_part_t *part = cp->part;
+  int nsampled;
+
+  if (!part)
+    fatal("cache `%s' must be partitioned before enabling UCP", cp->name);
+  if (epoch < 1)
+    fatal("UCP epoch of cache `%s' must be at least one access", cp->name);
+  if (part->nreqs > cp->assoc)
+    fatal("UCP needs at least one way of cache `%s' per requestor", cp->name);
+
+  /* sample at least one set */
+  while (umon_shift > 0 && (cp->nsets >> umon_shift) == 0)
+    umon_shift--;
+  nsampled = cp->nsets >> umon_shift;
+
+  part->epoch = epoch;
+  part->epoch_accesses = 0;
+  part->umon_shift = umon_shift;
+  part->umon_tags = (md_addr_t *)
+    calloc(part->nreqs * nsampled * cp->assoc, sizeof(md_addr_t));
+  part->umon_fill = (int *)calloc(part->nreqs * nsampled, sizeof(int));
+  part->umon_hits = (counter_t *)
+    calloc(part->nreqs * cp->assoc, sizeof(counter_t));
+  if (!part->umon_tags || !part->umon_fill || !part->umon_hits)
+    fatal("out of virtual memory");
+}
+
+/* select the replacement block of the current requestor in SET of
+   partitioned cache CP, only ways in the requestor's mask are candidates */
+static struct cache_blk_t *
+cache_part_victim(struct cache_t *cp,	/* partitioned cache */
+		  md_addr_t set)	/* set to replace in */
+{
+  unsigned int mask = cp->part->way_mask[cp->part->req];
+  struct cache_blk_t *blk;
+  int bindex, nways;
+
+  switch (cp->policy) {
+  case LRU:
+  case FIFO:
+    /* least recently used (or oldest) block of the requestor's ways */
+    for (blk=cp->sets[set].way_tail; blk; blk=blk->way_prev)
+      {
+	if (mask & (1u << CACHE_BWAY(cp, set, blk)))
+	  break;
+      }
+    assert(blk);
+    update_way_list(&cp->sets[set], blk, Head);
+    return blk;
+  case Random:
+    /* the BINDEX-th way of the requestor's mask */
+    nways = cp->part->ways[cp->part->req];
+    for (bindex = myrand() % nways; bindex > 0; bindex--)
+      mask &= mask - 1;
+    blk = CACHE_BINDEX(cp, cp->sets[set].blks, log_base2(mask & -mask));
+    assert(blk);
+    return blk;
+  default:
+    panic("bogus replacement policy");
+  }
+}
+
+/* recompute the way masks of partitioned cache CP from its utility monitors
+   with the UCP lookahead algorithm, every requestor keeps at least one way */
+static void
+cache_part_repartition(struct cache_t *cp)	/* partitioned cache */
+{
+  struct cache_part_t *part = cp->part;
+  counter_t *hits, gain;
+  int alloc[CACHE_PART_MAX_REQS];
+  int r, k, p, balance, best_req, best_k, way;
+  double best_mu, req_mu;
+
+  /* start with one way per requestor */
+  for (r=0; r < part->nreqs; r++)
+    alloc[r] = 1;
+  balance = cp->assoc - part->nreqs;
+
+  /* hand out the remaining ways to the requestor with the largest marginal
+     utility, looking ahead over any number of additional ways */
+  while (balance > 0)
+    {
+      best_req = -1;
+      best_k = 0;
+      best_mu = -1.0;
+      for (r=0; r < part->nreqs; r++)
+	{
+	  hits = &part->umon_hits[r * cp->assoc];
+	  gain = 0;
+	  for (k=1; k <= balance && alloc[r] + k <= cp->assoc; k++)
+	    {
+	      gain += hits[alloc[r] + k - 1];
+	      req_mu = (double)gain / (double)k;
+	      if (req_mu > best_mu)
+		{
+		  best_mu = req_mu;
+		  best_req = r;
+		  best_k = k;
+		}
+	    }
+	}
+      assert(best_req >= 0);
+      alloc[best_req] += best_k;
+      balance -= best_k;
+    }
+
+  /* give each requestor a contiguous range of ways, and decay the monitors
+     so utility tracks program phases */
+  for (way=0, r=0; r < part->nreqs; r++)
+    {
+      part->way_mask[r] = 0;
+      for (k=0; k < alloc[r]; k++, way++)
+	part->way_mask[r] |= (1u << way);
+      part->ways[r] = alloc[r];
+
+      if (part->ways_dist[r])
+	stat_add_sample(part->ways_dist[r], alloc[r]);
+
+      for (p=0; p < cp->assoc; p++)
+	part->umon_hits[r * cp->assoc + p] >>= 1;
+    }
+  part->repartitions++;
+}
+
+/* record an access of the current requestor to SET and TAG of partitioned
+   cache CP in its utility monitor, and repartition at the end of an epoch */
+static void
+cache_part_monitor(struct cache_t *cp,	/* partitioned cache */
+		   md_addr_t set,	/* set accessed */
+		   md_addr_t tag)	/* tag accessed */
+{
+  struct cache_part_t *part = cp->part;
+  md_addr_t *tags;
+  int *fill, nsampled, pos, i;
+
+  if (!part->umon_hits)
+    return;
+
+  /* dynamic set sampling, only every (1 << UMON_SHIFT)-th set is shadowed */
+  if ((set & ((1 << part->umon_shift) - 1)) == 0)
+    {
+      nsampled = cp->nsets >> part->umon_shift;
+      i = part->req * nsampled + (set >> part->umon_shift);
+      tags = &part->umon_tags[i * cp->assoc];
+      fill = &part->umon_fill[i];
+
+      /* find the tag in the shadow LRU stack */
+      for (pos=0; pos < *fill; pos++)
+	{
+	  if (tags[pos] == tag)
+	    break;
+	}
+
+      if (pos < *fill)
+	{
+	  /* shadow hit at LRU stack position POS */
+	  part->umon_hits[part->req * cp->assoc + pos]++;
+	}
+      else if (*fill < cp->assoc)
+	{
+	  /* shadow miss, fill an empty shadow way */
+	  pos = (*fill)++;
+	}
+      else
+	{
+	  /* shadow miss, replace the LRU shadow tag */
+	  pos = cp->assoc - 1;
+	}
+
+      /* move the tag to the MRU position */
+      for (; pos > 0; pos--)
+	tags[pos] = tags[pos-1];
+      tags[0] = tag;
+    }
+
+  if (++part->epoch_accesses >= part->epoch)
+    {
+      cache_part_repartition(cp);
+      part->epoch_accesses = 0;
+    }
+}
+
+/* account prefetches of cache CP per triggering PC */
+void
+cache_pfpc_create(struct cache_t *cp)	/* cache instance */
+{
+  cp->pfpc = (struct cache_pfpc_t *)calloc(1, sizeof(struct cache_pfpc_t));
+  if (!cp->pfpc)
+    fatal("out of virtual memory");
+}
+
+/* get the prefetch counters of PC in cache CP, allocating an entry for a new
+   PC, the table is linear probed and kept at most 3/4 full */
+static struct cache_pfpc_ent_t *
+cache_pfpc_lookup(struct cache_t *cp,	/* cache with per-PC accounting */
+		  md_addr_t pc)		/* PC to look up */
+{
+  struct cache_pfpc_t *pfpc = cp->pfpc;
+  unsigned int i;
+
+  /* PISA instructions are 8-byte aligned, mix the upper PC bits in */
+  i = (unsigned int)((pc >> 3) ^ (pc >> 15)) & (CACHE_PFPC_SIZE - 1);
+  for (;;)
+    {
+      if (pfpc->ents[i].pc == pc)
+	return &pfpc->ents[i];
+      if (pfpc->ents[i].pc == 0)
+	break;
+      i = (i + 1) & (CACHE_PFPC_SIZE - 1);
+    }
+
+  if (pc == 0 || pfpc->nused >= (CACHE_PFPC_SIZE / 4) * 3)
+    return &pfpc->overflow;
+
+  pfpc->nused++;
+  pfpc->ents[i].pc = pc;
+  return &pfpc->ents[i];
+}
+
+/* account the first reference at time NOW to prefetched block BLK of
+   cache CP */
+static void
+cache_pfpc_useful(struct cache_t *cp,	/* cache with per-PC accounting */
+		  struct cache_blk_t *blk,/* prefetched block referenced */
+		  tick_t now)		/* time of the reference */
+{
+  struct cache_pfpc_ent_t *ent = cache_pfpc_lookup(cp, blk->pf_pc);
+
+  ent->useful++;
+  if (now < blk->pf_ready)
+    ent->late++;
+}
+
+/* sort PC entries by prefetches issued, most first */
+static int
+pfpc_compare(const void *a, const void *b)
+{
+  const struct cache_pfpc_ent_t *ea = *(const struct cache_pfpc_ent_t **)a;
+  const struct cache_pfpc_ent_t *eb = *(const struct cache_pfpc_ent_t **)b;
+
+  if (ea->issued != eb->issued)
+    return ea->issued > eb->issued ? -1 : 1;
+  if (ea->misses != eb->misses)
+    return ea->misses > eb->misses ? -1 : 1;
+  return ea->pc < eb->pc ? -1 : (ea->pc > eb->pc ? 1 : 0);
+}
+
+/* print one line of the per-PC prefetch report */
+static void
+pfpc_print_ent(struct cache_pfpc_ent_t *ent,	/* entry to print */
+	       char *label,			/* PC label, NULL to print PC */
+	       FILE *stream)			/* output stream */
+{
+  if (label)
+    fprintf(stream, "%10s ", label);
+  else
+    fprintf(stream, "0x%08lx ", (unsigned long)ent->pc);
+  fprintf(stream, "%10u %10u %10u %10u %10u %8.4f %8.4f %8.4f\n",
+	  ent->misses, ent->issued, ent->useful, ent->late, ent->polluting,
+	  /* accuracy */ent->issued ? (double)ent->useful / ent->issued : 0.0,
+	  /* coverage */(ent->useful + ent->misses
+			 ? (double)ent->useful / (ent->useful + ent->misses)
+			 : 0.0),
+	  /* timeliness */(ent->useful
+			   ? (double)(ent->useful - ent->late) / ent->useful
+			   : 0.0));
+}
+
+/* print the per-PC prefetch report of cache CP, the TOPN PCs that triggered
+   the most prefetches first */
+void
+cache_pfpc_print(struct cache_t *cp,	/* cache instance */
+		 int topn,		/* number of PCs to print */
+		 FILE *stream)		/* output stream */
+{
+  struct cache_pfpc_t *pfpc = cp->pfpc;
+  struct cache_pfpc_ent_t **sorted, rest;
+  int i, n;
+
+  if (!pfpc)
+    return;
+
+  sorted = (struct cache_pfpc_ent_t **)
+    calloc(pfpc->nused + 1, sizeof(struct cache_pfpc_ent_t *));
+  if (!sorted)
+    fatal("out of virtual memory");
+  for (n=0, i=0; i < CACHE_PFPC_SIZE; i++)
+    {
+      if (pfpc->ents[i].pc != 0)
+	sorted[n++] = &pfpc->ents[i];
+    }
+  qsort(sorted, n, sizeof(struct cache_pfpc_ent_t *), pfpc_compare);
+
+  fprintf(stream, "\n%s prefetches by PC (top %d of %d PCs)\n",
+	  cp->name, MIN(topn, n), n);
+  fprintf(stream, "%10s %10s %10s %10s %10s %10s %8s %8s %8s\n",
+	  "pc", "misses", "issued", "useful", "late", "polluting",
+	  "accuracy", "coverage", "timely");
+  for (i=0; i < MIN(topn, n); i++)
+    pfpc_print_ent(sorted[i], NULL, stream);
+
+  /* everything not printed above */
+  rest = pfpc->overflow;
+  for (; i < n; i++)
+    {
+      rest.misses += sorted[i]->misses;
+      rest.issued += sorted[i]->issued;
+      rest.useful += sorted[i]->useful;
+      rest.late += sorted[i]->late;
+      rest.polluting += sorted[i]->polluting;
+    }
+  pfpc_print_ent(&rest, "other", stream);
+
+  free(sorted);
+}
+
 /* create and initialize a general cache structure */
 struct cache_t *			/* pointer to cache created */
 cache_create(char *name,		/* name of the cache */
@@ -341,19 +941,21 @@ cache_create(char *name,		/* name of the cache */
   cp->hit_latency = hit_latency;
   cp->prefetch_type = prefetch_type;
 
-  /* ECE552 Assignment 4 - BEGIN CODE */
-  if (rpt.size() == 0) {
-    rpt.resize(prefetch_type, (prediction_t) { 0, 0, 0, 0 });
+  /* the prefetcher state, each cache has its own */
+  cp->pf = NULL;
+  if (prefetch_type) {
+     cp->pf = new cache_pf_t;
+     cp->pf->now = 0;
+
+     /* ECE552 Assignment 4 - BEGIN CODE */
+     cp->pf->rpt.resize(prefetch_type, (prediction_t) { 0, 0, 0, 0 });
+     cp->pf->evicted_blks.resize(nsets, std::list<evicted_tag>());
+     cp->pf->p_table.resize(256, (prediction_t) { 0, 0, 0, 0 });
+     cp->pf->blk_fifos.resize(32, std::queue<cache_blk_t>());
+     cp->pf->stream_table.resize(32, (prediction_t) { 0, 0, 0, 0 });
+     /* ECE552 Assignment 4 - END CODE */
   }
 
-  if (strcmp(cp->name, "dl1") == 0) {
-     evicted_blks.resize(nsets, std::list<evicted_tag>());
-     p_table.resize(256, (prediction_t) { 0, 0, 0, 0 });
-     blk_fifos.resize(32, std::queue<cache_blk_t>());
-     stream_table.resize(32, (prediction_t) { 0, 0, 0, 0 });
-  }
-  /* ECE552 Assignment 4 - END CODE */
-
 
   /* miss/replacement functions */
   cp->blk_access_fn = blk_access_fn;
@@ -394,6 +996,15 @@ cache_create(char *name,		/* name of the cache */
   cp->prefetch_aggr = 0;
   /* ECE552 Assignment 4 - END CODE */
 
+  /* not part of a coherence domain until attached */
+  cp->coh = NULL;
+
+  /* not partitioned until cache_part_create() */
+  cp->part = NULL;
+
+  /* no per-PC prefetch accounting until cache_pfpc_create() */
+  cp->pfpc = NULL;
+
   /* blow away the last block accessed */
   cp->last_tagset = 0;
   cp->last_blk = NULL;
@@ -437,6 +1048,8 @@ cache_create(char *name,		/* name of the cache */
 	  blk->status = 0;		
 	  blk->tag = 0;
 	  blk->ready = 0;
+	  blk->pf_pc = 0;
+	  blk->pf_ready = 0;
 	  blk->user_data = (usize != 0
 			    ? (byte_t *)calloc(usize, sizeof(byte_t)) : NULL);
 
@@ -546,9 +1159,15 @@ cache_reg_stats(struct cache_t *cp,	/* cache instance */
   stat_reg_formula(sdb, buf, "read miss rate", buf1, NULL);
   
 /* ECE552 Assignment 4 - BEGIN CODE */
-  sprintf(buf, "%s.prefetch_accuracy", name);
-  sprintf(buf1, "%s.prefetch_useful_cnt / %s.prefetch_cnt", name, name);
-  stat_reg_formula(sdb, buf, "accuracy of prefetch accesses", buf1, "%12.0f");
+  /* a cache without a prefetcher never prefetches, its accuracy would only
+     divide by zero */
+  if (cp->prefetch_type)
+    {
+      sprintf(buf, "%s.prefetch_accuracy", name);
+      sprintf(buf1, "%s.prefetch_useful_cnt / %s.prefetch_cnt", name, name);
+      stat_reg_formula(sdb, buf, "accuracy of prefetch accesses", buf1,
+		       "%12.0f");
+    }
   sprintf(buf, "%s.prefetch_cnt", name);
   stat_reg_counter(sdb, buf, "total number of prefetches", &cp->prefetch_cnt, 0, NULL);
   sprintf(buf, "%s.prefetch_useful_cnt", name);
@@ -557,6 +1176,39 @@ cache_reg_stats(struct cache_t *cp,	/* cache instance */
   stat_reg_counter(sdb, buf, "total number of misses caused by prefetch evictions", &cp->prefetch_misses, 0, NULL);
 /* ECE552 Assignment 4 - END CODE */
 
+  if (cp->part)
+    {
+      struct cache_part_t *part = cp->part;
+      int r;
+
+      sprintf(buf, "%s.repartitions", name);
+      stat_reg_counter(sdb, buf, "total number of UCP repartitions",
+		       &part->repartitions, 0, NULL);
+      for (r=0; r < part->nreqs; r++)
+	{
+	  sprintf(buf, "%s.p%d.hits", name, r);
+	  stat_reg_counter(sdb, buf, "hits of requestor",
+			   &part->hits[r], 0, NULL);
+	  sprintf(buf, "%s.p%d.misses", name, r);
+	  stat_reg_counter(sdb, buf, "misses of requestor",
+			   &part->misses[r], 0, NULL);
+	  sprintf(buf, "%s.p%d.hit_rate", name, r);
+	  sprintf(buf1, "%s.p%d.hits / (%s.p%d.hits + %s.p%d.misses)",
+		  name, r, name, r, name, r);
+	  stat_reg_formula(sdb, buf, "hit rate of requestor", buf1, NULL);
+	  if (part->umon_hits)
+	    {
+	      /* allocation history, one sample per repartition */
+	      sprintf(buf, "%s.p%d.ways", name, r);
+	      part->ways_dist[r] =
+		stat_reg_dist(sdb, buf, "ways allocated to requestor per epoch",
+			      /* initial */0, /* array size */cp->assoc + 1,
+			      /* bucket size */1, (PF_COUNT|PF_PDF),
+			      NULL, NULL, NULL);
+	    }
+	}
+    }
+
 }
 
 #ifdef __cplusplus
@@ -571,7 +1223,7 @@ void stream_blk_fetch(cache_t *cp, md_addr_t addr, int stream_idx){
 
   if(cache_probe(cp, addr))
      return;
-  if(blk_fifos[stream_idx].size() >= 8)
+  if(cp->pf->blk_fifos[stream_idx].size() >= 8)
     return;
 
   md_addr_t tag = CACHE_TAG(cp, addr);
@@ -582,15 +1234,19 @@ void stream_blk_fetch(cache_t *cp, md_addr_t addr, int stream_idx){
   s_blk.status = CACHE_BLK_VALID;	/* dirty bit set on update */
   s_blk.prefetched = 1;
   s_blk.prefetch_used = 0;
+  s_blk.pf_pc = get_PC();
 
   /* read data block */
   cp->prefetch_cnt += 1;
-  cp->blk_access_fn(Read, CACHE_BADDR(cp, addr), cp->bsize, &s_blk, NULL, 0);
+  s_blk.pf_ready = cp->pf->now + cp->blk_access_fn(Read, CACHE_BADDR(cp, addr),
+					      cp->bsize, &s_blk, NULL, 0);
+  if (cp->pfpc)
+    cache_pfpc_lookup(cp, s_blk.pf_pc)->issued++;
 
   /* update block status */
   s_blk.ready = NULL;
 
-  blk_fifos[stream_idx].push(s_blk);
+  cp->pf->blk_fifos[stream_idx].push(s_blk);
 }
 
 void fetch_cache_blk (struct cache_t *cp, md_addr_t addr) {
@@ -617,7 +1273,9 @@ void fetch_cache_blk (struct cache_t *cp, md_addr_t addr) {
 	    return;
       }
   }
-  switch (cp->policy) {
+  if (cp->part)
+    repl = cache_part_victim(cp, set);
+  else switch (cp->policy) {
   case LRU:
   case FIFO:
     repl = cp->sets[set].way_tail;
@@ -638,11 +1296,11 @@ void fetch_cache_blk (struct cache_t *cp, md_addr_t addr) {
     unlink_htab_ent(cp, &cp->sets[set], repl);
 
   /* evicted cache_blk */
-  if (evicted_blks[set].size() < cp->assoc) {
-     evicted_blks[set].push_front({true, repl->tag});
+  if (cp->pf->evicted_blks[set].size() < cp->assoc) {
+     cp->pf->evicted_blks[set].push_front({true, repl->tag, get_PC()});
   } else {
-     evicted_blks[set].pop_back();
-     evicted_blks[set].push_front({true, repl->tag});
+     cp->pf->evicted_blks[set].pop_back();
+     cp->pf->evicted_blks[set].push_front({true, repl->tag, get_PC()});
   }
 
   /* write back replaced block data */
@@ -662,14 +1320,22 @@ void fetch_cache_blk (struct cache_t *cp, md_addr_t addr) {
   repl->status = CACHE_BLK_VALID;	/* dirty bit set on update */
   repl->prefetched = 1;
   repl->prefetch_used = 0;
+  repl->pf_pc = get_PC();
+
+  /* prefetches are fetched with a BusRd, E if no other copy exists */
+  if (cp->coh && !cache_coh_snoop(cp, BusRd, addr, 0, NULL))
+    repl->status |= CACHE_BLK_EXCL;
 
   /* read data block */
   cp->prefetch_cnt += 1;
   lat += cp->blk_access_fn(Read, CACHE_BADDR(cp, addr), cp->bsize,
 			   repl, NULL, 0);
+  if (cp->pfpc)
+    cache_pfpc_lookup(cp, repl->pf_pc)->issued++;
 
-  /* update block status */
+  /* update block status, the fill time is only used for accounting */
   repl->ready = NULL;
+  repl->pf_ready = cp->pf->now + lat;
 
   /* link this entry back into the hash table */
   if (cp->hsize)
@@ -741,10 +1407,10 @@ void open_ended_prefetcher(struct cache_t *cp, md_addr_t addr) {
   
   prediction_t * match_entry = NULL;
   bool match = false;
-  if(stream_table[stream_idx].tag == pc_tag)
+  if(cp->pf->stream_table[stream_idx].tag == pc_tag)
   {
      match = true;
-     match_entry = &stream_table[stream_idx];
+     match_entry = &cp->pf->stream_table[stream_idx];
   }
 
   //no matching PC tag; assign a new entry
@@ -755,8 +1421,8 @@ void open_ended_prefetcher(struct cache_t *cp, md_addr_t addr) {
     n_entry.prev_addr = addr;
     n_entry.stride = 0;
 
-    if(blk_fifos[stream_idx].size() == 0 || stream_table[stream_idx].state == INITIAL)
-       stream_table[stream_idx] = n_entry;
+    if(cp->pf->blk_fifos[stream_idx].size() == 0 || cp->pf->stream_table[stream_idx].state == INITIAL)
+       cp->pf->stream_table[stream_idx] = n_entry;
   } else {
     int stride = (int)addr - (int)match_entry->prev_addr;
     switch(match_entry->state) {
@@ -859,7 +1525,7 @@ void stride_prefetcher(struct cache_t *cp, md_addr_t addr) {
   int rpt_set_shift = log2(cp->prefetch_type);
   int rpt_idx = pc_tag & ((1 << rpt_set_shift) - 1);
 
-  if (rpt.size() > cp->prefetch_type)
+  if (cp->pf->rpt.size() > cp->prefetch_type)
     fatal("RPT table went over the size limit \n");
   if (rpt_idx > cp->prefetch_type)
     fatal("RPT index went over the size limit \n");
@@ -867,10 +1533,10 @@ void stride_prefetcher(struct cache_t *cp, md_addr_t addr) {
 
   prediction_t * match_entry = NULL;
   bool match = false;
-  if(rpt[rpt_idx].tag == pc_tag)
+  if(cp->pf->rpt[rpt_idx].tag == pc_tag)
   {
      match = true;
-     match_entry = &rpt[rpt_idx];
+     match_entry = &cp->pf->rpt[rpt_idx];
   }
 
   //no matching PC tag; assign a new entry
@@ -880,7 +1546,7 @@ void stride_prefetcher(struct cache_t *cp, md_addr_t addr) {
     n_entry.state = INITIAL;
     n_entry.prev_addr = addr;
     n_entry.stride = 0;
-    rpt[rpt_idx] = n_entry;
+    cp->pf->rpt[rpt_idx] = n_entry;
   } else {
     int stride = (int)addr - (int)match_entry->prev_addr;
     switch(match_entry->state) {
@@ -992,6 +1658,7 @@ cache_access(struct cache_t *cp,	/* cache to access */
   /* ECE552 Assignment 4 - BEGIN CODE */
   bool stream_buf_hit = false;
   /* ECE552 Assignment 4 - END CODE */
+  int coh_supplied = FALSE;
 
   /* default replacement address */
   if (repl_addr)
@@ -1007,6 +1674,10 @@ cache_access(struct cache_t *cp,	/* cache to access */
   if ((addr + nbytes) > ((addr & ~cp->blk_mask) + cp->bsize))
     fatal("cache: access error: access spans block, addr 0x%08x", addr);
 
+  /* partitioned caches shadow demand accesses in the utility monitors */
+  if (cp->part && prefetch == 0)
+    cache_part_monitor(cp, set, tag);
+
   /* permissions are checked on cache misses */
 
   /* check for a fast hit: access to same block */
@@ -1045,14 +1716,14 @@ cache_access(struct cache_t *cp,	/* cache to access */
   /* ECE552 Assignment 4 - BEGIN CODE */
   /* check stream buffers */
   cache_blk_t stream_buffer_blk;
-  for(int j=0; j < stream_table.size(); j++)
+  for(int j=0; cp->pf && j < cp->pf->stream_table.size(); j++)
   {
-     if(blk_fifos[j].size() == 0)  
+     if(cp->pf->blk_fifos[j].size() == 0)  
         continue;
 
-     stream_buffer_blk = blk_fifos[j].front();
+     stream_buffer_blk = cp->pf->blk_fifos[j].front();
      if(stream_buffer_blk.tag == tag && (stream_buffer_blk.status & CACHE_BLK_VALID)) {
-        blk_fifos[j].pop();
+        cp->pf->blk_fifos[j].pop();
         stream_buf_hit = true;
         break;
      }
@@ -1062,22 +1733,28 @@ cache_access(struct cache_t *cp,	/* cache to access */
   /* **MISS** */
   if (prefetch == 0 && !stream_buf_hit) {
      cp->misses++;
+     if (cp->part)
+       cp->part->misses[cp->part->req]++;
+     if (cp->pfpc)
+       cache_pfpc_lookup(cp, get_PC())->misses++;
 
      if (cmd == Read) {	
 	cp->read_misses++;
      }
   }
 
-  if ( strcmp(cp->name, "dl1") == 0 && !stream_buf_hit ) {
-    for(std::list<evicted_tag>::iterator it = evicted_blks[set].begin(); it != evicted_blks[set].end(); ++it)
+  if (cp->pf && !stream_buf_hit) {
+    std::list<evicted_tag> &evicted = cp->pf->evicted_blks[set];
+
+    for(std::list<evicted_tag>::iterator it = evicted.begin(); it != evicted.end(); ++it)
     {
        if(it->tag == tag && it->prefetched) {
-         //move element to the front of the list
-         if(it != evicted_blks[set].begin()) {
-           std::list<evicted_tag>::iterator tmp = it; 
-           evicted_blks[set].splice(evicted_blks[set].begin(), evicted_blks[set], tmp, ++it);
-         }
+         //move element to the front of the list, it stays valid
+         if(it != evicted.begin())
+           evicted.splice(evicted.begin(), evicted, it);
          cp->prefetch_misses++;
+         if (cp->pfpc)
+           cache_pfpc_lookup(cp, it->pc)->polluting++;
          break;
        }
     }
@@ -1086,8 +1763,11 @@ cache_access(struct cache_t *cp,	/* cache to access */
 
 
   /* select the appropriate block to replace, and re-link this entry to
-     the appropriate place in the way list */
-  switch (cp->policy) {
+     the appropriate place in the way list, partitioned caches only replace
+     within the ways of the current requestor */
+  if (cp->part)
+    repl = cache_part_victim(cp, set);
+  else switch (cp->policy) {
   case LRU:
   case FIFO:
     repl = cp->sets[set].way_tail;
@@ -1141,12 +1821,12 @@ cache_access(struct cache_t *cp,	/* cache to access */
   /* ECE552 Assignment 4 - BEGIN CODE */
   /* evicted cache_blk */
 
-  if (strcmp(cp->name, "dl1") == 0) {
-    if (evicted_blks[set].size() < cp->assoc) {
-       evicted_blks[set].push_front({false, repl->tag});
+  if (cp->pf) {
+    if (cp->pf->evicted_blks[set].size() < cp->assoc) {
+       cp->pf->evicted_blks[set].push_front({false, repl->tag, 0});
     } else {
-       evicted_blks[set].pop_back();
-       evicted_blks[set].push_front({false, repl->tag});
+       cp->pf->evicted_blks[set].pop_back();
+       cp->pf->evicted_blks[set].push_front({false, repl->tag, 0});
     }
   }
 
@@ -1155,19 +1835,43 @@ cache_access(struct cache_t *cp,	/* cache to access */
   repl->tag = tag;
   repl->status = CACHE_BLK_VALID;	/* dirty bit set on update */
 
+  /* a demand fill is not a prefetched block, whatever the way held before */
+  repl->prefetched = 0;
+  repl->prefetch_used = 0;
+
+  /* coherent caches snoop the bus on a miss, and when a stream buffer
+     block moves into the cache, a write miss (BusRdX) or a read miss no
+     other cache shares gets exclusive ownership */
+  if (cp->coh)
+    {
+      int shared = cache_coh_snoop(cp, cmd == Write ? BusRdX : BusRd,
+				   addr, now+lat, &coh_supplied);
+      if (cmd == Write || !shared)
+	repl->status |= CACHE_BLK_EXCL;
+    }
+
   /* read data block */
   if (stream_buf_hit) {
      /* **HIT on stream buffer** */
      if (prefetch == 0) {
 
         cp->hits++;
+        if (cp->part)
+          cp->part->hits[cp->part->req]++;
         cp->prefetch_useful_cnt++;
         repl->prefetched = 1;
         repl->prefetch_used = 1;
+        repl->pf_pc = stream_buffer_blk.pf_pc;
+        repl->pf_ready = stream_buffer_blk.pf_ready;
+        if (cp->pfpc)
+          cache_pfpc_useful(cp, repl, now);
         if (cmd == Read) {	
               cp->read_hits++;
         }
      }
+  } else if (coh_supplied) {
+     /* block forwarded by the owning cache, no lower-level access */
+     lat += cp->hit_latency;
   } else { //cache miss... get blk from lower-level memory
      lat += cp->blk_access_fn(Read, CACHE_BADDR(cp, addr), cp->bsize, repl, now+lat, prefetch);
   }
@@ -1194,7 +1898,8 @@ cache_access(struct cache_t *cp,	/* cache to access */
   if (cp->hsize)
     link_htab_ent(cp, &cp->sets[set], repl);
 
-  if (prefetch == 0) {	/* only regular cache accesses can generate a prefetch */
+  if (prefetch == 0 && cp->pf) {	/* only regular cache accesses can generate a prefetch */
+	cp->pf->now = now;
   	generate_prefetch(cp, addr);
   }
 
@@ -1208,6 +1913,8 @@ cache_access(struct cache_t *cp,	/* cache to access */
   if (prefetch == 0) {
 
      cp->hits++;
+     if (cp->part)
+       cp->part->hits[cp->part->req]++;
 
      if (cmd == Read) {	
 	   cp->read_hits++;
@@ -1219,6 +1926,8 @@ cache_access(struct cache_t *cp,	/* cache to access */
     if(blk->prefetch_used == 0) {
        blk->prefetch_used = 1;
        cp->prefetch_useful_cnt++;
+       if (cp->pfpc)
+         cache_pfpc_useful(cp, blk, now);
     }
   }
   /* ECE552 Assignment 4 - END CODE */
@@ -1234,6 +1943,14 @@ cache_access(struct cache_t *cp,	/* cache to access */
   if (cmd == Write)
     blk->status |= CACHE_BLK_DIRTY;
 
+  /* a write to a shared block invalidates the other copies (S -> M), a
+     write to an exclusive block upgrades silently (E -> M) */
+  if (cp->coh && cmd == Write && !(blk->status & CACHE_BLK_EXCL))
+    {
+      cache_coh_snoop(cp, BusUpgr, addr, now, NULL);
+      blk->status |= CACHE_BLK_EXCL;
+    }
+
   /* if LRU replacement and this is not the first element of list, reorder */
   if (blk->way_prev && cp->policy == LRU)
     {
@@ -1251,7 +1968,8 @@ cache_access(struct cache_t *cp,	/* cache to access */
   if (udata)
     *udata = blk->user_data;
 
-  if (prefetch == 0) {	/* only regular cache accesses can generate a prefetch */
+  if (prefetch == 0 && cp->pf) {	/* only regular cache accesses can generate a prefetch */
+	cp->pf->now = now;
 	generate_prefetch(cp, addr);
   }
 
@@ -1265,6 +1983,8 @@ cache_access(struct cache_t *cp,	/* cache to access */
   if (prefetch == 0) {
      
      cp->hits++;
+     if (cp->part)
+       cp->part->hits[cp->part->req]++;
 
      if (cmd == Read) {	
         cp->read_hits++;
@@ -1275,6 +1995,8 @@ cache_access(struct cache_t *cp,	/* cache to access */
     if(blk->prefetch_used == 0) {
        blk->prefetch_used = 1;
        cp->prefetch_useful_cnt++;
+       if (cp->pfpc)
+         cache_pfpc_useful(cp, blk, now);
     }
   }
   /* ECE552 Assignment 4 - END CODE */
@@ -1290,6 +2012,14 @@ cache_access(struct cache_t *cp,	/* cache to access */
   if (cmd == Write)
     blk->status |= CACHE_BLK_DIRTY;
 
+  /* a write to a shared block invalidates the other copies (S -> M), a
+     write to an exclusive block upgrades silently (E -> M) */
+  if (cp->coh && cmd == Write && !(blk->status & CACHE_BLK_EXCL))
+    {
+      cache_coh_snoop(cp, BusUpgr, addr, now, NULL);
+      blk->status |= CACHE_BLK_EXCL;
+    }
+
   /* this block hit last, no change in the way list */
 
   /* tag is unchanged, so hash links (if they exist) are still valid */
@@ -1302,7 +2032,8 @@ cache_access(struct cache_t *cp,	/* cache to access */
   cp->last_tagset = CACHE_TAGSET(cp, addr);
   cp->last_blk = blk;
 
-  if (prefetch == 0) {	/* only regular cache accesses can generate a prefetch */
+  if (prefetch == 0 && cp->pf) {	/* only regular cache accesses can generate a prefetch */
+     cp->pf->now = now;
      generate_prefetch(cp, addr);
   }
 
@@ -1452,3 +2183,230 @@ cache_flush_addr(struct cache_t *cp,	/* cache instance to flush */
   /* return latency of the operation */
   return lat;
 }
+
+/* complete the block fills and bus transfers of cache CP that are still in
+   flight at time NOW, e.g., after accesses made without time advancing */
+void
+cache_settle(struct cache_t *cp,	/* cache instance to settle */
+	     tick_t now)		/* time the cache is idle by */
+{
+  int i;
+  struct cache_blk_t *blk;
+
+  for (i=0; i<cp->nsets; i++)
+    {
+      for (blk=cp->sets[i].way_head; blk; blk=blk->way_next)
+	{
+	  blk->ready = MIN(blk->ready, now);
+	  blk->pf_ready = MIN(blk->pf_ready, now);
+	}
+    }
+  cp->bus_free = MIN(cp->bus_free, now);
+}
+
+/* save the state of cache block BLK of CP to checkpoint CK, or restore it,
+   but for its replacement order */
+static void
+cache_chkpt_blk(struct cache_t *cp,	/* cache instance, NULL for a stream
+					   buffer block */
+		struct cache_blk_t *blk,/* block to save or restore */
+		struct chkpt_t *ck)	/* checkpoint */
+{
+  CHKPT_XFER(ck, blk->tag);
+  CHKPT_XFER(ck, blk->status);
+  CHKPT_XFER(ck, blk->ready);
+  CHKPT_XFER(ck, blk->pf_pc);
+  CHKPT_XFER(ck, blk->pf_ready);
+  CHKPT_XFER(ck, blk->prefetched);
+  CHKPT_XFER(ck, blk->prefetch_used);
+  if (cp && cp->usize)
+    chkpt_xfer(ck, blk->user_data, cp->usize);
+  if (cp && cp->balloc)
+    chkpt_xfer(ck, blk->data, cp->bsize);
+}
+
+/* save or restore prefetcher table TABLE to checkpoint CK */
+static void
+cache_chkpt_table(std::vector<prediction_t> &table,	/* table */
+		  struct chkpt_t *ck)			/* checkpoint */
+{
+  chkpt_check(ck, "a prefetcher table size", (long)table.size());
+  if (!table.empty())
+    chkpt_xfer(ck, &table[0], table.size() * sizeof(prediction_t));
+}
+
+/* save the prefetcher state of cache CP to checkpoint CK, or restore it
+   from it */
+static void
+cache_chkpt_pf(struct cache_t *cp,	/* cache instance */
+	       struct chkpt_t *ck)	/* checkpoint */
+{
+  struct cache_pf_t *pf = cp->pf;
+  unsigned int i;
+  int n;
+  struct evicted_tag ev;
+  struct cache_blk_t blk;
+
+  CHKPT_XFER(ck, pf->now);
+  cache_chkpt_table(pf->rpt, ck);
+  cache_chkpt_table(pf->p_table, ck);
+  cache_chkpt_table(pf->stream_table, ck);
+
+  /* recently evicted tags of each set, the most recent first */
+  chkpt_check(ck, "an evicted tag list count", (long)pf->evicted_blks.size());
+  for (i=0; i < pf->evicted_blks.size(); i++)
+    {
+      n = pf->evicted_blks[i].size();
+      CHKPT_XFER(ck, n);
+      if (!ck->restore)
+	{
+	  for (std::list<evicted_tag>::iterator it = pf->evicted_blks[i].begin();
+	       it != pf->evicted_blks[i].end(); ++it)
+	    {
+	      CHKPT_XFER(ck, it->prefetched);
+	      CHKPT_XFER(ck, it->tag);
+	      CHKPT_XFER(ck, it->pc);
+	    }
+	  continue;
+	}
+      pf->evicted_blks[i].clear();
+      for (; n > 0; n--)
+	{
+	  CHKPT_XFER(ck, ev.prefetched);
+	  CHKPT_XFER(ck, ev.tag);
+	  CHKPT_XFER(ck, ev.pc);
+	  pf->evicted_blks[i].push_back(ev);
+	}
+    }
+
+  /* stream buffers, from their heads */
+  chkpt_check(ck, "a stream buffer count", (long)pf->blk_fifos.size());
+  for (i=0; i < pf->blk_fifos.size(); i++)
+    {
+      std::queue<cache_blk_t> fifo;
+
+      if (!ck->restore)
+	fifo = pf->blk_fifos[i];
+      n = fifo.size();
+      CHKPT_XFER(ck, n);
+      for (; n > 0; n--)
+	{
+	  memset(&blk, 0, sizeof(blk));
+	  if (!ck->restore)
+	    {
+	      blk = fifo.front();
+	      fifo.pop();
+	    }
+	  cache_chkpt_blk(NULL, &blk, ck);
+	  if (ck->restore)
+	    fifo.push(blk);
+	}
+      if (ck->restore)
+	pf->blk_fifos[i] = fifo;
+    }
+}
+
+/* save the blocks, replacement order, bus and prefetcher state of cache CP
+   to checkpoint CK, or restore them from it; its stats are not saved */
+void
+cache_chkpt(struct cache_t *cp,		/* cache instance */
+	    struct chkpt_t *ck)		/* checkpoint */
+{
+  int i, j, n, index;
+  struct cache_set_t *set;
+  struct cache_blk_t *blk, **tail;
+  /* bytes between consecutive blocks */
+  long bstride = (char *)CACHE_BINDEX(cp, cp->data, 1) - (char *)cp->data;
+
+  chkpt_name(ck, cp->name);
+  chkpt_check(ck, "a cache set count", cp->nsets);
+  chkpt_check(ck, "a cache block size", cp->bsize);
+  chkpt_check(ck, "a cache associativity", cp->assoc);
+  chkpt_check(ck, "a cache replacement policy", cp->policy);
+  chkpt_check(ck, "cache data blocks", cp->balloc);
+  chkpt_check(ck, "a cache user data size", cp->usize);
+  chkpt_check(ck, "a per-PC prefetch table", cp->pfpc != NULL);
+  if (cp->coh || cp->part)
+    fatal("coherent or partitioned cache `%s' cannot be checkpointed",
+	  cp->name);
+
+  CHKPT_XFER(ck, cp->bus_free);
+  CHKPT_XFER(ck, cp->prefetch_aggr);
+  if (cp->pfpc)
+    chkpt_xfer(ck, cp->pfpc, sizeof(struct cache_pfpc_t));
+  chkpt_check(ck, "a cache prefetcher type", cp->prefetch_type);
+  if (cp->pf)
+    cache_chkpt_pf(cp, ck);
+
+  for (i=0; i < cp->nsets; i++)
+    {
+      set = &cp->sets[i];
+      for (j=0; j < cp->assoc; j++)
+	cache_chkpt_blk(cp, CACHE_BINDEX(cp, set->blks, j), ck);
+
+      /* the way chain, from its head, as block indices in the set */
+      blk = set->way_head;
+      for (j=0; j < cp->assoc; j++)
+	{
+	  if (!ck->restore)
+	    {
+	      index = ((char *)blk - (char *)set->blks) / bstride;
+	      blk = blk->way_next;
+	    }
+	  CHKPT_XFER(ck, index);
+	  if (ck->restore)
+	    {
+	      if (index < 0 || index >= cp->assoc)
+		fatal("checkpoint `%s' has a bogus cache way", ck->fname);
+	      blk = CACHE_BINDEX(cp, set->blks, index);
+	      blk->way_prev = j ? set->way_tail : NULL;
+	      blk->way_next = NULL;
+	      if (j)
+		set->way_tail->way_next = blk;
+	      else
+		set->way_head = blk;
+	      set->way_tail = blk;
+	    }
+	}
+
+      /* the hash table bucket chains of highly-associative caches */
+      for (j=0; j < cp->hsize; j++)
+	{
+	  n = 0;
+	  for (blk=set->hash[j]; blk; blk=blk->hash_next)
+	    n++;
+	  CHKPT_XFER(ck, n);
+	  for (blk=set->hash[j], tail=&set->hash[j]; n > 0; n--)
+	    {
+	      if (!ck->restore)
+		{
+		  index = ((char *)blk - (char *)set->blks) / bstride;
+		  blk = blk->hash_next;
+		}
+	      CHKPT_XFER(ck, index);
+	      if (ck->restore)
+		{
+		  if (index < 0 || index >= cp->assoc)
+		    fatal("checkpoint `%s' has a bogus cache way", ck->fname);
+		  *tail = CACHE_BINDEX(cp, set->blks, index);
+		  tail = &(*tail)->hash_next;
+		}
+	    }
+	  if (ck->restore)
+	    *tail = NULL;
+	}
+    }
+
+  /* the last block to hit, as a block index in the cache */
+  CHKPT_XFER(ck, cp->last_tagset);
+  index = -1;
+  if (cp->last_blk)
+    index = ((char *)cp->last_blk - (char *)cp->data) / bstride;
+  CHKPT_XFER(ck, index);
+  if (ck->restore)
+    {
+      if (index < -1 || index >= cp->nsets * cp->assoc)
+	fatal("checkpoint `%s' has a bogus cache block", ck->fname);
+      cp->last_blk = index >= 0 ? CACHE_BINDEX(cp, cp->data, index) : NULL;
+    }
+}
@@ -59,6 +59,7 @@ extern "C" {
 #include <stdio.h>
 #include "host.h"
 #include "misc.h"
+#include "chkpt.h"
 #include "machine.h"
 #include "memory.h"
 #include "stats.h"
@@ -112,6 +113,11 @@ enum cache_policy {
 /* block status values */
 #define CACHE_BLK_VALID		0x00000001	/* block in valid, in use */
 #define CACHE_BLK_DIRTY		0x00000002	/* dirty block */
+#define CACHE_BLK_EXCL		0x00000004	/* exclusively owned block, only
+						   set in coherent caches */
+
+/* MESI states of a block in a coherent cache, encoded in the block status:
+   M = VALID|EXCL|DIRTY, E = VALID|EXCL, S = VALID, I = !VALID */
 
 /* cache block (or line) definition */
 struct cache_blk_t
@@ -127,6 +133,8 @@ struct cache_blk_t
   unsigned int status;		/* block status, see CACHE_BLK_* defs above */
   tick_t ready;		/* time when block will be accessible, field
 				   is set when a miss fetch is initiated */
+  md_addr_t pf_pc;		/* PC of the access that prefetched the block */
+  tick_t pf_ready;		/* time the prefetch fill completes */
   byte_t *user_data;		/* pointer to user defined data, e.g.,
 				   pre-decode data or physical page address */
   /* DATA should be pointer-aligned due to preceeding field */
@@ -168,6 +176,87 @@ struct prediction_t
 
 /* ECE552 Assignment 4 - END CODE */
 
+/* maximum number of private caches in one coherence domain */
+#define CACHE_COH_MAX_SHARERS	64
+
+/* snooping bus transactions broadcast within a coherence domain */
+enum cache_coh_cmd {
+  BusRd,	/* read miss, other copies drop to S */
+  BusRdX,	/* write miss, other copies are invalidated */
+  BusUpgr	/* write hit to a S block, other copies are invalidated */
+};
+
+/* coherence domain definition, a set of private caches sharing the next
+   level of the hierarchy through a snooping MESI bus */
+struct cache_coh_t
+{
+  char *name;			/* coherence domain name */
+  int nsharers;			/* number of attached caches */
+  struct cache_t *sharers[CACHE_COH_MAX_SHARERS];
+
+  /* per-domain stats */
+  counter_t bus_reads;		/* total number of BusRd transactions */
+  counter_t bus_readxs;		/* total number of BusRdX transactions */
+  counter_t bus_upgrades;	/* total number of BusUpgr transactions */
+  counter_t snoop_hits;		/* total number of snoops that found a copy */
+  counter_t c2c_transfers;	/* total number of cache-to-cache transfers */
+  counter_t invalidations;	/* total number of snoop invalidations */
+};
+
+/* maximum number of requestors sharing a way-partitioned cache */
+#define CACHE_PART_MAX_REQS	CACHE_COH_MAX_SHARERS
+
+/* way partitioning of a shared cache, each requestor allocates blocks only
+   into the ways of its mask, blocks hit in any way; with utility-based cache
+   partitioning (UCP) the masks are recomputed every epoch from per-requestor
+   utility monitors (UMON), shadow tag directories over a sample of the sets
+   that count hits by LRU stack position as if the requestor owned the cache */
+struct cache_part_t
+{
+  int nreqs;			/* number of requestors */
+  int req;			/* requestor of the access in progress */
+  unsigned int way_mask[CACHE_PART_MAX_REQS];/* ways each requestor fills */
+  int ways[CACHE_PART_MAX_REQS];/* number of ways in each mask */
+
+  /* UCP controller, NULL UMON if the masks are static */
+  counter_t epoch;		/* accesses between repartitions */
+  counter_t epoch_accesses;	/* accesses in the current epoch */
+  int umon_shift;		/* UMON samples every (1 << shift)-th set */
+  md_addr_t *umon_tags;		/* shadow tags, [req][sampled set][LRU pos] */
+  int *umon_fill;		/* valid shadow tags, [req][sampled set] */
+  counter_t *umon_hits;		/* hits by LRU position, [req][pos] */
+
+  /* per-requestor stats */
+  counter_t hits[CACHE_PART_MAX_REQS];
+  counter_t misses[CACHE_PART_MAX_REQS];
+  counter_t repartitions;	/* total number of UCP repartitions */
+  struct stat_stat_t *ways_dist[CACHE_PART_MAX_REQS];/* allocation history */
+};
+
+/* number of PCs tracked by the per-PC prefetch table, must be a power of
+   two, PCs beyond this many are accounted to a single overflow entry */
+#define CACHE_PFPC_SIZE		4096
+
+/* prefetch counters of one PC, 32-bit counters keep the table compact */
+struct cache_pfpc_ent_t
+{
+  md_addr_t pc;			/* PC, 0 if the entry is unused */
+  unsigned int misses;		/* demand misses of this PC */
+  unsigned int issued;		/* prefetches this PC triggered */
+  unsigned int useful;		/* prefetched blocks later referenced */
+  unsigned int late;		/* ...referenced before their fill completed */
+  unsigned int polluting;	/* demand misses on blocks its prefetches
+				   evicted */
+};
+
+/* per-PC prefetch table, open addressed by PC */
+struct cache_pfpc_t
+{
+  int nused;			/* number of entries in use */
+  struct cache_pfpc_ent_t overflow;	/* PCs that did not fit the table */
+  struct cache_pfpc_ent_t ents[CACHE_PFPC_SIZE];
+};
+
 /* cache definition */
 struct cache_t
 {
@@ -236,6 +325,18 @@ struct cache_t
   counter_t prefetch_aggr;
 /* ECE552 Assignment 4 - END CODE */
 
+  /* coherence domain this cache snoops, NULL for non-coherent caches */
+  struct cache_coh_t *coh;
+
+  /* way partitioning among requestors, NULL for unpartitioned caches */
+  struct cache_part_t *part;
+
+  /* per-PC prefetch accounting, NULL if not enabled */
+  struct cache_pfpc_t *pfpc;
+
+  /* prefetcher tables, stream buffers and recently evicted tags, NULL if
+     the cache does not prefetch */
+  struct cache_pf_t *pf;
 
   /* last block to hit, used to optimize cache hit processing */
   md_addr_t last_tagset;	/* tag of last line accessed */
@@ -343,6 +444,51 @@ int					/* non-zero if access would hit */
 cache_probe(struct cache_t *cp,		/* cache instance to probe */
 	    md_addr_t addr);		/* address of block to probe */
 
+/* create a coherence domain, private caches are attached to it with
+   cache_coh_attach() */
+struct cache_coh_t *			/* pointer to domain created */
+cache_coh_create(char *name);		/* name of the coherence domain */
+
+/* attach private cache CP to coherence domain COH, all caches in a domain
+   must use the same block size */
+void
+cache_coh_attach(struct cache_coh_t *coh,/* coherence domain */
+		 struct cache_t *cp);	/* private cache to attach */
+
+/* register coherence domain stats */
+void
+cache_coh_reg_stats(struct cache_coh_t *coh,/* coherence domain */
+		    struct stat_sdb_t *sdb);/* stats database */
+
+/* partition the ways of cache CP among NREQS requestors, requestor I
+   allocates only into the ways set in WAY_MASKS[I] */
+void
+cache_part_create(struct cache_t *cp,	/* cache instance to partition */
+		  int nreqs,		/* number of requestors */
+		  unsigned int *way_masks);/* way mask of each requestor */
+
+/* let a utility-based (UCP) controller repartition the ways of cache CP every
+   EPOCH accesses, its utility monitors sample every (1 << UMON_SHIFT)-th set,
+   the cache must already be partitioned with cache_part_create() */
+void
+cache_part_ucp(struct cache_t *cp,	/* partitioned cache instance */
+	       counter_t epoch,		/* accesses between repartitions */
+	       int umon_shift);		/* log2 of UMON set sampling rate */
+
+/* set the requestor of the following accesses to partitioned cache CP */
+#define cache_part_set_req(cp, r)	((cp)->part->req = (r))
+
+/* account prefetches of cache CP per triggering PC */
+void
+cache_pfpc_create(struct cache_t *cp);	/* cache instance */
+
+/* print the per-PC prefetch report of cache CP, the TOPN PCs that triggered
+   the most prefetches first */
+void
+cache_pfpc_print(struct cache_t *cp,	/* cache instance */
+		 int topn,		/* number of PCs to print */
+		 FILE *stream);		/* output stream */
+
 /* flush the entire cache, returns latency of the operation */
 unsigned int				/* latency of the flush operation */
 cache_flush(struct cache_t *cp,		/* cache instance to flush */
@@ -354,6 +500,18 @@ unsigned int				/* latency of flush operation */
 cache_flush_addr(struct cache_t *cp,	/* cache instance to flush */
 		 md_addr_t addr,	/* address of block to flush */
 		 tick_t now);		/* time of cache flush */
+
+/* complete the block fills and bus transfers of cache CP that are still in
+   flight at time NOW, e.g., after accesses made without time advancing */
+void
+cache_settle(struct cache_t *cp,	/* cache instance to settle */
+	     tick_t now);		/* time the cache is idle by */
+
+/* save the blocks, replacement order, bus and prefetcher state of cache CP
+   to checkpoint CK, or restore them from it; its stats are not saved */
+void
+cache_chkpt(struct cache_t *cp,		/* cache instance */
+	    struct chkpt_t *ck);	/* checkpoint */
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,176 @@
+/* chkpt.c - checkpoint stream routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "chkpt.h"
+
+/* open checkpoint file FNAME to restore state from if RESTORE is non-zero,
+   else to save state to, a saved checkpoint replaces FNAME only once it is
+   closed, see gzopen() for compressed file names */
+struct chkpt_t *
+chkpt_open(char *fname, int restore)
+{
+  struct chkpt_t *ck;
+  char *base;
+
+  ck = (struct chkpt_t *)calloc(1, sizeof(struct chkpt_t));
+  if (!ck)
+    fatal("out of virtual memory");
+  ck->fname = mystrdup(fname);
+  ck->restore = restore;
+
+  if (restore)
+    {
+      ck->fd = gzopen(fname, "r");
+      if (!ck->fd)
+	fatal("cannot open checkpoint file `%s'", fname);
+    }
+  else
+    {
+      /* write a hidden file next to FNAME, a checkpoint interrupted half way
+	 does not overwrite the last complete one */
+      ck->tmp_fname = (char *)malloc(strlen(fname)+2);
+      if (!ck->tmp_fname)
+	fatal("out of virtual memory");
+      base = mystrrchr(fname, '/');
+      base = base ? base+1 : fname;
+      sprintf(ck->tmp_fname, "%.*s.%s", (int)(base - fname), fname, base);
+      ck->fd = gzopen(ck->tmp_fname, "w");
+      if (!ck->fd)
+	fatal("cannot create checkpoint file `%s'", ck->tmp_fname);
+    }
+  return ck;
+}
+
+/* close checkpoint CK */
+void
+chkpt_close(struct chkpt_t *ck)
+{
+  if (!ck->restore && fflush(ck->fd) != 0)
+    fatal("cannot write checkpoint file `%s'", ck->tmp_fname);
+  gzclose(ck->fd);
+
+  if (!ck->restore && rename(ck->tmp_fname, ck->fname) != 0)
+    fatal("cannot rename `%s' to `%s'", ck->tmp_fname, ck->fname);
+
+  free(ck->fname);
+  if (ck->tmp_fname)
+    free(ck->tmp_fname);
+  free(ck);
+}
+
+/* save the NBYTES at P to checkpoint CK, or restore them from it */
+void
+chkpt_xfer(struct chkpt_t *ck, void *p, size_t nbytes)
+{
+  if (!nbytes)
+    return;
+
+  if (ck->restore)
+    {
+      if (fread(p, nbytes, 1, ck->fd) != 1)
+	fatal("checkpoint file `%s' is truncated", ck->fname);
+    }
+  else
+    {
+      if (fwrite(p, nbytes, 1, ck->fd) != 1)
+	fatal("cannot write checkpoint file `%s'", ck->tmp_fname);
+    }
+}
+
+/* save VAL to checkpoint CK, or check the saved value is VAL, WHAT names
+   the value in the error message */
+void
+chkpt_check(struct chkpt_t *ck, char *what, long val)
+{
+  long saved = val;
+
+  CHKPT_XFER(ck, saved);
+  if (saved != val)
+    fatal("checkpoint `%s' has %s %ld, this simulation %ld",
+	  ck->fname, what, saved, val);
+}
+
+/* save string S to checkpoint CK, or check the saved string is S, WHAT
+   names the string in the error message */
+void
+chkpt_string(struct chkpt_t *ck, char *what, char *s)
+{
+  char buf[256];
+  long len = strlen(s);
+
+  if (len >= (long)sizeof(buf))
+    panic("checkpoint %s `%s' is too long", what, s);
+
+  CHKPT_XFER(ck, len);
+  if (len < 0 || len >= (long)sizeof(buf))
+    fatal("checkpoint `%s' has %s of bogus length %ld",
+	  ck->fname, what, len);
+  strcpy(buf, s);
+  chkpt_xfer(ck, buf, len);
+  buf[len] = '\0';
+  if (strcmp(buf, s) != 0)
+    fatal("checkpoint `%s' has %s `%s', this simulation `%s'",
+	  ck->fname, what, buf, s);
+}
+
+/* save string S to checkpoint CK, or check the saved string is S */
+void
+chkpt_name(struct chkpt_t *ck, char *s)
+{
+  chkpt_string(ck, "a name", s);
+}
@@ -0,0 +1,94 @@
+/* chkpt.h - checkpoint stream interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+
+#ifndef CHKPT_H
+#define CHKPT_H
+
+#include <stdio.h>
+
+/* a binary checkpoint stream, the same code saves state to it and restores
+   state from it, see chkpt_xfer(); a checkpoint is only read back by the
+   same simulator binary on the same host, it is not portable */
+struct chkpt_t {
+  FILE *fd;			/* checkpoint stream */
+  char *fname;			/* checkpoint file name */
+  char *tmp_fname;		/* file written until it is complete */
+  int restore;			/* non-zero if restoring from the stream */
+};
+
+/* open checkpoint file FNAME to restore state from if RESTORE is non-zero,
+   else to save state to, a saved checkpoint replaces FNAME only once it is
+   closed, see gzopen() for compressed file names */
+struct chkpt_t *
+chkpt_open(char *fname, int restore);
+
+/* close checkpoint CK */
+void chkpt_close(struct chkpt_t *ck);
+
+/* save the NBYTES at P to checkpoint CK, or restore them from it */
+void chkpt_xfer(struct chkpt_t *ck, void *p, size_t nbytes);
+
+/* save or restore variable VAR */
+#define CHKPT_XFER(CK, VAR)	chkpt_xfer((CK), &(VAR), sizeof(VAR))
+
+/* save VAL to checkpoint CK, or check the saved value is VAL, WHAT names
+   the value in the error message */
+void chkpt_check(struct chkpt_t *ck, char *what, long val);
+
+/* save string S to checkpoint CK, or check the saved string is S, WHAT
+   names the string in the error message */
+void chkpt_string(struct chkpt_t *ck, char *what, char *s);
+
+/* save string S to checkpoint CK, or check the saved string is S */
+void chkpt_name(struct chkpt_t *ck, char *s);
+
+#endif /* CHKPT_H */
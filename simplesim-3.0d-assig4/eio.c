@@ -838,3 +838,11 @@ eio_fast_forward(FILE *eio_fd, counter_t icnt)
 
   /* found it! */
 }
+
+/* returns the instruction count of the last EIO transaction processed, an
+   EIO file pointer for eio_fast_forward(), or -1 if there was none */
+counter_t
+eio_trans_last(void)
+{
+  return eio_trans_icnt;
+}
@@ -109,4 +109,8 @@ eio_read_trace(FILE *eio_fd,			/* EIO stream file desc */
 /* fast forward EIO trace EIO_FD to the transaction just after ICNT */
 void eio_fast_forward(FILE *eio_fd, counter_t icnt);
 
+/* returns the instruction count of the last EIO transaction processed, an
+   EIO file pointer for eio_fast_forward(), or -1 if there was none */
+counter_t eio_trans_last(void);
+
 #endif /* EIO_H */
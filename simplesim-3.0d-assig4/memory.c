@@ -262,6 +262,72 @@ mem_init(struct mem_t *mem)	/* memory space to initialize */
   mem->ptab_accesses = 0;
 }
 
+/* save the pages of memory space MEM to checkpoint CK, or restore them from
+   it, the pages allocated since are added; its stats are not saved */
+void
+mem_chkpt(struct mem_t *mem,		/* memory space to save or restore */
+	  struct chkpt_t *ck)		/* checkpoint */
+{
+  int i, n;
+  md_addr_t tag;
+  struct mem_pte_t *pte, *old, **tail, **prev;
+
+  chkpt_check(ck, "a memory page size", MD_PAGE_SIZE);
+  chkpt_check(ck, "a page table size", MEM_PTAB_SIZE);
+
+  for (i=0; i < MEM_PTAB_SIZE; i++)
+    {
+      /* the pages of each bucket in order, the most recently used first */
+      n = 0;
+      for (pte=mem->ptab[i]; pte != NULL; pte=pte->next)
+	n++;
+      CHKPT_XFER(ck, n);
+
+      if (!ck->restore)
+	{
+	  for (pte=mem->ptab[i]; pte != NULL; pte=pte->next)
+	    {
+	      CHKPT_XFER(ck, pte->tag);
+	      chkpt_xfer(ck, pte->page, MD_PAGE_SIZE);
+	    }
+	  continue;
+	}
+
+      /* pages are never freed, a page loaded already is reused */
+      old = mem->ptab[i];
+      for (tail = &mem->ptab[i]; n > 0; n--)
+	{
+	  CHKPT_XFER(ck, tag);
+	  for (prev=&old; *prev != NULL; prev=&(*prev)->next)
+	    {
+	      if ((*prev)->tag == tag)
+		break;
+	    }
+	  if (*prev != NULL)
+	    {
+	      pte = *prev;
+	      *prev = pte->next;
+	    }
+	  else
+	    {
+	      pte = calloc(1, sizeof(struct mem_pte_t));
+	      if (!pte)
+		fatal("out of virtual memory");
+	      pte->tag = tag;
+	      pte->page = getcore(MD_PAGE_SIZE);
+	      if (!pte->page)
+		fatal("out of virtual memory");
+	    }
+	  chkpt_xfer(ck, pte->page, MD_PAGE_SIZE);
+	  *tail = pte;
+	  tail = &pte->next;
+	}
+      *tail = NULL;
+      if (old != NULL)
+	fatal("checkpoint `%s' lacks pages of this simulation", ck->fname);
+    }
+}
+
 /* dump a block of memory, returns any faults encountered */
 enum md_fault_type
 mem_dump(struct mem_t *mem,		/* memory space to display */
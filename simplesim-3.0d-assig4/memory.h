@@ -56,6 +56,7 @@
 
 #include "host.h"
 #include "misc.h"
+#include "chkpt.h"
 #include "machine.h"
 #include "options.h"
 #include "stats.h"
@@ -237,6 +238,12 @@ mem_reg_stats(struct mem_t *mem,	/* memory space to declare */
 void
 mem_init(struct mem_t *mem);	/* memory space to initialize */
 
+/* save the pages of memory space MEM to checkpoint CK, or restore them from
+   it, the pages allocated since are added; its stats are not saved */
+void
+mem_chkpt(struct mem_t *mem,		/* memory space to save or restore */
+	  struct chkpt_t *ck);		/* checkpoint */
+
 /* dump a block of memory, returns any faults encountered */
 enum md_fault_type
 mem_dump(struct mem_t *mem,		/* memory space to display */
@@ -63,6 +63,7 @@
 #include "host.h"
 #include "misc.h"
 #include "machine.h"
+#include "chkpt.h"
 
 /* verbose output flag */
 int verbose = FALSE;
@@ -197,6 +198,14 @@ debug(char *fmt, ...)
 #endif /* DEBUG */
 
 
+#if !defined(hpux) && !defined(__hpux) && !defined(__svr4__) && !defined(_MSC_VER)
+/* states of random(), the size of its default state, so the numbers drawn
+   are the same as with srandom(); the state in use is myrand_state[myrand_cur]
+   and a restored state goes to the other one, see myrand_chkpt() */
+static char myrand_state[2][128];
+static int myrand_cur = 0;
+#endif
+
 /* seed the random number generator */
 void
 mysrand(unsigned int seed)	/* random number generator seed */
@@ -204,7 +213,7 @@ mysrand(unsigned int seed)	/* random number generator seed */
 #if defined(hpux) || defined(__hpux) || defined(__svr4__) || defined(_MSC_VER)
       srand(seed);
 #else
-      srandom(seed);
+      initstate(seed, myrand_state[myrand_cur], sizeof(myrand_state[0]));
 #endif
 }
 
@@ -1187,3 +1196,29 @@ crc(word_t crc_accum, word_t data)
     }
   return crc_accum;
 }
+
+/* save or restore the state of the random number generator */
+void
+myrand_chkpt(struct chkpt_t *ck)
+{
+#if defined(hpux) || defined(__hpux) || defined(__svr4__) || defined(_MSC_VER)
+  /* rand() state is not accessible, the numbers drawn after a restore
+     differ */
+#else
+  if (ck->restore)
+    {
+      /* setstate() first stores the position of the generator in the state
+	 in use, so the restored state cannot be that one */
+      myrand_cur = !myrand_cur;
+      chkpt_xfer(ck, myrand_state[myrand_cur], sizeof(myrand_state[0]));
+      setstate(myrand_state[myrand_cur]);
+    }
+  else
+    {
+      /* setstate() stores the position of the generator in its state, the
+	 state is then complete */
+      setstate(myrand_state[myrand_cur]);
+      chkpt_xfer(ck, myrand_state[myrand_cur], sizeof(myrand_state[0]));
+    }
+#endif
+}
@@ -254,4 +254,8 @@ void gzclose(FILE *fd);
 /* update the CRC on the data block one byte at a time */
 word_t crc(word_t crc_accum, word_t data);
 
+/* save or restore the state of the random number generator, see chkpt.h */
+struct chkpt_t;
+void myrand_chkpt(struct chkpt_t *ck);
+
 #endif /* MISC_H */
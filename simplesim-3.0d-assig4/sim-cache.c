@@ -74,35 +74,91 @@
  * generated (hence the distinction, "functional" simulator).
  */
 
-/* simulated registers */
-static struct regs_t regs;
-
-/* simulated memory */
-static struct mem_t *mem = NULL;
-
 /* track number of insn and refs */
 static counter_t sim_num_refs = 0;
 
 /* maximum number of inst's to execute */
 static unsigned int max_insts;
 
-/* level 1 instruction cache, entry level instruction cache */
-static struct cache_t *cache_il1 = NULL;
-
-/* level 1 instruction cache */
+/* level 2 instruction cache, shared by the cores */
 static struct cache_t *cache_il2 = NULL;
 
-/* level 1 data cache, entry level data cache */
-static struct cache_t *cache_dl1 = NULL;
-
-/* level 2 data cache */
+/* level 2 data cache, shared by the cores */
 static struct cache_t *cache_dl2 = NULL;
 
-/* instruction TLB */
-static struct cache_t *itlb = NULL;
+/* maximum number of simulated cores */
+#define MC_MAX_CORES		CACHE_COH_MAX_SHARERS
 
-/* data TLB */
-static struct cache_t *dtlb = NULL;
+/* program context of one core, each core runs its own program with private
+   registers, memory, L1 caches and TLBs, all cores share the L2 caches */
+struct core_t
+{
+  int id;				/* core number */
+  char *prog;				/* program run */
+  int space;				/* address space of shared pages */
+  struct regs_t regs;			/* architected registers */
+  struct mem_t *mem;			/* program memory */
+  struct cache_t *il1, *dl1;		/* private L1 caches */
+  struct cache_t *itlb, *dtlb;		/* private TLBs */
+  counter_t num_insn;			/* instructions executed */
+  counter_t num_refs;			/* loads and stores executed */
+  int done;				/* reached the instruction limit? */
+
+  /* program loader and EIO trace state */
+  FILE *eio_fd;
+  char *eio_fname;
+  md_addr_t text_base, data_base, brk_point, stack_base, stack_min;
+  unsigned int text_size, data_size, stack_size;
+  md_addr_t prog_entry, environ_base;
+};
+
+/* simulated cores, and the running core */
+static struct core_t cores[MC_MAX_CORES];
+static struct core_t *cur_core = NULL;
+
+/* number of simulated cores */
+static int mc_ncores;
+
+/* instructions each core executes before the next core runs */
+static unsigned int mc_quantum;
+
+/* programs run on cores 1 and up */
+static int mc_nprogs = 0;
+static char *mc_progs[MC_MAX_CORES-1];
+
+/* addresses shared by the cores running the same program */
+static char *mc_share_opt /* = "none" */;
+static enum { mc_share_none, mc_share_text, mc_share_all } mc_share;
+
+/* coherence domain of the private L1 data caches */
+static struct cache_coh_t *mc_coh = NULL;
+
+/* way partitioning of the shared L2 data cache among the cores */
+static char *mc_part_opt /* = "none" */;
+
+/* number of PCs in the per-PC prefetch report of the L1 data cache */
+static int pfpc_topn;
+
+/* main memory latency, only used to time prefetch fills */
+static int mem_lat;
+
+/* sim-cache has no timing model, cache accesses are timed in instructions
+   executed, i.e., one instruction per cycle */
+#define CACHE_NOW		((tick_t)sim_num_insn)
+
+/* physical page map of a multi-core configuration, the programs have private
+   virtual address spaces, so cache accesses use physical addresses assigned
+   on first touch, one page at a time */
+#define MC_PMAP_SIZE		32768
+struct mc_page_t
+{
+  struct mc_page_t *next;		/* next page in bucket chain */
+  int space;				/* owning address space */
+  md_addr_t vpn;			/* virtual page number */
+  md_addr_t ppn;			/* physical page number */
+};
+static struct mc_page_t *mc_pmap[MC_PMAP_SIZE];
+static md_addr_t mc_next_ppn = 1;
 
 /* text-based stat profiles */
 #define MAX_PCSTAT_VARS 8
@@ -111,7 +167,7 @@ static counter_t pcstat_lastvals[MAX_PCSTAT_VARS];
 static struct stat_stat_t *pcstat_sdists[MAX_PCSTAT_VARS];
 
 md_addr_t get_PC() {	// return the current program counter (PC)
-   return regs.regs_PC;
+   return cur_core->regs.regs_PC;
 }
 
 /* wedge all stat values into a counter_t */
@@ -142,7 +198,7 @@ dl1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
   else
     {
       /* access main memory, which is always done in the main simulator loop */
-      return /* access latency, ignored */1;
+      return /* access latency, only times prefetches */mem_lat;
     }
 }
 
@@ -158,7 +214,7 @@ dl2_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 {
   /* this is a miss to the lowest level, so access main memory, which is
      always done in the main simulator loop */
-  return /* access latency, ignored */1;
+  return /* access latency, only times prefetches */mem_lat;
 }
 
 /* l1 inst cache l1 block miss handler function */
@@ -180,7 +236,7 @@ il1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
   else
     {
       /* access main memory, which is always done in the main simulator loop */
-      return /* access latency, ignored */1;
+      return /* access latency, only times prefetches */mem_lat;
     }
 }
 
@@ -195,7 +251,7 @@ il2_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 {
   /* this is a miss to the lowest level, so access main memory, which is
      always done in the main simulator loop */
-  return /* access latency, ignored */1;
+  return /* access latency, only times prefetches */mem_lat;
 }
 
 /* inst cache block miss handler function */
@@ -252,6 +308,53 @@ static int compress_icache_addrs /* = FALSE */;
 static int pcstat_nelt = 0;
 static char *pcstat_vars[MAX_PCSTAT_VARS];
 
+/* translate virtual address ADDR of CORE to the physical address presented
+   to the caches, single-core runs use virtual addresses */
+static md_addr_t
+mc_translate(struct core_t *core,	/* accessing core */
+	     md_addr_t addr)		/* virtual address */
+{
+  md_addr_t vpn = addr >> MD_LOG_PAGE_SIZE;
+  int space, index;
+  struct mc_page_t *page;
+
+  if (mc_ncores == 1)
+    return addr;
+
+  /* shared addresses map to the pages of the first core running the program */
+  if (mc_share == mc_share_all
+      || (mc_share == mc_share_text
+	  && addr >= core->text_base
+	  && addr < core->text_base + core->text_size))
+    space = core->space;
+  else
+    space = core->id;
+
+  index = (vpn ^ (space * 2654435761u)) & (MC_PMAP_SIZE - 1);
+  for (page=mc_pmap[index]; page; page=page->next)
+    {
+      if (page->vpn == vpn && page->space == space)
+	break;
+    }
+
+  if (!page)
+    {
+      /* first touch, allocate the next physical page */
+      if (mc_next_ppn == (((md_addr_t)-1) >> MD_LOG_PAGE_SIZE))
+	fatal("out of simulated physical pages");
+      page = (struct mc_page_t *)calloc(1, sizeof(struct mc_page_t));
+      if (!page)
+	fatal("out of virtual memory");
+      page->space = space;
+      page->vpn = vpn;
+      page->ppn = mc_next_ppn++;
+      page->next = mc_pmap[index];
+      mc_pmap[index] = page;
+    }
+
+  return (page->ppn << MD_LOG_PAGE_SIZE) | (addr & (MD_PAGE_SIZE - 1));
+}
+
 /* convert 64-bit inst text addresses to 32-bit inst equivalents */
 #ifdef TARGET_PISA
 #define IACOMPRESS(A)							\
@@ -335,144 +438,298 @@ sim_reg_options(struct opt_odb_t *odb)	/* options database */
 	       &compress_icache_addrs, /* default */FALSE,
 	       /* print */TRUE, NULL);
 
+  opt_reg_int(odb, "-cache:pfpc",
+	      "PCs in the per-PC L1 data cache prefetch report, 0 disables",
+	      &pfpc_topn, /* default */0, /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-mem:lat",
+	      "memory access latency, only times prefetch fills (<insts>)",
+	      &mem_lat, /* default */18, /* print */TRUE, /* format */NULL);
+  opt_reg_note(odb,
+"  With `-cache:pfpc' N > 0, the prefetches of the L1 data cache are\n"
+"  accounted per PC of the load (or store) that triggered them: demand\n"
+"  misses, prefetches issued, useful prefetches, late prefetches (first\n"
+"  referenced before the fill completed), and polluting prefetches (their\n"
+"  victim was missed on later).  The N PCs that issued the most prefetches\n"
+"  are reported after the statistics.  sim-cache times accesses in\n"
+"  instructions executed, a fill takes the L2 hit latency or `-mem:lat'.\n"
+	       );
+
   opt_reg_string_list(odb, "-pcstat",
 		      "profile stat(s) against text addr's (mult uses ok)",
 		      pcstat_vars, MAX_PCSTAT_VARS, &pcstat_nelt, NULL,
 		      /* !print */FALSE, /* format */NULL, /* accrue */TRUE);
 
+  opt_reg_int(odb, "-mc:cores", "number of cores (program contexts)",
+	      &mc_ncores, /* default */1, /* print */TRUE, /* format */NULL);
+  opt_reg_uint(odb, "-mc:quantum",
+	       "instructions a core executes before the next core runs",
+	       &mc_quantum, /* default */1000, /* print */TRUE, /* format */NULL);
+  opt_reg_string_list(odb, "-mc:prog",
+		      "program run on core 1, 2, ... (mult uses ok)",
+		      mc_progs, MC_MAX_CORES-1, &mc_nprogs, NULL,
+		      /* print */TRUE, /* format */NULL, /* accrue */TRUE);
+  opt_reg_note(odb,
+"  With `-mc:cores' N > 1, each core runs its own program context with\n"
+"  private L1 caches and TLBs, named `c<core>.<name>', and all cores share\n"
+"  the L2 caches.  The L1 data caches are kept coherent with a snooping MESI\n"
+"  protocol.  Cores advance in lockstep, `-mc:quantum' instructions at a\n"
+"  time.  Core 0 runs the simulated program, core i runs the i-th `-mc:prog'\n"
+"  program (an EIO file or a binary without arguments), or a copy of the\n"
+"  simulated program if none is given.  `-max:inst' limits each core, the\n"
+"  simulation ends when the first program exits.\n"
+	       );
+
+  opt_reg_string(odb, "-mc:share",
+		 "addresses shared by the cores running the same program, "
+		 "i.e., {none|text|all}",
+		 &mc_share_opt, "none", /* print */TRUE, NULL);
+  opt_reg_note(odb,
+"  Cores running the same program can share its physical pages with\n"
+"  `-mc:share', as the threads of one process would: `text' shares the\n"
+"  program text, `all' every page.  Only the cache accesses are shared, each\n"
+"  core still executes on its own copy of the program memory, so `all'\n"
+"  exercises the MESI protocol of the L1 data caches with the reference\n"
+"  stream of the program.\n"
+	       );
+
+  opt_reg_string(odb, "-mc:part",
+		 "l2 data cache way partitioning among cores, "
+		 "i.e., {none|static:<mask>[:<mask>...]|ucp:<epoch>[:<shift>]}",
+		 &mc_part_opt, "none", /* print */TRUE, NULL);
+  opt_reg_note(odb,
+"  The shared L2 data cache can be way-partitioned among the cores with\n"
+"  `-mc:part'.  A static partition gives every core a hexadecimal way mask,\n"
+"  e.g., `static:0x3:0xc' for two cores on a 4-way cache; a core hits in\n"
+"  any way but only replaces blocks within its own mask.  Utility-based\n"
+"  cache partitioning (UCP), e.g., `ucp:100000:5', shadows every 32nd set\n"
+"  (shift 5, default 5) per core in a utility monitor and reassigns the\n"
+"  ways every 100000 L2 accesses to maximize the total number of hits.\n"
+	       );
 }
 
-/* check simulator-specific option values */
-void
-sim_check_options(struct opt_odb_t *odb,	/* options database */
-		  int argc, char **argv)	/* command line arguments */
+/* partition the shared L2 data cache among the cores according to
+   configuration string OPT */
+static void
+mc_part_config(char *opt)		/* partitioning configuration */
 {
-  char name[128], c;
-  int nsets, bsize, assoc;
-  int prefetch_type;			/* this specifies the type of the prefetcher */
+  unsigned int masks[MC_MAX_CORES];
+  char *p, *end;
+  int i, umon_shift;
+  long epoch;
 
-  /* use a level 1 D-cache? */
-  if (!mystricmp(cache_dl1_opt, "none"))
-    {
-      cache_dl1 = NULL;
+  if (!mystricmp(opt, "none"))
+    return;
+  if (!cache_dl2)
+    fatal("cannot partition the L2 data cache, `-cache:dl2' is `none'");
 
-      /* the level 2 D-cache cannot be defined */
-      if (strcmp(cache_dl2_opt, "none"))
-	fatal("the l1 data cache must defined if the l2 cache is defined");
-      cache_dl2 = NULL;
-    }
-  else /* dl1 is defined */
+  if (!strncmp(opt, "static:", 7))
     {
-      if (sscanf(cache_dl1_opt, "%[^:]:%d:%d:%d:%c:%d", 
-		 name, &nsets, &bsize, &assoc, &c, &prefetch_type) != 6)
-	fatal("bad l1 D-cache parms: <name>:<nsets>:<bsize>:<assoc>:<repl>:<pref>");
-      cache_dl1 = cache_create(name, nsets, bsize, /* balloc */FALSE,
-			       /* usize */0, assoc, cache_char2policy(c),
-			       dl1_access_fn, /* hit latency */1, prefetch_type);
-
-      /* is the level 2 D-cache defined? */
-      if (!mystricmp(cache_dl2_opt, "none"))
-	cache_dl2 = NULL;
-      else
+      for (i=0, p=opt+7; *p; i++)
 	{
-	  if (sscanf(cache_dl2_opt, "%[^:]:%d:%d:%d:%c:%d",
-		     name, &nsets, &bsize, &assoc, &c, &prefetch_type) != 6)
-	    fatal("bad l2 D-cache parms: "
-		  "<name>:<nsets>:<bsize>:<assoc>:<repl>:<pref>");
-	  cache_dl2 = cache_create(name, nsets, bsize, /* balloc */FALSE,
-				   /* usize */0, assoc, cache_char2policy(c), 
-				   dl2_access_fn, /* hit latency */1, prefetch_type);
+	  if (i == mc_ncores)
+	    fatal("more way masks than cores in `-mc:part %s'", opt);
+	  masks[i] = (unsigned int)strtoul(p, &end, 16);
+	  if (end == p || (*end && *end != ':'))
+	    fatal("bad way mask in `-mc:part %s'", opt);
+	  p = *end ? end + 1 : end;
 	}
+      if (i != mc_ncores)
+	fatal("need one way mask per core in `-mc:part %s'", opt);
+      cache_part_create(cache_dl2, mc_ncores, masks);
     }
-
-  /* use a level 1 I-cache? */
-  if (!mystricmp(cache_il1_opt, "none"))
-    {
-      cache_il1 = NULL;
-
-      /* the level 2 I-cache cannot be defined */
-      if (strcmp(cache_il2_opt, "none"))
-	fatal("the l1 inst cache must defined if the l2 cache is defined");
-      cache_il2 = NULL;
-    }
-  else if (!mystricmp(cache_il1_opt, "dl1"))
-    {
-      if (!cache_dl1)
-	fatal("I-cache l1 cannot access D-cache l1 as it's undefined");
-      cache_il1 = cache_dl1;
-
-      /* the level 2 I-cache cannot be defined */
-      if (strcmp(cache_il2_opt, "none"))
-	fatal("the l1 inst cache must defined if the l2 cache is defined");
-      cache_il2 = NULL;
-    }
-  else if (!mystricmp(cache_il1_opt, "dl2"))
+  else if (!strncmp(opt, "ucp:", 4))
     {
-      if (!cache_dl2)
-	fatal("I-cache l1 cannot access D-cache l2 as it's undefined");
-      cache_il1 = cache_dl2;
-
-      /* the level 2 I-cache cannot be defined */
-      if (strcmp(cache_il2_opt, "none"))
-	fatal("the l1 inst cache must defined if the l2 cache is defined");
-      cache_il2 = NULL;
+      umon_shift = 5;
+      epoch = strtol(opt+4, &end, 10);
+      if (end == opt+4
+	  || (*end == ':' && sscanf(end+1, "%d", &umon_shift) != 1)
+	  || (*end && *end != ':'))
+	fatal("bad UCP parameters in `-mc:part %s'", opt);
+      if (umon_shift < 0)
+	fatal("UCP set sampling shift must be non-negative");
+      if (mc_ncores > cache_dl2->assoc)
+	fatal("UCP needs at least one L2 way per core");
+
+      /* start from an equal split of the ways, any remainder to core 0 */
+      for (i=0; i < mc_ncores; i++)
+	masks[i] = 0;
+      for (i=0; i < cache_dl2->assoc; i++)
+	masks[(i * mc_ncores) / cache_dl2->assoc] |= (1u << i);
+      cache_part_create(cache_dl2, mc_ncores, masks);
+      cache_part_ucp(cache_dl2, (counter_t)epoch, umon_shift);
     }
-  else /* il1 is defined */
+  else
+    fatal("unknown L2 partitioning `%s', use none, static:..., or ucp:...",
+	  opt);
+}
+
+/* create a cache from configuration string OPT, private caches of a
+   multi-core configuration are named after their CORE, shared caches are
+   created with CORE -1 */
+static struct cache_t *
+mc_cache_create(char *opt,		/* cache configuration string */
+		char *parms,		/* parameter error message */
+		int core,		/* owning core, -1 if shared */
+		int usize,		/* user data size */
+		unsigned int		/* block access function */
+		(*blk_access_fn)(enum mem_cmd cmd, md_addr_t baddr,
+				 int bsize, struct cache_blk_t *blk,
+				 tick_t now, int prefetch))
+{
+  char name[128], cname[160], c;
+  int nsets, bsize, assoc;
+  int prefetch_type;			/* this specifies the type of the prefetcher */
+
+  if (sscanf(opt, "%[^:]:%d:%d:%d:%c:%d",
+	     name, &nsets, &bsize, &assoc, &c, &prefetch_type) != 6)
+    fatal("%s", parms);
+
+  if (core >= 0 && mc_ncores > 1)
+    sprintf(cname, "c%d.%s", core, name);
+  else
+    strcpy(cname, name);
+
+  return cache_create(cname, nsets, bsize, /* balloc */FALSE,
+		      usize, assoc, cache_char2policy(c),
+		      blk_access_fn, /* hit latency */1, prefetch_type);
+}
+
+/* check simulator-specific option values */
+void
+sim_check_options(struct opt_odb_t *odb,	/* options database */
+		  int argc, char **argv)	/* command line arguments */
+{
+  int i;
+  struct core_t *core;
+
+  if (mc_ncores < 1 || mc_ncores > MC_MAX_CORES)
+    fatal("number of cores `%d' must be between 1 and %d",
+	  mc_ncores, MC_MAX_CORES);
+  if (mc_quantum < 1)
+    fatal("core quantum must be at least one instruction");
+  if (mc_nprogs > mc_ncores - 1)
+    fatal("`-mc:prog' given %d programs for %d additional cores",
+	  mc_nprogs, mc_ncores - 1);
+
+  if (!mystricmp(mc_share_opt, "none"))
+    mc_share = mc_share_none;
+  else if (!mystricmp(mc_share_opt, "text"))
+    mc_share = mc_share_text;
+  else if (!mystricmp(mc_share_opt, "all"))
+    mc_share = mc_share_all;
+  else
+    fatal("unknown shared address mode `%s'", mc_share_opt);
+
+  /* the level 2 caches cannot be defined without the level 1 caches */
+  if (!mystricmp(cache_dl1_opt, "none") && strcmp(cache_dl2_opt, "none"))
+    fatal("the l1 data cache must defined if the l2 cache is defined");
+  if ((!mystricmp(cache_il1_opt, "none")
+       || !mystricmp(cache_il1_opt, "dl1")
+       || !mystricmp(cache_il1_opt, "dl2"))
+      && strcmp(cache_il2_opt, "none"))
+    fatal("the l1 inst cache must defined if the l2 cache is defined");
+
+  /* private levels are created per core, shared levels with core 0 */
+  for (i=0; i < mc_ncores; i++)
     {
-      if (sscanf(cache_il1_opt, "%[^:]:%d:%d:%d:%c:%d",
-		 name, &nsets, &bsize, &assoc, &c,&prefetch_type) != 6)
-	fatal("bad l1 I-cache parms: <name>:<nsets>:<bsize>:<assoc>:<repl>:<pref>");
-      cache_il1 = cache_create(name, nsets, bsize, /* balloc */FALSE,
-			       /* usize */0, assoc, cache_char2policy(c), 
-			       il1_access_fn, /* hit latency */1, prefetch_type);
-
-      /* is the level 2 D-cache defined? */
-      if (!mystricmp(cache_il2_opt, "none"))
-	cache_il2 = NULL;
-      else if (!mystricmp(cache_il2_opt, "dl2"))
+      core = &cores[i];
+      core->id = i;
+
+      /* use a level 1 D-cache? */
+      if (!mystricmp(cache_dl1_opt, "none"))
+	core->dl1 = NULL;
+      else /* dl1 is defined */
+	{
+	  core->dl1 =
+	    mc_cache_create(cache_dl1_opt, "bad l1 D-cache parms: "
+			    "<name>:<nsets>:<bsize>:<assoc>:<repl>:<pref>",
+			    i, /* usize */0, dl1_access_fn);
+
+	  /* is the level 2 D-cache defined? */
+	  if (i == 0 && mystricmp(cache_dl2_opt, "none"))
+	    cache_dl2 =
+	      mc_cache_create(cache_dl2_opt, "bad l2 D-cache parms: "
+			      "<name>:<nsets>:<bsize>:<assoc>:<repl>:<pref>",
+			      -1, /* usize */0, dl2_access_fn);
+	}
+
+      /* use a level 1 I-cache? */
+      if (!mystricmp(cache_il1_opt, "none"))
+	core->il1 = NULL;
+      else if (!mystricmp(cache_il1_opt, "dl1"))
+	{
+	  if (!core->dl1)
+	    fatal("I-cache l1 cannot access D-cache l1 as it's undefined");
+	  core->il1 = core->dl1;
+	}
+      else if (!mystricmp(cache_il1_opt, "dl2"))
 	{
 	  if (!cache_dl2)
-	    fatal("I-cache l2 cannot access D-cache l2 as it's undefined");
-	  cache_il2 = cache_dl2;
+	    fatal("I-cache l1 cannot access D-cache l2 as it's undefined");
+	  core->il1 = cache_dl2;
 	}
-      else
+      else /* il1 is defined */
 	{
-	  if (sscanf(cache_il2_opt, "%[^:]:%d:%d:%d:%c:%d",
-		     name, &nsets, &bsize, &assoc, &c, &prefetch_type) != 6)
-	    fatal("bad l2 I-cache parms: "
-		  "<name>:<nsets>:<bsize>:<assoc>:<repl>:<pref>");
-	  cache_il2 = cache_create(name, nsets, bsize, /* balloc */FALSE,
-				   /* usize */0, assoc, cache_char2policy(c), 
-				   il2_access_fn, /* hit latency */1, prefetch_type);
+	  core->il1 =
+	    mc_cache_create(cache_il1_opt, "bad l1 I-cache parms: "
+			    "<name>:<nsets>:<bsize>:<assoc>:<repl>:<pref>",
+			    i, /* usize */0, il1_access_fn);
+
+	  /* is the level 2 I-cache defined? */
+	  if (i > 0 || !mystricmp(cache_il2_opt, "none"))
+	    ;
+	  else if (!mystricmp(cache_il2_opt, "dl2"))
+	    {
+	      if (!cache_dl2)
+		fatal("I-cache l2 cannot access D-cache l2 as it's undefined");
+	      cache_il2 = cache_dl2;
+	    }
+	  else
+	    cache_il2 =
+	      mc_cache_create(cache_il2_opt, "bad l2 I-cache parms: "
+			      "<name>:<nsets>:<bsize>:<assoc>:<repl>:<pref>",
+			      -1, /* usize */0, il2_access_fn);
 	}
+
+      /* use an I-TLB? */
+      if (!mystricmp(itlb_opt, "none"))
+	core->itlb = NULL;
+      else
+	core->itlb =
+	  mc_cache_create(itlb_opt, "bad TLB parms: "
+			  "<name>:<nsets>:<page_size>:<assoc>:<repl>:<pref>",
+			  i, /* usize */sizeof(md_addr_t), itlb_access_fn);
+
+      /* use a D-TLB? */
+      if (!mystricmp(dtlb_opt, "none"))
+	core->dtlb = NULL;
+      else
+	core->dtlb =
+	  mc_cache_create(dtlb_opt, "bad TLB parms: "
+			  "<name>:<nsets>:<page_size>:<assoc>:<repl>:<pref>",
+			  i, /* usize */sizeof(md_addr_t), dtlb_access_fn);
     }
 
-  /* use an I-TLB? */
-  if (!mystricmp(itlb_opt, "none"))
-    itlb = NULL;
-  else
+  /* keep the private L1 data caches coherent */
+  if (mc_ncores > 1 && cores[0].dl1)
     {
-      if (sscanf(itlb_opt, "%[^:]:%d:%d:%d:%c:%d",
-		 name, &nsets, &bsize, &assoc, &c, &prefetch_type) != 6)
-	fatal("bad TLB parms: <name>:<nsets>:<page_size>:<assoc>:<repl>:<pref>");
-      itlb = cache_create(name, nsets, bsize, /* balloc */FALSE,
-			  /* usize */sizeof(md_addr_t), assoc,
-			  cache_char2policy(c), itlb_access_fn,
-			  /* hit latency */1, prefetch_type);
+      mc_coh = cache_coh_create("coh");
+      for (i=0; i < mc_ncores; i++)
+	cache_coh_attach(mc_coh, cores[i].dl1);
     }
 
-  /* use a D-TLB? */
-  if (!mystricmp(dtlb_opt, "none"))
-    dtlb = NULL;
-  else
+  /* partition the shared L2 data cache among the cores */
+  mc_part_config(mc_part_opt);
+
+  if (pfpc_topn < 0)
+    fatal("number of PCs in the prefetch report must be non-negative");
+  if (pfpc_topn > 0)
     {
-      if (sscanf(dtlb_opt, "%[^:]:%d:%d:%d:%c:%d",
-		 name, &nsets, &bsize, &assoc, &c, &prefetch_type) != 6)
-	fatal("bad TLB parms: <name>:<nsets>:<page_size>:<assoc>:<repl>:<pref>");
-      dtlb = cache_create(name, nsets, bsize, /* balloc */FALSE,
-			  /* usize */sizeof(md_addr_t), assoc,
-			  cache_char2policy(c),  dtlb_access_fn,
-			  /* hit latency */1, prefetch_type);
+      for (i=0; i < mc_ncores; i++)
+	{
+	  if (cores[i].dl1)
+	    cache_pfpc_create(cores[i].dl1);
+	}
     }
 }
 
@@ -480,14 +737,75 @@ sim_check_options(struct opt_odb_t *odb,	/* options database */
 void
 sim_init(void)
 {
+  int i;
+  char name[128];
+
   sim_num_refs = 0;
 
-  /* allocate and initialize register file */
-  regs_init(&regs);
+  for (i=0; i < mc_ncores; i++)
+    {
+      /* allocate and initialize register file */
+      regs_init(&cores[i].regs);
 
-  /* allocate and initialize memory space */
-  mem = mem_create("mem");
-  mem_init(mem);
+      /* allocate and initialize memory space */
+      if (mc_ncores > 1)
+	sprintf(name, "c%d.mem", i);
+      else
+	strcpy(name, "mem");
+      cores[i].mem = mem_create(name);
+      mem_init(cores[i].mem);
+    }
+}
+
+/* save the loader and EIO state of the program last loaded or run into
+   CORE */
+static void
+core_save_ld(struct core_t *core)
+{
+  core->eio_fd = sim_eio_fd;
+  core->eio_fname = sim_eio_fname;
+  core->text_base = ld_text_base;
+  core->text_size = ld_text_size;
+  core->data_base = ld_data_base;
+  core->data_size = ld_data_size;
+  core->brk_point = ld_brk_point;
+  core->stack_base = ld_stack_base;
+  core->stack_size = ld_stack_size;
+  core->stack_min = ld_stack_min;
+  core->prog_entry = ld_prog_entry;
+  core->environ_base = ld_environ_base;
+}
+
+/* make CORE the running core, the simulator accesses the core through its
+   context, only the state the loader, the system calls and the EIO traces
+   keep in globals is saved and switched */
+static void
+core_switch(struct core_t *core)
+{
+  if (core == cur_core)
+    return;
+
+  if (cur_core)
+    core_save_ld(cur_core);
+
+  sim_num_insn = core->num_insn;
+  if (cache_dl2 && cache_dl2->part)
+    cache_part_set_req(cache_dl2, core->id);
+
+  sim_eio_fd = core->eio_fd;
+  sim_eio_fname = core->eio_fname;
+  ld_text_base = core->text_base;
+  ld_text_size = core->text_size;
+  ld_data_base = core->data_base;
+  ld_data_size = core->data_size;
+  ld_brk_point = core->brk_point;
+  ld_stack_base = core->stack_base;
+  ld_stack_size = core->stack_size;
+  ld_stack_min = core->stack_min;
+  ld_prog_entry = core->prog_entry;
+  ld_environ_base = core->environ_base;
+
+  cur_core = core;
 }
 
 /* local machine state accessor */
@@ -510,8 +828,43 @@ sim_load_prog(char *fname,		/* program to load */
 	      int argc, char **argv,	/* program arguments */
 	      char **envp)		/* program environment */
 {
-  /* load program text and data, set up environment, memory, and regs */
-  ld_load_prog(fname, argc, argv, envp, &regs, mem, TRUE);
+  int i, j;
+  char *chkpt_fname = sim_chkpt_fname;
+
+  /* load each core's program, core 0 runs the simulated program */
+  for (i=0; i < mc_ncores; i++)
+    {
+      sim_eio_fd = NULL;
+      sim_eio_fname = NULL;
+      ld_stack_min = (md_addr_t)-1;
+
+      /* load program text and data, set up environment, memory, and regs */
+      if (i > 0 && i <= mc_nprogs)
+	{
+	  cores[i].prog = mc_progs[i-1];
+	  ld_load_prog(mc_progs[i-1], 1, &mc_progs[i-1], envp,
+		       &cores[i].regs, cores[i].mem, TRUE);
+	}
+      else
+	{
+	  cores[i].prog = fname;
+	  ld_load_prog(fname, argc, argv, envp,
+		       &cores[i].regs, cores[i].mem, TRUE);
+	}
+      core_save_ld(&cores[i]);
+
+      /* cores running the same program share the address space of the first */
+      for (j=0; strcmp(cores[j].prog, cores[i].prog); j++)
+	;
+      cores[i].space = j;
+
+      /* checkpoints only restore the simulated program */
+      sim_chkpt_fname = NULL;
+    }
+  sim_chkpt_fname = chkpt_fname;
+
+  /* core 0 runs first */
+  core_switch(&cores[0]);
 
   /* initialize the DLite debugger */
   dlite_init(md_reg_obj, dlite_mem_obj, cache_mstate_obj);
@@ -531,9 +884,28 @@ sim_reg_stats(struct stat_sdb_t *sdb)	/* stats database */
   int i;
 
   /* register baseline stats */
-  stat_reg_counter(sdb, "sim_num_insn",
-		   "total number of instructions executed",
-		   &sim_num_insn, sim_num_insn, NULL);
+  if (mc_ncores == 1)
+    stat_reg_counter(sdb, "sim_num_insn",
+		     "total number of instructions executed",
+		     &sim_num_insn, sim_num_insn, NULL);
+  else
+    {
+      char buf[512], *formula;
+
+      /* the running core's count lives in SIM_NUM_INSN, so sum the cores */
+      formula = (char *)calloc(mc_ncores, 32);
+      if (!formula)
+	fatal("out of virtual memory");
+      for (i=0; i < mc_ncores; i++)
+	{
+	  sprintf(buf, "%sc%d.sim_num_insn", i ? " + " : "", i);
+	  strcat(formula, buf);
+	}
+      stat_reg_formula(sdb, "sim_num_insn",
+		       "total number of instructions executed",
+		       formula, "%12.0f");
+      free(formula);
+    }
   stat_reg_counter(sdb, "sim_num_refs",
 		   "total number of loads and stores executed",
 		   &sim_num_refs, 0, NULL);
@@ -544,21 +916,52 @@ sim_reg_stats(struct stat_sdb_t *sdb)	/* stats database */
 		   "simulation speed (in insts/sec)",
 		   "sim_num_insn / sim_elapsed_time", NULL);
 
+  /* register per-core stats */
+  if (mc_ncores > 1)
+    {
+      for (i=0; i < mc_ncores; i++)
+	{
+	  char buf[512];
+
+	  sprintf(buf, "c%d.sim_num_insn", i);
+	  stat_reg_counter(sdb, buf, "number of instructions executed by core",
+			   &cores[i].num_insn, 0, NULL);
+	  sprintf(buf, "c%d.sim_num_refs", i);
+	  stat_reg_counter(sdb, buf,
+			   "number of loads and stores executed by core",
+			   &cores[i].num_refs, 0, NULL);
+	}
+    }
+
   /* register cache stats */
-  if (cache_il1
-      && (cache_il1 != cache_dl1 && cache_il1 != cache_dl2))
-    cache_reg_stats(cache_il1, sdb);
+  for (i=0; i < mc_ncores; i++)
+    {
+      if (cores[i].il1
+	  && (cores[i].il1 != cores[i].dl1 && cores[i].il1 != cache_dl2))
+	cache_reg_stats(cores[i].il1, sdb);
+    }
   if (cache_il2
-      && (cache_il2 != cache_dl1 && cache_il2 != cache_dl2))
+      && (cache_il2 != cores[0].dl1 && cache_il2 != cache_dl2))
     cache_reg_stats(cache_il2, sdb);
-  if (cache_dl1)
-    cache_reg_stats(cache_dl1, sdb);
+  for (i=0; i < mc_ncores; i++)
+    {
+      if (cores[i].dl1)
+	cache_reg_stats(cores[i].dl1, sdb);
+    }
   if (cache_dl2)
     cache_reg_stats(cache_dl2, sdb);
-  if (itlb)
-    cache_reg_stats(itlb, sdb);
-  if (dtlb)
-    cache_reg_stats(dtlb, sdb);
+  for (i=0; i < mc_ncores; i++)
+    {
+      if (cores[i].itlb)
+	cache_reg_stats(cores[i].itlb, sdb);
+    }
+  for (i=0; i < mc_ncores; i++)
+    {
+      if (cores[i].dtlb)
+	cache_reg_stats(cores[i].dtlb, sdb);
+    }
+  if (mc_coh)
+    cache_coh_reg_stats(mc_coh, sdb);
 
   for (i=0; i<pcstat_nelt; i++)
     {
@@ -591,14 +994,22 @@ sim_reg_stats(struct stat_sdb_t *sdb)	/* stats database */
 					/* print fn */NULL);
     }
   ld_reg_stats(sdb);
-  mem_reg_stats(mem, sdb);
+  for (i=0; i < mc_ncores; i++)
+    mem_reg_stats(cores[i].mem, sdb);
 }
 
 /* dump simulator-specific auxiliary simulator statistics */
 void
 sim_aux_stats(FILE *stream)		/* output stream */
 {
-  /* nada */
+  int i;
+
+  /* per-PC prefetch reports */
+  for (i=0; pfpc_topn > 0 && i < mc_ncores; i++)
+    {
+      if (cores[i].dl1)
+	cache_pfpc_print(cores[i].dl1, pfpc_topn, stream);
+    }
 }
 
 /* un-initialize the simulator */
@@ -617,46 +1028,46 @@ sim_uninit(void)
  */
 
 /* next program counter */
-#define SET_NPC(EXPR)		(regs.regs_NPC = (EXPR))
+#define SET_NPC(EXPR)		(core->regs.regs_NPC = (EXPR))
 
 /* current program counter */
-#define CPC			(regs.regs_PC)
+#define CPC			(core->regs.regs_PC)
 
 /* general purpose registers */
-#define GPR(N)			(regs.regs_R[N])
-#define SET_GPR(N,EXPR)		(regs.regs_R[N] = (EXPR))
+#define GPR(N)			(core->regs.regs_R[N])
+#define SET_GPR(N,EXPR)		(core->regs.regs_R[N] = (EXPR))
 
 #if defined(TARGET_PISA)
 
 /* floating point registers, L->word, F->single-prec, D->double-prec */
-#define FPR_L(N)		(regs.regs_F.l[(N)])
-#define SET_FPR_L(N,EXPR)	(regs.regs_F.l[(N)] = (EXPR))
-#define FPR_F(N)		(regs.regs_F.f[(N)])
-#define SET_FPR_F(N,EXPR)	(regs.regs_F.f[(N)] = (EXPR))
-#define FPR_D(N)		(regs.regs_F.d[(N) >> 1])
-#define SET_FPR_D(N,EXPR)	(regs.regs_F.d[(N) >> 1] = (EXPR))
+#define FPR_L(N)		(core->regs.regs_F.l[(N)])
+#define SET_FPR_L(N,EXPR)	(core->regs.regs_F.l[(N)] = (EXPR))
+#define FPR_F(N)		(core->regs.regs_F.f[(N)])
+#define SET_FPR_F(N,EXPR)	(core->regs.regs_F.f[(N)] = (EXPR))
+#define FPR_D(N)		(core->regs.regs_F.d[(N) >> 1])
+#define SET_FPR_D(N,EXPR)	(core->regs.regs_F.d[(N) >> 1] = (EXPR))
 
 /* miscellaneous register accessors */
-#define SET_HI(EXPR)		(regs.regs_C.hi = (EXPR))
-#define HI			(regs.regs_C.hi)
-#define SET_LO(EXPR)		(regs.regs_C.lo = (EXPR))
-#define LO			(regs.regs_C.lo)
-#define FCC			(regs.regs_C.fcc)
-#define SET_FCC(EXPR)		(regs.regs_C.fcc = (EXPR))
+#define SET_HI(EXPR)		(core->regs.regs_C.hi = (EXPR))
+#define HI			(core->regs.regs_C.hi)
+#define SET_LO(EXPR)		(core->regs.regs_C.lo = (EXPR))
+#define LO			(core->regs.regs_C.lo)
+#define FCC			(core->regs.regs_C.fcc)
+#define SET_FCC(EXPR)		(core->regs.regs_C.fcc = (EXPR))
 
 #elif defined(TARGET_ALPHA)
 
 /* floating point registers, L->word, F->single-prec, D->double-prec */
-#define FPR_Q(N)		(regs.regs_F.q[N])
-#define SET_FPR_Q(N,EXPR)	(regs.regs_F.q[N] = (EXPR))
-#define FPR(N)			(regs.regs_F.d[N])
-#define SET_FPR(N,EXPR)		(regs.regs_F.d[N] = (EXPR))
+#define FPR_Q(N)		(core->regs.regs_F.q[N])
+#define SET_FPR_Q(N,EXPR)	(core->regs.regs_F.q[N] = (EXPR))
+#define FPR(N)			(core->regs.regs_F.d[N])
+#define SET_FPR(N,EXPR)		(core->regs.regs_F.d[N] = (EXPR))
 
 /* miscellaneous register accessors */
-#define FPCR			(regs.regs_C.fpcr)
-#define SET_FPCR(EXPR)		(regs.regs_C.fpcr = (EXPR))
-#define UNIQ			(regs.regs_C.uniq)
-#define SET_UNIQ(EXPR)		(regs.regs_C.uniq = (EXPR))
+#define FPCR			(core->regs.regs_C.fpcr)
+#define SET_FPCR(EXPR)		(core->regs.regs_C.fpcr = (EXPR))
+#define UNIQ			(core->regs.regs_C.uniq)
+#define SET_UNIQ(EXPR)		(core->regs.regs_C.uniq = (EXPR))
 
 #else
 #error No ISA target defined...
@@ -664,53 +1075,53 @@ sim_uninit(void)
 
 /* precise architected memory state accessor macros */
 #define __READ_CACHE(addr, SRC_T)					\
-  ((dtlb								\
-    ? cache_access(dtlb, Read, (addr), NULL,				\
+  ((core->dtlb							\
+    ? cache_access(core->dtlb, Read, (addr), NULL,			\
 		   sizeof(SRC_T), 0, NULL, NULL, 0)			\
     : 0),								\
-   (cache_dl1								\
-    ? cache_access(cache_dl1, Read, (addr), NULL,			\
-		   sizeof(SRC_T), 0, NULL, NULL, 0)			\
+   (core->dl1							\
+    ? cache_access(core->dl1, Read, mc_translate(core, addr), NULL,	\
+		   sizeof(SRC_T), CACHE_NOW, NULL, NULL, 0)		\
     : 0))
 
 #define READ_BYTE(SRC, FAULT)						\
   ((FAULT) = md_fault_none, addr = (SRC),				\
-   __READ_CACHE(addr, byte_t), MEM_READ_BYTE(mem, addr))
+   __READ_CACHE(addr, byte_t), MEM_READ_BYTE(core->mem, addr))
 #define READ_HALF(SRC, FAULT)						\
   ((FAULT) = md_fault_none, addr = (SRC),				\
-   __READ_CACHE(addr, half_t), MEM_READ_HALF(mem, addr))
+   __READ_CACHE(addr, half_t), MEM_READ_HALF(core->mem, addr))
 #define READ_WORD(SRC, FAULT)						\
   ((FAULT) = md_fault_none, addr = (SRC),				\
-   __READ_CACHE(addr, word_t), MEM_READ_WORD(mem, addr))
+   __READ_CACHE(addr, word_t), MEM_READ_WORD(core->mem, addr))
 #ifdef HOST_HAS_QWORD
 #define READ_QWORD(SRC, FAULT)						\
   ((FAULT) = md_fault_none, addr = (SRC),				\
-   __READ_CACHE(addr, qword_t), MEM_READ_QWORD(mem, addr))
+   __READ_CACHE(addr, qword_t), MEM_READ_QWORD(core->mem, addr))
 #endif /* HOST_HAS_QWORD */
 
 #define __WRITE_CACHE(addr, DST_T)					\
-  ((dtlb								\
-    ? cache_access(dtlb, Write, (addr), NULL,				\
+  ((core->dtlb							\
+    ? cache_access(core->dtlb, Write, (addr), NULL,			\
 		   sizeof(DST_T), 0, NULL, NULL, 0)			\
     : 0),								\
-   (cache_dl1								\
-    ? cache_access(cache_dl1, Write, (addr), NULL,			\
-		   sizeof(DST_T), 0,  NULL, NULL, 0)			\
+   (core->dl1							\
+    ? cache_access(core->dl1, Write, mc_translate(core, addr), NULL,	\
+		   sizeof(DST_T), CACHE_NOW, NULL, NULL, 0)		\
     : 0))
 
 #define WRITE_BYTE(SRC, DST, FAULT)					\
   ((FAULT) = md_fault_none, addr = (DST),				\
-   __WRITE_CACHE(addr, byte_t), MEM_WRITE_BYTE(mem, addr, (SRC)))
+   __WRITE_CACHE(addr, byte_t), MEM_WRITE_BYTE(core->mem, addr, (SRC)))
 #define WRITE_HALF(SRC, DST, FAULT)					\
   ((FAULT) = md_fault_none, addr = (DST),				\
-   __WRITE_CACHE(addr, half_t), MEM_WRITE_HALF(mem, addr, (SRC)))
+   __WRITE_CACHE(addr, half_t), MEM_WRITE_HALF(core->mem, addr, (SRC)))
 #define WRITE_WORD(SRC, DST, FAULT)					\
   ((FAULT) = md_fault_none, addr = (DST),				\
-   __WRITE_CACHE(addr, word_t), MEM_WRITE_WORD(mem, addr, (SRC)))
+   __WRITE_CACHE(addr, word_t), MEM_WRITE_WORD(core->mem, addr, (SRC)))
 #ifdef HOST_HAS_QWORD
 #define WRITE_QWORD(SRC, DST, FAULT)					\
   ((FAULT) = md_fault_none, addr = (DST),				\
-   __WRITE_CACHE(addr, qword_t), MEM_WRITE_QWORD(mem, addr, (SRC)))
+   __WRITE_CACHE(addr, qword_t), MEM_WRITE_QWORD(core->mem, addr, (SRC)))
 #endif /* HOST_HAS_QWORD */
 
 /* system call memory access function */
@@ -721,25 +1132,28 @@ dcache_access_fn(struct mem_t *mem,	/* memory space to access */
 		 void *p,		/* data input/output buffer */
 		 int nbytes)		/* number of bytes to access */
 {
-  if (dtlb)
-    cache_access(dtlb, cmd, addr, NULL, nbytes, 0, NULL, NULL, 0);
-  if (cache_dl1)
-    cache_access(cache_dl1, cmd, addr, NULL, nbytes, 0, NULL, NULL, 0);
+  struct core_t *core = cur_core;
+
+  if (core->dtlb)
+    cache_access(core->dtlb, cmd, addr, NULL, nbytes, 0, NULL, NULL, 0);
+  if (core->dl1)
+    cache_access(core->dl1, cmd, mc_translate(core, addr), NULL, nbytes,
+		 CACHE_NOW, NULL, NULL, 0);
   return mem_access(mem, cmd, addr, p, nbytes);
 }
 
 /* system call handler macro */
 #define SYSCALL(INST)							\
   (flush_on_syscalls							\
-   ? ((dtlb ? cache_flush(dtlb, 0) : 0),				\
-      (cache_dl1 ? cache_flush(cache_dl1, 0) : 0),			\
+   ? ((core->dtlb ? cache_flush(core->dtlb, 0) : 0),			\
+      (core->dl1 ? cache_flush(core->dl1, 0) : 0),			\
       (cache_dl2 ? cache_flush(cache_dl2, 0) : 0),			\
-      sys_syscall(&regs, mem_access, mem, INST, TRUE))			\
-   : sys_syscall(&regs, dcache_access_fn, mem, INST, TRUE))
+      sys_syscall(&core->regs, mem_access, core->mem, INST, TRUE))	\
+   : sys_syscall(&core->regs, dcache_access_fn, core->mem, INST, TRUE))
 
-/* start simulation, program loaded, processor precise state initialized */
-void
-sim_main(void)
+/* execute one instruction of the running core */
+static void
+sim_step(struct core_t *core)		/* running core */
 {
   int i;
   md_inst_t inst;
@@ -747,103 +1161,135 @@ sim_main(void)
   enum md_opcode op;
   register int is_write;
   enum md_fault_type fault;
- 
-  fprintf(stderr, "sim: ** starting functional simulation w/ caches **\n");
 
-  /* set up initial default next PC */
-  regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
-
-  /* check for DLite debugger entry condition */
-  if (dlite_check_break(regs.regs_PC, /* no access */0, /* addr */0, 0, 0))
-    dlite_main(regs.regs_PC - sizeof(md_inst_t), regs.regs_PC,
-	       sim_num_insn, &regs, mem);
-
-  while (TRUE)
-    {
-      /* maintain $r0 semantics */
-      regs.regs_R[MD_REG_ZERO] = 0;
+  /* maintain $r0 semantics */
+  core->regs.regs_R[MD_REG_ZERO] = 0;
 #ifdef TARGET_ALPHA
-      regs.regs_F.d[MD_REG_ZERO] = 0.0;
+  core->regs.regs_F.d[MD_REG_ZERO] = 0.0;
 #endif /* TARGET_ALPHA */
 
-      /* get the next instruction to execute */
-      if (itlb)
-	cache_access(itlb, Read, IACOMPRESS(regs.regs_PC),
-		     NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL, 0);
-      if (cache_il1)
-	cache_access(cache_il1, Read, IACOMPRESS(regs.regs_PC),
-		     NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL, 0);
-      MD_FETCH_INST(inst, mem, regs.regs_PC);
+  /* get the next instruction to execute */
+  if (core->itlb)
+    cache_access(core->itlb, Read, IACOMPRESS(core->regs.regs_PC),
+		 NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL, 0);
+  if (core->il1)
+    cache_access(core->il1, Read,
+		 mc_translate(core, IACOMPRESS(core->regs.regs_PC)),
+		 NULL, ISCOMPRESS(sizeof(md_inst_t)), CACHE_NOW, NULL, NULL, 0);
+  MD_FETCH_INST(inst, core->mem, core->regs.regs_PC);
 
-      /* keep an instruction count */
-      sim_num_insn++;
+  /* keep an instruction count */
+  sim_num_insn++;
+  core->num_insn++;
 
-      /* set default reference address and access mode */
-      addr = 0; is_write = FALSE;
+  /* set default reference address and access mode */
+  addr = 0; is_write = FALSE;
 
-      /* set default fault - none */
-      fault = md_fault_none;
+  /* set default fault - none */
+  fault = md_fault_none;
 
-      /* decode the instruction */
-      MD_SET_OPCODE(op, inst);
+  /* decode the instruction */
+  MD_SET_OPCODE(op, inst);
 
-      /* execute the instruction */
-      switch (op)
-	{
+  /* execute the instruction */
+  switch (op)
+    {
 #define DEFINST(OP,MSK,NAME,OPFORM,RES,FLAGS,O1,O2,I1,I2,I3)		\
-	case OP:							\
-          SYMCAT(OP,_IMPL);						\
-          break;
+    case OP:								\
+      SYMCAT(OP,_IMPL);							\
+      break;
 #define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
-        case OP:							\
-          panic("attempted to execute a linking opcode");
+    case OP:								\
+      panic("attempted to execute a linking opcode");
 #define CONNECT(OP)
 #define DECLARE_FAULT(FAULT)						\
-	  { fault = (FAULT); break; }
+      { fault = (FAULT); break; }
 #include "machine.def"
-	default:
-          panic("attempted to execute a bogus opcode");
-	}
+    default:
+      panic("attempted to execute a bogus opcode");
+    }
 
-      if (fault != md_fault_none)
-	fatal("fault (%d) detected @ 0x%08p", fault, regs.regs_PC);
+  if (fault != md_fault_none)
+    fatal("fault (%d) detected @ 0x%08p", fault, core->regs.regs_PC);
 
-      if (MD_OP_FLAGS(op) & F_MEM)
+  if (MD_OP_FLAGS(op) & F_MEM)
+    {
+      sim_num_refs++;
+      core->num_refs++;
+      if (MD_OP_FLAGS(op) & F_STORE)
+	is_write = TRUE;
+    }
+
+  /* update any stats tracked by PC */
+  for (i=0; i < pcstat_nelt; i++)
+    {
+      counter_t newval;
+      int delta;
+
+      /* check if any tracked stats changed */
+      newval = STATVAL(pcstat_stats[i]);
+      delta = newval - pcstat_lastvals[i];
+      if (delta != 0)
 	{
-	  sim_num_refs++;
-	  if (MD_OP_FLAGS(op) & F_STORE)
-	    is_write = TRUE;
+	  stat_add_samples(pcstat_sdists[i], core->regs.regs_PC, delta);
+	  pcstat_lastvals[i] = newval;
 	}
 
-      /* update any stats tracked by PC */
-      for (i=0; i < pcstat_nelt; i++)
-	{
-	  counter_t newval;
-	  int delta;
+    }
 
-	  /* check if any tracked stats changed */
-	  newval = STATVAL(pcstat_stats[i]);
-	  delta = newval - pcstat_lastvals[i];
-	  if (delta != 0)
-	    {
-	      stat_add_samples(pcstat_sdists[i], regs.regs_PC, delta);
-	      pcstat_lastvals[i] = newval;
-	    }
+  /* check for DLite debugger entry condition */
+  if (dlite_check_break(core->regs.regs_NPC,
+			is_write ? ACCESS_WRITE : ACCESS_READ,
+			addr, sim_num_insn, sim_num_insn))
+    dlite_main(core->regs.regs_PC, core->regs.regs_NPC, sim_num_insn,
+	       &core->regs, core->mem);
+
+  /* go to the next instruction */
+  core->regs.regs_PC = core->regs.regs_NPC;
+  core->regs.regs_NPC += sizeof(md_inst_t);
+
+  /* finish early? */
+  if (max_insts && sim_num_insn >= max_insts)
+    core->done = TRUE;
+}
 
-	}
+/* start simulation, program loaded, processor precise state initialized */
+void
+sim_main(void)
+{
+  int i, n, active;
+  struct core_t *core;
+
+  fprintf(stderr, "sim: ** starting functional simulation w/ caches **\n");
+
+  /* set up initial default next PC */
+  for (i=0; i < mc_ncores; i++)
+    cores[i].regs.regs_NPC = cores[i].regs.regs_PC + sizeof(md_inst_t);
 
-      /* check for DLite debugger entry condition */
-      if (dlite_check_break(regs.regs_NPC,
-			    is_write ? ACCESS_WRITE : ACCESS_READ,
-			    addr, sim_num_insn, sim_num_insn))
-	dlite_main(regs.regs_PC, regs.regs_NPC, sim_num_insn, &regs, mem);
+  /* check for DLite debugger entry condition */
+  core = &cores[0];
+  if (dlite_check_break(core->regs.regs_PC, /* no access */0, /* addr */0,
+			0, 0))
+    dlite_main(core->regs.regs_PC - sizeof(md_inst_t), core->regs.regs_PC,
+	       sim_num_insn, &core->regs, core->mem);
+
+  /* run the cores in lockstep, one quantum at a time */
+  do
+    {
+      active = FALSE;
+      for (i=0; i < mc_ncores; i++)
+	{
+	  core = &cores[i];
+	  if (core->done)
+	    continue;
 
-      /* go to the next instruction */
-      regs.regs_PC = regs.regs_NPC;
-      regs.regs_NPC += sizeof(md_inst_t);
+	  core_switch(core);
+	  for (n=0; n < mc_quantum && !core->done; n++)
+	    sim_step(core);
 
-      /* finish early? */
-      if (max_insts && sim_num_insn >= max_insts)
-	return;
+	  if (!core->done)
+	    active = TRUE;
+	}
     }
+  while (active);
 }
@@ -51,18 +51,24 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <math.h>
 #include <assert.h>
 #include <signal.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "host.h"
 #include "misc.h"
+#include "chkpt.h"
 #include "machine.h"
 #include "regs.h"
 #include "memory.h"
 #include "cache.h"
 #include "loader.h"
 #include "syscall.h"
+#include "eio.h"
 #include "bpred.h"
 #include "resource.h"
 #include "bitmap.h"
@@ -86,6 +92,11 @@ static struct regs_t regs;
 /* simulated memory */
 static struct mem_t *mem = NULL;
 
+/* the cache prefetchers tag their prefetches with the current PC */
+md_addr_t get_PC() {
+  return regs.regs_PC;
+}
+
 
 /*
  * simulator options
@@ -97,6 +108,9 @@ static unsigned int max_insts;
 /* number of insts skipped before timing starts */
 static int fastfwd_count;
 
+/* warm the caches, TLBs and branch predictor while fast forwarding */
+static int fastfwd_warm;
+
 /* pipeline trace range and output filename */
 static int ptrace_nelt = 0;
 static char *ptrace_opts[2];
@@ -157,6 +171,16 @@ static int RUU_size = 8;
 /* load/store queue (LSQ) size */
 static int LSQ_size = 4;
 
+/* speculate loads past stores with unknown addresses, using a store set
+   memory dependence predictor */
+static int ss_enabled;
+
+/* store set predictor SSIT and LFST sizes, and cycles between clearings of
+   the SSIT (0 for never) */
+static int ss_ssit_size;
+static int ss_lfst_size;
+static int ss_clear_interval;
+
 /* l1 data cache config, i.e., {<config>|none} */
 static char *cache_dl1_opt;
 
@@ -238,6 +262,44 @@ static char *pcstat_vars[MAX_PCSTAT_VARS];
 /* operate in backward-compatible bugs mode (for testing only) */
 static int bugcompat_mode;
 
+/* skip the cycles the pipeline is idle in */
+static int idle_skip;
+
+/* execute the program on a functional thread ahead of the timing model */
+static int func_thread;
+
+/* instruction records buffered between the functional and timing threads,
+   a power of two */
+static int func_ring_size;
+
+/* wrong path with a functional thread, {exec|fetch} */
+static char *func_wrongpath_opt;
+
+/* sampled simulation, insts per sample period, 0 simulates all insts in
+   detail */
+static int sample_period;
+
+/* detailed insts of a sample before its measured window */
+static int sample_warmup;
+
+/* insts of the measured window of a sample */
+static int sample_size;
+
+/* relative error of the sampled CPI that stops simulation, 0 runs to the
+   end */
+static double sample_error;
+
+/* standard normal quantile of the sampled CPI confidence */
+static double sample_z;
+
+/* file a checkpoint of the timing state is saved to when simulation stops,
+   and every chkpt_period cycles if non-zero */
+static char *chkpt_save_fname;
+static int chkpt_period;
+
+/* checkpoint of the timing state simulation resumes from */
+static char *chkpt_restore_fname;
+
 /*
  * functional unit resource configuration
  */
@@ -330,6 +392,9 @@ static counter_t sim_total_branches = 0;
 /* cycle counter */
 static tick_t sim_cycle = 0;
 
+/* cycles skipped while the pipeline was idle */
+static counter_t sim_idle_cycles = 0;
+
 /* occupancy counters */
 static counter_t IFQ_count;		/* cumulative IFQ occupancy */
 static counter_t IFQ_fcount;		/* cumulative IFQ full count */
@@ -341,6 +406,25 @@ static counter_t LSQ_fcount;		/* cumulative LSQ full count */
 /* total non-speculative bogus addresses seen (debug var) */
 static counter_t sim_invalid_addrs;
 
+/* insts executed by the timing thread, with a functional thread */
+static counter_t func_sync_insn;
+
+/* sampled simulation stats */
+static counter_t sample_num;		/* measured windows */
+static counter_t sample_func_insn;	/* insts executed functionally */
+static double sample_cpi_sum;		/* sum of the window CPIs */
+static double sample_cpi_sum2;		/* sum of their squares */
+static double sample_cpi;		/* mean window CPI */
+static double sample_cpi_stddev;	/* standard deviation of the CPIs */
+static double sample_cpi_error;		/* relative confidence half-width */
+
+/* memory dependence speculation counters */
+static counter_t lsq_spec_loads;	/* loads issued past unknown stores */
+static counter_t lsq_violations;	/* memory order violations */
+static counter_t lsq_violation_squash;	/* insts squashed by violations */
+static counter_t lsq_false_deps;	/* loads that waited for a predicted
+					   store to another address */
+
 /*
  * simulator state variables
  */
@@ -430,7 +514,8 @@ dl1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      md_addr_t baddr,		/* block address to access */
 	      int bsize,		/* size of block to access */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
-	      tick_t now)		/* time of access */
+	      tick_t now,		/* time of access */
+	      int prefetch)		/* if 1 the access is a prefetch */
 {
   unsigned int lat;
 
@@ -438,7 +523,8 @@ dl1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
     {
       /* access next level of data cache hierarchy */
       lat = cache_access(cache_dl2, cmd, baddr, NULL, bsize,
-			 /* now */now, /* pudata */NULL, /* repl addr */NULL);
+			 /* now */now, /* pudata */NULL, /* repl addr */NULL,
+			 prefetch);
       if (cmd == Read)
 	return lat;
       else
@@ -466,7 +552,8 @@ dl2_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      md_addr_t baddr,		/* block address to access */
 	      int bsize,		/* size of block to access */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
-	      tick_t now)		/* time of access */
+	      tick_t now,		/* time of access */
+	      int prefetch)		/* if 1 the access is a prefetch */
 {
   /* this is a miss to the lowest level, so access main memory */
   if (cmd == Read)
@@ -484,7 +571,8 @@ il1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      md_addr_t baddr,		/* block address to access */
 	      int bsize,		/* size of block to access */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
-	      tick_t now)		/* time of access */
+	      tick_t now,		/* time of access */
+	      int prefetch)		/* if 1 the access is a prefetch */
 {
   unsigned int lat;
 
@@ -492,7 +580,8 @@ if (cache_il2)
     {
       /* access next level of inst cache hierarchy */
       lat = cache_access(cache_il2, cmd, baddr, NULL, bsize,
-			 /* now */now, /* pudata */NULL, /* repl addr */NULL);
+			 /* now */now, /* pudata */NULL, /* repl addr */NULL,
+			 prefetch);
       if (cmd == Read)
 	return lat;
       else
@@ -514,7 +603,8 @@ il2_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      md_addr_t baddr,		/* block address to access */
 	      int bsize,		/* size of block to access */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
-	      tick_t now)		/* time of access */
+	      tick_t now,		/* time of access */
+	      int prefetch)		/* if 1 the access is a prefetch */
 {
   /* this is a miss to the lowest level, so access main memory */
   if (cmd == Read)
@@ -534,7 +624,8 @@ itlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
 	       md_addr_t baddr,		/* block address to access */
 	       int bsize,		/* size of block to access */
 	       struct cache_blk_t *blk,	/* ptr to block in upper level */
-	       tick_t now)		/* time of access */
+	       tick_t now,		/* time of access */
+	       int prefetch)		/* if 1 the access is a prefetch */
 {
   md_addr_t *phy_page_ptr = (md_addr_t *)blk->user_data;
 
@@ -554,7 +645,8 @@ dtlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
 	       md_addr_t baddr,	/* block address to access */
 	       int bsize,		/* size of block to access */
 	       struct cache_blk_t *blk,	/* ptr to block in upper level */
-	       tick_t now)		/* time of access */
+	       tick_t now,		/* time of access */
+	       int prefetch)		/* if 1 the access is a prefetch */
 {
   md_addr_t *phy_page_ptr = (md_addr_t *)blk->user_data;
 
@@ -591,6 +683,9 @@ sim_reg_options(struct opt_odb_t *odb)
   opt_reg_int(odb, "-fastfwd", "number of insts skipped before timing starts",
 	      &fastfwd_count, /* default */0,
 	      /* print */TRUE, /* format */NULL);
+  opt_reg_flag(odb, "-fastfwd:warm",
+	       "warm the caches, TLBs and bpred while fast forwarding",
+	       &fastfwd_warm, /* default */FALSE, /* print */TRUE, NULL);
   opt_reg_string_list(odb, "-ptrace",
 	      "generate pipetrace, i.e., <fname|stdout|stderr> <range>",
 	      ptrace_opts, /* arr_sz */2, &ptrace_nelt, /* default */NULL,
@@ -733,6 +828,27 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &LSQ_size, /* default */8,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_flag(odb, "-lsq:storeset",
+	       "issue loads past unknown store addresses, predicting their "
+	       "dependences with store sets",
+	       &ss_enabled, /* default */FALSE,
+	       /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-lsq:ssit",
+	      "store set id table (SSIT) size",
+	      &ss_ssit_size, /* default */1024,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-lsq:lfst",
+	      "last fetched store table (LFST) size, i.e., store sets",
+	      &ss_lfst_size, /* default */128,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-lsq:ssclear",
+	      "cycles between clearings of the SSIT (0 for never)",
+	      &ss_clear_interval, /* default */1000000,
+	      /* print */TRUE, /* format */NULL);
+
   /* cache options */
 
   opt_reg_string(odb, "-cache:dl1",
@@ -872,6 +988,67 @@ sim_reg_options(struct opt_odb_t *odb)
   opt_reg_flag(odb, "-bugcompat",
 	       "operate in backward-compatible bugs mode (for testing only)",
 	       &bugcompat_mode, /* default */FALSE, /* print */TRUE, NULL);
+
+  opt_reg_flag(odb, "-idleskip",
+	       "skip the cycles the pipeline is idle in (same results)",
+	       &idle_skip, /* default */TRUE, /* print */TRUE, NULL);
+
+  opt_reg_flag(odb, "-func:thread",
+	       "execute the program on a thread ahead of the timing model",
+	       &func_thread, /* default */FALSE, /* print */TRUE, NULL);
+
+  opt_reg_int(odb, "-func:ring",
+	      "inst records buffered between the functional and timing threads",
+	      &func_ring_size, /* default */4096,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-func:wrongpath",
+		 "wrong path with -func:thread, {exec|fetch}",
+		 &func_wrongpath_opt, /* default */"exec",
+		 /* print */TRUE, NULL);
+
+  opt_reg_int(odb, "-sample:period",
+	      "insts per sample period (0 = no sampling)",
+	      &sample_period, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-sample:warmup",
+	      "detailed insts of a sample before its measured window",
+	      &sample_warmup, /* default */2000,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-sample:size",
+	      "insts of the measured window of a sample",
+	      &sample_size, /* default */1000,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_double(odb, "-sample:error",
+		 "stop once the sampled CPI is within this relative error "
+		 "(0 = run to the end)",
+		 &sample_error, /* default */0.0,
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_double(odb, "-sample:z",
+		 "standard normal quantile of the sampled CPI confidence",
+		 &sample_z, /* default */3.0,
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-chkpt:save",
+		 "save a checkpoint of the timing state to this file when "
+		 "simulation stops (-max:inst or SIGUSR2)",
+		 &chkpt_save_fname, /* default */NULL,
+		 /* print */TRUE, NULL);
+
+  opt_reg_int(odb, "-chkpt:period",
+	      "also save the checkpoint every this many cycles (0 = never)",
+	      &chkpt_period, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-chkpt:restore",
+		 "resume simulation from the checkpoint of the timing state "
+		 "in this file",
+		 &chkpt_restore_fname, /* default */NULL,
+		 /* print */TRUE, NULL);
 }
 
 /* check simulator-specific option values */
@@ -999,6 +1176,62 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
   if (LSQ_size < 2 || (LSQ_size & (LSQ_size-1)) != 0)
     fatal("LSQ size must be a positive number > 1 and a power of two");
 
+  if (ss_ssit_size < 1 || (ss_ssit_size & (ss_ssit_size-1)) != 0)
+    fatal("SSIT size must be positive non-zero and a power of two");
+
+  if (ss_lfst_size < 1 || (ss_lfst_size & (ss_lfst_size-1)) != 0)
+    fatal("LFST size must be positive non-zero and a power of two");
+
+  if (ss_clear_interval < 0)
+    fatal("SSIT clearing interval must be non-negative");
+
+  if (func_thread)
+    {
+      if (func_ring_size < 2 || (func_ring_size & (func_ring_size-1)) != 0)
+	fatal("functional thread ring size must be > 1 and a power of two");
+
+      /* the timing model does not keep the architected state the debugger
+	 and the verbose trace look at */
+      if (dlite_active || verbose)
+	fatal("-func:thread cannot be used with -i or -v");
+
+      /* with exec, wrong path insts execute on the registers recorded at
+	 the mis-predicted branch; with fetch, they are not dispatched */
+      if (!mystricmp(func_wrongpath_opt, "fetch"))
+	ruu_include_spec = FALSE;
+      else if (mystricmp(func_wrongpath_opt, "exec"))
+	fatal("bad functional thread wrong path policy, use {exec|fetch}");
+    }
+
+  if (sample_period)
+    {
+      if (sample_warmup < 0 || sample_size < 1
+	  || sample_period <= sample_warmup + sample_size)
+	fatal("sample period must exceed its detailed warm-up and window");
+      if (sample_error < 0.0 || sample_z <= 0.0)
+	fatal("bad sampled CPI error or confidence");
+
+      /* functional warming executes on the architected state */
+      if (func_thread)
+	fatal("-sample:period cannot be used with -func:thread");
+    }
+
+  if (chkpt_period < 0)
+    fatal("bad checkpoint period: %d", chkpt_period);
+  if (chkpt_period && !chkpt_save_fname)
+    fatal("-chkpt:period needs a -chkpt:save file");
+  if (chkpt_save_fname || chkpt_restore_fname)
+    {
+      /* a checkpoint is taken between two cycles of the main loop, the
+	 functional thread and the sample phases have state of their own */
+      if (func_thread || sample_period)
+	fatal("-chkpt:save/restore cannot be used with -func:thread or "
+	      "-sample:period");
+    }
+  if (chkpt_restore_fname && (fastfwd_count || sim_chkpt_fname))
+    fatal("-chkpt:restore cannot be used with -fastfwd or -chkpt, "
+	  "the checkpoint is past them");
+
   /* use a level 1 D-cache? */
   if (!mystricmp(cache_dl1_opt, "none"))
     {
@@ -1016,7 +1249,8 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 	fatal("bad l1 D-cache parms: <name>:<nsets>:<bsize>:<assoc>:<repl>");
       cache_dl1 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 			       /* usize */0, assoc, cache_char2policy(c),
-			       dl1_access_fn, /* hit lat */cache_dl1_lat);
+			       dl1_access_fn, /* hit lat */cache_dl1_lat,
+			       /* no prefetcher */0);
 
       /* is the level 2 D-cache defined? */
       if (!mystricmp(cache_dl2_opt, "none"))
@@ -1029,7 +1263,8 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 		  "<name>:<nsets>:<bsize>:<assoc>:<repl>");
 	  cache_dl2 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 				   /* usize */0, assoc, cache_char2policy(c),
-				   dl2_access_fn, /* hit lat */cache_dl2_lat);
+				   dl2_access_fn, /* hit lat */cache_dl2_lat,
+				   /* no prefetcher */0);
 	}
     }
 
@@ -1072,7 +1307,8 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 	fatal("bad l1 I-cache parms: <name>:<nsets>:<bsize>:<assoc>:<repl>");
       cache_il1 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 			       /* usize */0, assoc, cache_char2policy(c),
-			       il1_access_fn, /* hit lat */cache_il1_lat);
+			       il1_access_fn, /* hit lat */cache_il1_lat,
+			       /* no prefetcher */0);
 
       /* is the level 2 D-cache defined? */
       if (!mystricmp(cache_il2_opt, "none"))
@@ -1091,7 +1327,8 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 		  "<name>:<nsets>:<bsize>:<assoc>:<repl>");
 	  cache_il2 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 				   /* usize */0, assoc, cache_char2policy(c),
-				   il2_access_fn, /* hit lat */cache_il2_lat);
+				   il2_access_fn, /* hit lat */cache_il2_lat,
+				   /* no prefetcher */0);
 	}
     }
 
@@ -1106,7 +1343,7 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
       itlb = cache_create(name, nsets, bsize, /* balloc */FALSE,
 			  /* usize */sizeof(md_addr_t), assoc,
 			  cache_char2policy(c), itlb_access_fn,
-			  /* hit latency */1);
+			  /* hit latency */1, /* no prefetcher */0);
     }
 
   /* use a D-TLB? */
@@ -1120,7 +1357,7 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
       dtlb = cache_create(name, nsets, bsize, /* balloc */FALSE,
 			  /* usize */sizeof(md_addr_t), assoc,
 			  cache_char2policy(c), dtlb_access_fn,
-			  /* hit latency */1);
+			  /* hit latency */1, /* no prefetcher */0);
     }
 
   if (cache_dl1_lat < 1)
@@ -1190,6 +1427,12 @@ void
 sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
 {
   int i;
+  char buf[128];
+  /* with sampling, sim_num_insn also counts the insts executed functionally
+     between the samples, so the per-inst rates are over the insts simulated
+     in detail, and sample_CPI estimates the CPI of the program */
+  char *insn = sample_period ? "sample_detail_insn" : "sim_num_insn";
+
   stat_reg_counter(sdb, "sim_num_insn",
 		   "total number of instructions committed",
 		   &sim_num_insn, sim_num_insn, NULL);
@@ -1232,18 +1475,29 @@ sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
   stat_reg_counter(sdb, "sim_cycle",
 		   "total simulation time in cycles",
 		   &sim_cycle, /* initial value */0, /* format */NULL);
+  stat_reg_counter(sdb, "sim_idle_cycles",
+		   "cycles skipped while the pipeline was idle",
+		   &sim_idle_cycles, /* initial value */0, /* format */NULL);
+  sprintf(buf, "%s / sim_cycle", insn);
   stat_reg_formula(sdb, "sim_IPC",
-		   "instructions per cycle",
-		   "sim_num_insn / sim_cycle", /* format */NULL);
+		   sample_period
+		   ? "instructions per cycle, of the insts simulated in detail"
+		   : "instructions per cycle",
+		   buf, /* format */NULL);
+  sprintf(buf, "sim_cycle / %s", insn);
   stat_reg_formula(sdb, "sim_CPI",
-		   "cycles per instruction",
-		   "sim_cycle / sim_num_insn", /* format */NULL);
+		   sample_period
+		   ? "cycles per instruction, of the insts simulated in detail "
+		     "(see sample_CPI)"
+		   : "cycles per instruction",
+		   buf, /* format */NULL);
   stat_reg_formula(sdb, "sim_exec_BW",
 		   "total instructions (mis-spec + committed) per cycle",
 		   "sim_total_insn / sim_cycle", /* format */NULL);
+  sprintf(buf, "%s / sim_num_branches", insn);
   stat_reg_formula(sdb, "sim_IPB",
 		   "instruction per branch",
-		   "sim_num_insn / sim_num_branches", /* format */NULL);
+		   buf, /* format */NULL);
 
   /* occupancy stats */
   stat_reg_counter(sdb, "IFQ_count", "cumulative IFQ occupancy",
@@ -1285,13 +1539,71 @@ sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
   stat_reg_formula(sdb, "lsq_full", "fraction of time (cycle's) LSQ was full",
                    "LSQ_fcount / sim_cycle", /* format */NULL);
 
+  if (ss_enabled)
+    {
+      stat_reg_counter(sdb, "lsq_spec_loads",
+		       "total loads issued past an unknown store address",
+		       &lsq_spec_loads, /* initial value */0, /* format */NULL);
+      stat_reg_counter(sdb, "lsq_violations",
+		       "total memory order violations",
+		       &lsq_violations, /* initial value */0, /* format */NULL);
+      stat_reg_counter(sdb, "lsq_violation_squash",
+		       "total insts squashed by memory order violations",
+		       &lsq_violation_squash, /* initial value */0,
+		       /* format */NULL);
+      stat_reg_counter(sdb, "lsq_false_deps",
+		       "total loads held for a predicted store to another "
+		       "address",
+		       &lsq_false_deps, /* initial value */0, /* format */NULL);
+      stat_reg_formula(sdb, "lsq_violation_rate",
+		       "memory order violations per speculative load",
+		       "lsq_violations / lsq_spec_loads", /* format */NULL);
+    }
+
+  if (func_thread)
+    stat_reg_counter(sdb, "func_sync_insn",
+		     "total insts the timing thread executed itself",
+		     &func_sync_insn, /* initial value */0, /* format */NULL);
+
+  if (sample_period)
+    {
+      stat_reg_counter(sdb, "sample_num",
+		       "total number of measured sample windows",
+		       &sample_num, /* initial value */0, /* format */NULL);
+      stat_reg_counter(sdb, "sample_func_insn",
+		       "total number of insts executed functionally",
+		       &sample_func_insn, /* initial value */0, /* format */NULL);
+      stat_reg_formula(sdb, "sample_detail_insn",
+		       "total number of insts simulated in detail",
+		       "sim_num_insn - sample_func_insn", /* format */NULL);
+      stat_reg_double(sdb, "sample_CPI",
+		      "mean CPI of the measured sample windows",
+		      &sample_cpi, /* initial value */0.0, /* format */NULL);
+      stat_reg_double(sdb, "sample_CPI_stddev",
+		      "standard deviation of the sample window CPIs",
+		      &sample_cpi_stddev, /* initial value */0.0,
+		      /* format */NULL);
+      stat_reg_double(sdb, "sample_CPI_error",
+		      "relative half-width of the sampled CPI confidence "
+		      "interval",
+		      &sample_cpi_error, /* initial value */0.0,
+		      /* format */NULL);
+      stat_reg_formula(sdb, "sample_IPC",
+		       "IPC of the sampled CPI",
+		       "1 / sample_CPI", /* format */NULL);
+      stat_reg_formula(sdb, "sample_est_cycle",
+		       "estimated cycles of all insts, at the sampled CPI",
+		       "sample_CPI * sim_num_insn", /* format */NULL);
+    }
+
   stat_reg_counter(sdb, "sim_slip",
                    "total number of slip cycles",
                    &sim_slip, 0, NULL);
   /* register baseline stats */
+  sprintf(buf, "sim_slip / %s", insn);
   stat_reg_formula(sdb, "avg_sim_slip",
                    "the average slip between issue and retirement",
-                   "sim_slip / sim_num_insn", NULL);
+                   buf, NULL);
 
   /* register predictor stats */
   if (pred)
@@ -1474,6 +1786,18 @@ typedef unsigned int INST_SEQ_TYPE;
 /* total output dependencies possible */
 #define MAX_ODEPS               2
 
+/* the outcome of a non-speculative instruction, as it executed at
+   dispatch; if a memory order violation squashes it, ruu_dispatch()
+   dispatches it again from this record rather than executing it twice
+   (see lsq_recover()) */
+struct replay_rec {
+  md_addr_t PC, NPC;			/* inst PC, next PC */
+  md_addr_t target_PC;			/* target PC of a direct jump */
+  md_addr_t addr;			/* effective address for ld/st's */
+  enum md_opcode op;			/* decoded instruction opcode */
+  counter_t num;			/* sim_num_insn of the inst */
+};
+
 /* a register update unit (RUU) station, this record is contained in the
    processors RUU, which serves as a collection of ordered reservations
    stations.  The reservation stations capture register results and await
@@ -1522,6 +1846,22 @@ struct RUU_station {
      operands are known to be read (see lsq_refresh() for details on
      enforcing memory dependencies) */
   int idep_ready[MAX_IDEPS];		/* input operand ready? */
+
+  /* memory dependence tracking of the LSQ, see lsq_refresh() */
+  int st_hash_next;			/* next known-address store of the
+					   same address hash bucket, or -1 */
+  struct RS_link *ld_wait_list;		/* loads waiting for the data of
+					   this store */
+  int ld_waiting;			/* load is on a store's wait list */
+  struct RUU_station *ss_store;		/* store the load is predicted to */
+  INST_TAG_TYPE ss_store_tag;		/*   depend on, and its tag */
+  int ld_spec;				/* load issued past an unknown store
+					   address, it is in LSQ_ld_hash */
+  int ld_hash_next;			/* next such load of the same address
+					   hash bucket, or -1 */
+
+  /* the inst as it executed (in the address computation of a ld/st) */
+  struct replay_rec replay;
 };
 
 /* non-zero if all register operands are ready, update with MAX_IDEPS */
@@ -1652,14 +1992,92 @@ static int LSQ_num;                     /* num entries currently in LSQ */
 #define STORE_OP_READY(RS)              ((RS)->idep_ready[STORE_OP_INDEX])
 #define STORE_ADDR_READY(RS)            ((RS)->idep_ready[STORE_ADDR_INDEX])
 
+/* non-zero if LSQ entry RS is a store, or a load */
+#define LSQ_IS_STORE(RS)						\
+  ((MD_OP_FLAGS((RS)->op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE))
+#define LSQ_IS_LOAD(RS)							\
+  ((MD_OP_FLAGS((RS)->op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD))
+
+/* position of LSQ entry RS, counted from the LSQ head (the oldest is 0) */
+#define LSQ_POS(RS)							\
+  (((RS) - LSQ + LSQ_size - LSQ_head) % LSQ_size)
+
+/* number of LSQ entries from the head that lsq_refresh() passed, none of
+   them is a store with an unknown address */
+static int LSQ_sta_known;
+
+/* stores in the LSQ with a known address, by address hash, each bucket is
+   the LSQ index of its first store (or -1) chained through st_hash_next */
+static int *LSQ_st_hash;
+static int LSQ_st_hash_mask;
+
+/* bucket of address ADDR in LSQ_st_hash (and LSQ_ld_hash) */
+#define LSQ_ST_HASH(ADDR)						\
+  ((((ADDR) >> 2) ^ ((ADDR) >> 14)) & LSQ_st_hash_mask)
+
+/* loads in the LSQ that issued past a store with an unknown address, by
+   address hash, chained through ld_hash_next (store sets only) */
+static int *LSQ_ld_hash;
+
+/* store set id table, the store set of each load and store PC (or -1) */
+static int *ss_ssit;
+
+/* index of PC in the SSIT */
+#define SSIT_INDEX(PC)							\
+  (((PC) / sizeof(md_inst_t)) & (ss_ssit_size - 1))
+
+/* last fetched store table, the youngest store dispatched of each store
+   set, valid while the store is in the LSQ */
+struct ss_lfst_ent {
+  struct RUU_station *rs;		/* store LSQ entry, or NULL */
+  INST_TAG_TYPE tag;			/* its instance tag */
+};
+static struct ss_lfst_ent *ss_lfst;
+
+/* cycle the SSIT is cleared next */
+static tick_t ss_clear_cycle;
+
+/* non-speculative insts squashed by memory order violations, in program
+   order, that ruu_dispatch() has yet to dispatch again; as many as the RUU
+   holds at most */
+static struct replay_rec *replay_buf;
+static int replay_head, replay_num;
+
 /* allocate and initialize the load/store queue (LSQ) */
 static void
 lsq_init(void)
 {
+  int i;
+
   LSQ = calloc(LSQ_size, sizeof(struct RUU_station));
   if (!LSQ)
     fatal("out of virtual memory");
 
+  /* twice as many buckets as LSQ entries */
+  LSQ_st_hash_mask = 2*LSQ_size - 1;
+  LSQ_st_hash = calloc(2*LSQ_size, sizeof(int));
+  if (!LSQ_st_hash)
+    fatal("out of virtual memory");
+  for (i=0; i < 2*LSQ_size; i++)
+    LSQ_st_hash[i] = -1;
+  LSQ_sta_known = 0;
+
+  if (ss_enabled)
+    {
+      LSQ_ld_hash = calloc(2*LSQ_size, sizeof(int));
+      ss_ssit = calloc(ss_ssit_size, sizeof(int));
+      ss_lfst = calloc(ss_lfst_size, sizeof(struct ss_lfst_ent));
+      replay_buf = calloc(RUU_size, sizeof(struct replay_rec));
+      if (!LSQ_ld_hash || !ss_ssit || !ss_lfst || !replay_buf)
+	fatal("out of virtual memory");
+      for (i=0; i < 2*LSQ_size; i++)
+	LSQ_ld_hash[i] = -1;
+      for (i=0; i < ss_ssit_size; i++)
+	ss_ssit[i] = -1;
+      ss_clear_cycle = ss_clear_interval;
+      replay_head = replay_num = 0;
+    }
+
   LSQ_num = 0;
   LSQ_head = LSQ_tail = 0;
   LSQ_count = 0;
@@ -1809,16 +2227,54 @@ ruu_release_fu(void)
  * drains this queue
  */
 
-/* pending event queue, sorted from soonest to latest event (in time), NOTE:
-   RS_LINK nodes are used for the event queue list so that it need not be
-   updated during squash events */
-static struct RS_link *event_queue;
+/* pending event queue, a timing wheel of EVENTQ_WHEEL_SIZE buckets, one per
+   cycle, for the events of the next EVENTQ_WHEEL_SIZE cycles, and a heap for
+   the events further in the future, which move to the wheel as their cycle
+   comes in range; events of the same cycle are serviced from the latest
+   queued to the earliest, NOTE: RS_LINK nodes are used for the event queue
+   lists so that they need not be updated during squash events, squashed
+   events are dropped when their cycle is serviced */
+#define EVENTQ_WHEEL_SIZE	1024
+
+/* events of each cycle in range, the cycle WHEN is in bucket
+   WHEN % EVENTQ_WHEEL_SIZE */
+static struct RS_link *event_wheel[EVENTQ_WHEEL_SIZE];
+
+/* first cycle whose events are not serviced yet, the wheel holds the events
+   of cycles event_base to event_base + EVENTQ_WHEEL_SIZE - 1 */
+static tick_t event_base;
+
+/* number of events in the wheel */
+static int event_wheel_count;
+
+/* an event beyond the wheel, by cycle then by the order it was queued in */
+struct eventq_far {
+  tick_t when;				/* cycle of the event */
+  counter_t seq;			/* order the event was queued in */
+  struct RS_link *ev;			/* the event */
+};
+
+/* events beyond the wheel, a binary min-heap */
+static struct eventq_far *event_heap;
+static int event_heap_count;
+static int event_heap_size;
+static counter_t event_heap_seq;
 
 /* initialize the event queue structures */
 static void
 eventq_init(void)
 {
-  event_queue = NULL;
+  int i;
+
+  for (i=0; i < EVENTQ_WHEEL_SIZE; i++)
+    event_wheel[i] = NULL;
+  event_base = 0;
+  event_wheel_count = 0;
+
+  event_heap = NULL;
+  event_heap_count = 0;
+  event_heap_size = 0;
+  event_heap_seq = 0;
 }
 
 /* dump the contents of the event queue */
@@ -1826,34 +2282,119 @@ static void
 eventq_dump(FILE *stream)			/* output stream */
 {
   struct RS_link *ev;
+  int i;
 
   if (!stream)
     stream = stderr;
 
   fprintf(stream, "** event queue state **\n");
 
-  for (ev = event_queue; ev != NULL; ev = ev->next)
+  /* the wheel in cycle order, then the heap */
+  for (i=0; i < EVENTQ_WHEEL_SIZE + event_heap_count; i++)
     {
-      /* is event still valid? */
-      if (RSLINK_VALID(ev))
+      ev = (i < EVENTQ_WHEEL_SIZE
+	    ? event_wheel[(event_base + i) % EVENTQ_WHEEL_SIZE]
+	    : event_heap[i - EVENTQ_WHEEL_SIZE].ev);
+      for (; ev != NULL; ev = (i < EVENTQ_WHEEL_SIZE ? ev->next : NULL))
 	{
-	  struct RUU_station *rs = RSLINK_RS(ev);
+	  /* is event still valid? */
+	  if (RSLINK_VALID(ev))
+	    {
+	      struct RUU_station *rs = RSLINK_RS(ev);
 
-	  fprintf(stream, "idx: %2d: @ %.0f\n",
-		  (int)(rs - (rs->in_LSQ ? LSQ : RUU)), (double)ev->x.when);
-	  ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
-		      stream, /* !header */FALSE);
+	      fprintf(stream, "idx: %2d: @ %.0f\n",
+		      (int)(rs - (rs->in_LSQ ? LSQ : RUU)), (double)ev->x.when);
+	      ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
+			  stream, /* !header */FALSE);
+	    }
 	}
     }
 }
 
-/* insert an event for RS into the event queue, event queue is sorted from
-   earliest to latest event, event and associated side-effects will be
-   apparent at the start of cycle WHEN */
+/* non-zero if heap entry A comes before heap entry B */
+#define EVENTQ_FAR_BEFORE(A, B)						\
+  ((A)->when < (B)->when || ((A)->when == (B)->when && (A)->seq < (B)->seq))
+
+/* insert an event in the heap of the events beyond the wheel */
+static void
+eventq_heap_push(struct RS_link *ev)
+{
+  struct eventq_far far;
+  int i, parent;
+
+  if (event_heap_count == event_heap_size)
+    {
+      event_heap_size = event_heap_size ? 2 * event_heap_size : 64;
+      event_heap = realloc(event_heap,
+			   event_heap_size * sizeof(struct eventq_far));
+      if (!event_heap)
+	fatal("out of virtual memory");
+    }
+
+  far.when = ev->x.when;
+  far.seq = event_heap_seq++;
+  far.ev = ev;
+
+  /* sift up */
+  for (i = event_heap_count++; i > 0; i = parent)
+    {
+      parent = (i - 1) / 2;
+      if (!EVENTQ_FAR_BEFORE(&far, &event_heap[parent]))
+	break;
+      event_heap[i] = event_heap[parent];
+    }
+  event_heap[i] = far;
+}
+
+/* remove the earliest event of the heap */
+static struct RS_link *
+eventq_heap_pop(void)
+{
+  struct RS_link *ev = event_heap[0].ev;
+  struct eventq_far last = event_heap[--event_heap_count];
+  int i, child;
+
+  /* sift down */
+  for (i = 0; (child = 2 * i + 1) < event_heap_count; i = child)
+    {
+      if (child + 1 < event_heap_count
+	  && EVENTQ_FAR_BEFORE(&event_heap[child + 1], &event_heap[child]))
+	child++;
+      if (!EVENTQ_FAR_BEFORE(&event_heap[child], &last))
+	break;
+      event_heap[i] = event_heap[child];
+    }
+  event_heap[i] = last;
+  return ev;
+}
+
+/* move the events of the heap whose cycle came in the range of the wheel,
+   the earliest queued first so that the latest queued of a cycle is still
+   serviced first */
+static void
+eventq_heap_drain(void)
+{
+  struct RS_link *ev;
+  int bucket;
+
+  while (event_heap_count > 0
+	 && event_heap[0].when < event_base + EVENTQ_WHEEL_SIZE)
+    {
+      ev = eventq_heap_pop();
+      bucket = ev->x.when % EVENTQ_WHEEL_SIZE;
+      ev->next = event_wheel[bucket];
+      event_wheel[bucket] = ev;
+      event_wheel_count++;
+    }
+}
+
+/* insert an event for RS into the event queue, event and associated
+   side-effects will be apparent at the start of cycle WHEN */
 static void
 eventq_queue_event(struct RUU_station *rs, tick_t when)
 {
-  struct RS_link *prev, *ev, *new_ev;
+  struct RS_link *new_ev;
+  int bucket;
 
   if (rs->completed)
     panic("event completed");
@@ -1865,23 +2406,42 @@ eventq_queue_event(struct RUU_station *rs, tick_t when)
   RSLINK_NEW(new_ev, rs);
   new_ev->x.when = when;
 
-  /* locate insertion point */
-  for (prev=NULL, ev=event_queue;
-       ev && ev->x.when < when;
-       prev=ev, ev=ev->next);
-
-  if (prev)
+  if (when >= event_base + EVENTQ_WHEEL_SIZE)
     {
-      /* insert middle or end */
-      new_ev->next = prev->next;
-      prev->next = new_ev;
+      /* beyond the wheel */
+      eventq_heap_push(new_ev);
+      return;
     }
-  else
+
+  /* events of the heap that came in range were queued earlier, they move to
+     the wheel first */
+  eventq_heap_drain();
+
+  /* insert ahead of the earlier events of the same cycle */
+  bucket = when % EVENTQ_WHEEL_SIZE;
+  new_ev->next = event_wheel[bucket];
+  event_wheel[bucket] = new_ev;
+  event_wheel_count++;
+}
+
+/* return the earliest cycle with a pending event, squashed or not, or 0 if
+   the event queue is empty */
+static tick_t
+eventq_next_cycle(void)
+{
+  tick_t when;
+
+  if (event_wheel_count > 0)
     {
-      /* insert at beginning */
-      new_ev->next = event_queue;
-      event_queue = new_ev;
+      /* the wheel holds the earliest events */
+      for (when = event_base; !event_wheel[when % EVENTQ_WHEEL_SIZE]; when++)
+	/* nada */;
+      return when;
     }
+  else if (event_heap_count > 0)
+    return event_heap[0].when;
+  else
+    return 0;
 }
 
 /* return the next event that has already occurred, returns NULL when no
@@ -1890,37 +2450,48 @@ static struct RUU_station *
 eventq_next_event(void)
 {
   struct RS_link *ev;
+  struct RUU_station *rs;
+  int bucket;
 
-  if (event_queue && event_queue->x.when <= sim_cycle)
+  for (;;)
     {
-      /* unlink and return first event on priority list */
-      ev = event_queue;
-      event_queue = event_queue->next;
+      /* with no event in the wheel, go straight to the current cycle or to
+	 the earliest event of the heap */
+      if (event_wheel_count == 0 && event_base < sim_cycle)
+	event_base = (event_heap_count > 0
+		      ? MIN(event_heap[0].when, sim_cycle) : sim_cycle);
+      eventq_heap_drain();
+
+      /* skip the cycles up to the current one with no event left */
+      bucket = event_base % EVENTQ_WHEEL_SIZE;
+      while (!event_wheel[bucket] && event_base < sim_cycle)
+	{
+	  event_base++;
+	  eventq_heap_drain();
+	  bucket = event_base % EVENTQ_WHEEL_SIZE;
+	}
 
-      /* event still valid? */
-      if (RSLINK_VALID(ev))
+      if (!event_wheel[bucket])
 	{
-	  struct RUU_station *rs = RSLINK_RS(ev);
+	  /* no event or no event is ready */
+	  return NULL;
+	}
 
-	  /* reclaim event record */
-	  RSLINK_FREE(ev);
+      /* unlink the latest event queued for the cycle */
+      ev = event_wheel[bucket];
+      event_wheel[bucket] = ev->next;
+      event_wheel_count--;
 
-	  /* event is valid, return resv station */
-	  return rs;
-	}
-      else
+      /* reclaim event record, the event of a squashed inst is dropped */
+      rs = RSLINK_RS(ev);
+      if (RSLINK_VALID(ev))
 	{
-	  /* reclaim event record */
 	  RSLINK_FREE(ev);
 
-	  /* receiving inst was squashed, return next event */
-	  return eventq_next_event();
+	  /* event is valid, return resv station */
+	  return rs;
 	}
-    }
-  else
-    {
-      /* no event or no event is ready */
-      return NULL;
+      RSLINK_FREE(ev);
     }
 }
 
@@ -1930,146 +2501,471 @@ eventq_next_event(void)
  * queue indicates which instruction have all of there *register* dependencies
  * satisfied, instruction will issue when 1) all memory dependencies for
  * the instruction have been satisfied (see lsq_refresh() for details on how
- * this is accomplished) and 2) resources are available; ready queue is fully
- * constructed each cycle before any operation is issued from it -- this
- * ensures that instruction issue priorities are properly observed; NOTE:
- * RS_LINK nodes are used for the event queue list so that it need not be
- * updated during squash events
+ * this is accomplished) and 2) resources are available; the queue is a
+ * bitmap of the RUU and LSQ slots, scanned from the head of each so the
+ * oldest ready instruction is found first, and a squashed entry has its bit
+ * cleared by ruu_recover()
  */
 
-/* the ready instruction queue */
-static struct RS_link *ready_queue;
+/* ready RUU entries of long latency ops and branches, ready LSQ entries,
+   and the other ready RUU entries, a bit per slot */
+static BITMAP_PTR_TYPE ready_ruu_pri;
+static BITMAP_PTR_TYPE ready_lsq;
+static BITMAP_PTR_TYPE ready_ruu;
 
-/* initialize the event queue structures */
+/* number of entries in the ready queue */
+static int readyq_num;
+
+/* non-zero if the RUU entry RS is issued before the other ready ops */
+#define READYQ_PRIORITY(RS)	(MD_OP_FLAGS((RS)->op) & (F_LONGLAT|F_CTRL))
+
+/* initialize the ready queue structures */
 static void
 readyq_init(void)
 {
-  ready_queue = NULL;
+  ready_ruu_pri = calloc(BITMAP_SIZE(RUU_size), sizeof(BITMAP_ENT_TYPE));
+  ready_lsq = calloc(BITMAP_SIZE(LSQ_size), sizeof(BITMAP_ENT_TYPE));
+  ready_ruu = calloc(BITMAP_SIZE(RUU_size), sizeof(BITMAP_ENT_TYPE));
+  if (!ready_ruu_pri || !ready_lsq || !ready_ruu)
+    fatal("out of virtual memory");
+  readyq_num = 0;
 }
 
-/* dump the contents of the ready queue */
-static void
-readyq_dump(FILE *stream)			/* output stream */
+/* returns the distance from HEAD of the first slot at distance OFF or more
+   whose bit is set in MAP, a bitmap of SIZE slots (a power of two) of which
+   the NUM slots from slot HEAD around are in use, or NUM if there is none */
+static int
+readyq_find(BITMAP_PTR_TYPE map, int size, int head, int num, int off)
 {
-  struct RS_link *link;
-
-  if (!stream)
-    stream = stderr;
-
-  fprintf(stream, "** ready queue state **\n");
+  BITMAP_ENT_TYPE word;
+  int slot;
 
-  for (link = ready_queue; link != NULL; link = link->next)
+  while (off < num)
     {
-      /* is entry still valid? */
-      if (RSLINK_VALID(link))
+      slot = (head + off) & (size - 1);
+      word = map[slot / 32] >> (slot % 32);
+      if (word)
 	{
-	  struct RUU_station *rs = RSLINK_RS(link);
-
-	  ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
-		      stream, /* header */TRUE);
+	  /* a set bit past the slots in use is not looked at */
+	  off += ffs(word) - 1;
+	  return MIN(off, num);
 	}
+
+      /* go to the next word, or to slot 0 past the end of the map */
+      off += MIN(32 - slot % 32, size - slot);
     }
+  return num;
+}
+
+/* position of the select logic in the ready queue during a cycle */
+struct readyq_sel {
+  int pri_off;				/* distances from the RUU and LSQ */
+  int lsq_off;				/*   heads of the next slots to */
+  int ruu_off;				/*   look at */
+};
+
+/* start selecting from the oldest ready instructions */
+static void
+readyq_sel_init(struct readyq_sel *sel)
+{
+  sel->pri_off = sel->lsq_off = sel->ruu_off = 0;
 }
 
-/* insert ready node into the ready list using ready instruction scheduling
-   policy; currently the following scheduling policy is enforced:
+/* returns the next ready instruction by the scheduling policy enforced,
+   passing it, or NULL if all of them were passed:
 
      memory and long latency operands, and branch instructions first
 
    then
 
-     all other instructions, oldest instructions first
+     all other instructions
+
+   oldest instructions first in both groups; this policy works well because
+   branches pass through the machine quicker which works to reduce branch
+   misprediction latencies, and very long latency instructions (such loads
+   and multiplies) get priority since they are very likely on the program's
+   critical path */
+static struct RUU_station *
+readyq_select(struct readyq_sel *sel)
+{
+  struct RUU_station *pri_rs = NULL, *lsq_rs = NULL;
+
+  sel->pri_off = readyq_find(ready_ruu_pri, RUU_size, RUU_head, RUU_num,
+			     sel->pri_off);
+  sel->lsq_off = readyq_find(ready_lsq, LSQ_size, LSQ_head, LSQ_num,
+			     sel->lsq_off);
+  if (sel->pri_off < RUU_num)
+    pri_rs = &RUU[(RUU_head + sel->pri_off) & (RUU_size - 1)];
+  if (sel->lsq_off < LSQ_num)
+    lsq_rs = &LSQ[(LSQ_head + sel->lsq_off) & (LSQ_size - 1)];
+
+  /* the older of the first ready entries of the RUU and of the LSQ */
+  if (pri_rs && (!lsq_rs || pri_rs->seq < lsq_rs->seq))
+    {
+      sel->pri_off++;
+      return pri_rs;
+    }
+  if (lsq_rs)
+    {
+      sel->lsq_off++;
+      return lsq_rs;
+    }
+
+  sel->ruu_off = readyq_find(ready_ruu, RUU_size, RUU_head, RUU_num,
+			     sel->ruu_off);
+  if (sel->ruu_off < RUU_num)
+    return &RUU[(RUU_head + sel->ruu_off++) & (RUU_size - 1)];
+  return NULL;
+}
 
-  this policy works well because branches pass through the machine quicker
-  which works to reduce branch misprediction latencies, and very long latency
-  instructions (such loads and multiplies) get priority since they are very
-  likely on the program's critical path */
+/* dump the contents of the ready queue */
 static void
-readyq_enqueue(struct RUU_station *rs)		/* RS to enqueue */
+readyq_dump(FILE *stream)			/* output stream */
 {
-  struct RS_link *prev, *node, *new_node;
+  struct readyq_sel sel;
+  struct RUU_station *rs;
 
+  if (!stream)
+    stream = stderr;
+
+  fprintf(stream, "** ready queue state **\n");
+
+  readyq_sel_init(&sel);
+  while ((rs = readyq_select(&sel)) != NULL)
+    ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
+		stream, /* header */TRUE);
+}
+
+/* insert ready node into the ready queue */
+static void
+readyq_enqueue(struct RUU_station *rs)		/* RS to enqueue */
+{
   /* node is now queued */
   if (rs->queued)
     panic("node is already queued");
   rs->queued = TRUE;
+  readyq_num++;
 
-  /* get a free ready list node */
-  RSLINK_NEW(new_node, rs);
-  new_node->x.seq = rs->seq;
-
-  /* locate insertion point */
-  if (rs->in_LSQ || MD_OP_FLAGS(rs->op) & (F_LONGLAT|F_CTRL))
-    {
-      /* insert loads/stores and long latency ops at the head of the queue */
-      prev = NULL;
-      node = ready_queue;
-    }
+  if (rs->in_LSQ)
+    (void)BITMAP_SET(ready_lsq, BITMAP_SIZE(LSQ_size), rs - LSQ);
+  else if (READYQ_PRIORITY(rs))
+    (void)BITMAP_SET(ready_ruu_pri, BITMAP_SIZE(RUU_size), rs - RUU);
   else
-    {
-      /* otherwise insert in program order (earliest seq first) */
-      for (prev=NULL, node=ready_queue;
-	   node && node->x.seq < rs->seq;
-	   prev=node, node=node->next);
-    }
+    (void)BITMAP_SET(ready_ruu, BITMAP_SIZE(RUU_size), rs - RUU);
+}
 
-  if (prev)
-    {
-      /* insert middle or end */
-      new_node->next = prev->next;
-      prev->next = new_node;
-    }
+/* remove a node from the ready queue, once it issues or is squashed */
+static void
+readyq_remove(struct RUU_station *rs)		/* RS to remove */
+{
+  /* node is now un-queued */
+  rs->queued = FALSE;
+  readyq_num--;
+
+  if (rs->in_LSQ)
+    (void)BITMAP_CLEAR(ready_lsq, BITMAP_SIZE(LSQ_size), rs - LSQ);
   else
     {
-      /* insert at beginning */
-      new_node->next = ready_queue;
-      ready_queue = new_node;
+      (void)BITMAP_CLEAR(ready_ruu_pri, BITMAP_SIZE(RUU_size), rs - RUU);
+      (void)BITMAP_CLEAR(ready_ruu, BITMAP_SIZE(RUU_size), rs - RUU);
     }
 }
 
 
 /*
- * the create vector maps a logical register to a creator in the RUU (and
- * specific output operand) or the architected register file (if RS_link
- * is NULL)
+ * the memory dependences of loads are tracked as the stores in the LSQ
+ * resolve, see lsq_refresh() for the conditions under which a load may issue
  */
 
-/* an entry in the create vector */
-struct CV_link {
-  struct RUU_station *rs;               /* creator's reservation station */
-  int odep_num;                         /* specific output operand */
-};
+/* returns the youngest store older than load RS whose address is known and
+   the same as the load's, or NULL if there is none */
+static struct RUU_station *
+lsq_last_store(struct RUU_station *rs)		/* LSQ load */
+{
+  struct RUU_station *st = NULL;
+  int i, pos, ld_pos = LSQ_POS(rs), st_pos = -1;
 
-/* a NULL create vector entry */
-static struct CV_link CVLINK_NULL = { NULL, 0 };
+  for (i = LSQ_st_hash[LSQ_ST_HASH(rs->addr)]; i != -1;
+       i = LSQ[i].st_hash_next)
+    {
+      pos = LSQ_POS(&LSQ[i]);
+      if (LSQ[i].addr == rs->addr && pos < ld_pos && pos > st_pos)
+	{
+	  st = &LSQ[i];
+	  st_pos = pos;
+	}
+    }
+  return st;
+}
 
-/* get a new create vector link */
-#define CVLINK_INIT(CV, RS,ONUM)	((CV).rs = (RS), (CV).odep_num = (ONUM))
+/* add store RS, whose address is now known, to the store address index;
+   returns the oldest load that issued past the store to the same address,
+   a memory order violation, or NULL if there is none */
+static struct RUU_station *
+lsq_store_known(struct RUU_station *rs)		/* LSQ store */
+{
+  struct RUU_station *ld = NULL;
+  int *bucket = &LSQ_st_hash[LSQ_ST_HASH(rs->addr)];
+  int i, pos, st_pos, ld_pos = LSQ_size;
 
-/* size of the create vector (one entry per architected register) */
-#define CV_BMAP_SZ              (BITMAP_SIZE(MD_TOTAL_REGS))
+  rs->st_hash_next = *bucket;
+  *bucket = rs - LSQ;
 
-/* the create vector, NOTE: speculative copy on write storage provided
-   for fast recovery during wrong path execute (see tracer_recover() for
-   details on this process */
-static BITMAP_TYPE(MD_TOTAL_REGS, use_spec_cv);
-static struct CV_link create_vector[MD_TOTAL_REGS];
-static struct CV_link spec_create_vector[MD_TOTAL_REGS];
+  if (!ss_enabled)
+    return NULL;
 
-/* these arrays shadow the create vector an indicate when a register was
-   last created */
-static tick_t create_vector_rt[MD_TOTAL_REGS];
-static tick_t spec_create_vector_rt[MD_TOTAL_REGS];
+  /* a younger load to the address that did not get its value from a store
+     in between should have gotten it from this one */
+  st_pos = LSQ_POS(rs);
+  for (i = LSQ_ld_hash[LSQ_ST_HASH(rs->addr)]; i != -1;
+       i = LSQ[i].ld_hash_next)
+    {
+      pos = LSQ_POS(&LSQ[i]);
+      if (LSQ[i].addr == rs->addr && pos > st_pos && pos < ld_pos
+	  && lsq_last_store(&LSQ[i]) == rs)
+	{
+	  ld = &LSQ[i];
+	  ld_pos = pos;
+	}
+    }
+  return ld;
+}
 
-/* read a create vector entry */
-#define CREATE_VECTOR(N)        (BITMAP_SET_P(use_spec_cv, CV_BMAP_SZ, (N))\
-				 ? spec_create_vector[N]                \
-				 : create_vector[N])
+/* remove store RS from the store address index, once it commits or is
+   squashed */
+static void
+lsq_store_forget(struct RUU_station *rs)	/* LSQ store */
+{
+  int *link = &LSQ_st_hash[LSQ_ST_HASH(rs->addr)];
 
-/* read a create vector timestamp entry */
-#define CREATE_VECTOR_RT(N)     (BITMAP_SET_P(use_spec_cv, CV_BMAP_SZ, (N))\
-				 ? spec_create_vector_rt[N]             \
-				 : create_vector_rt[N])
+  while (*link != rs - LSQ)
+    {
+      if (*link == -1)
+	panic("store not in the address index");
+      link = &LSQ[*link].st_hash_next;
+    }
+  *link = rs->st_hash_next;
+}
+
+/* load RS issues, it is kept in the index of loads that issued past an
+   unknown store address if it did */
+static void
+lsq_load_issued(struct RUU_station *rs)		/* LSQ load */
+{
+  int *bucket;
+
+  if (!ss_enabled || LSQ_POS(rs) < LSQ_sta_known)
+    return;
+
+  lsq_spec_loads++;
+  rs->ld_spec = TRUE;
+  bucket = &LSQ_ld_hash[LSQ_ST_HASH(rs->addr)];
+  rs->ld_hash_next = *bucket;
+  *bucket = rs - LSQ;
+}
+
+/* remove load RS from the index of loads that issued past an unknown store
+   address, once it commits or is squashed */
+static void
+lsq_load_forget(struct RUU_station *rs)		/* LSQ load */
+{
+  int *link;
+
+  if (!rs->ld_spec)
+    return;
+
+  link = &LSQ_ld_hash[LSQ_ST_HASH(rs->addr)];
+  while (*link != rs - LSQ)
+    {
+      if (*link == -1)
+	panic("load not in the address index");
+      link = &LSQ[*link].ld_hash_next;
+    }
+  *link = rs->ld_hash_next;
+  rs->ld_spec = FALSE;
+}
+
+/* put load RS on the ready queue if its memory dependences are satisfied,
+   or have it wait for the store it depends on; without store sets, loads
+   behind a store with an unknown address are looked at once lsq_refresh()
+   passes that store, with store sets, a load only waits for the store it
+   is predicted to depend on */
+static void
+lsq_check_load(struct RUU_station *rs)		/* LSQ load */
+{
+  struct RUU_station *st;
+  struct RS_link *link;
+
+  if (rs->queued || rs->issued || rs->completed || rs->ld_waiting
+      || !OPERANDS_READY(rs))
+    return;
+
+  if (!ss_enabled)
+    {
+      if (LSQ_POS(rs) >= LSQ_sta_known)
+	return;
+      st = NULL;
+    }
+  else if (rs->ss_store && rs->ss_store->tag == rs->ss_store_tag
+	   && !OPERANDS_READY(rs->ss_store))
+    {
+      /* predicted dependence, wait for the store address and data */
+      st = rs->ss_store;
+    }
+  else
+    st = NULL;
+
+  if (!st)
+    {
+      st = lsq_last_store(rs);
+      if (st && OPERANDS_READY(st))
+	st = NULL;
+    }
+
+  if (st)
+    {
+      /* STA or STD unknown, wait for the store */
+      RSLINK_NEW(link, rs);
+      link->next = st->ld_wait_list;
+      st->ld_wait_list = link;
+      rs->ld_waiting = TRUE;
+    }
+  else
+    {
+      /* no STA or STD unknown conflicts, put load on ready queue */
+      readyq_enqueue(rs);
+    }
+}
+
+/* the operands of store RS are ready, look at the loads waiting for it */
+static void
+lsq_store_ready(struct RUU_station *rs)		/* LSQ store */
+{
+  struct RS_link *link, *link_next;
+
+  for (link = rs->ld_wait_list; link; link = link_next)
+    {
+      if (RSLINK_VALID(link))
+	{
+	  /* a predicted store to another address held the load back */
+	  if (link->rs->addr != rs->addr)
+	    lsq_false_deps++;
+
+	  link->rs->ld_waiting = FALSE;
+	  lsq_check_load(link->rs);
+	}
+      link_next = link->next;
+      RSLINK_FREE(link);
+    }
+  rs->ld_wait_list = NULL;
+}
+
+/* look up the store set of the load or store RS as it is dispatched: a
+   load is predicted to depend on the last store dispatched of its set, and
+   a store becomes that last store */
+static void
+ss_dispatch(struct RUU_station *rs)		/* LSQ load or store */
+{
+  struct ss_lfst_ent *ent;
+  int ssid;
+
+  rs->ss_store = NULL;
+  if (!ss_enabled)
+    return;
+
+  /* clear the SSIT now and then, so stale store sets do not hold loads back
+     forever */
+  if (ss_clear_interval && sim_cycle >= ss_clear_cycle)
+    {
+      memset(ss_ssit, -1, ss_ssit_size * sizeof(int));
+      ss_clear_cycle = sim_cycle + ss_clear_interval;
+    }
+
+  ssid = ss_ssit[SSIT_INDEX(rs->PC)];
+  if (ssid == -1)
+    return;
+
+  ent = &ss_lfst[ssid];
+  if (LSQ_IS_STORE(rs))
+    {
+      ent->rs = rs;
+      ent->tag = rs->tag;
+    }
+  else if (ent->rs && ent->rs->tag == ent->tag)
+    {
+      rs->ss_store = ent->rs;
+      rs->ss_store_tag = ent->tag;
+    }
+}
+
+/* store ST and load LD violated memory order, put them in the same store
+   set so the load waits for the store next time */
+static void
+ss_train(struct RUU_station *st,		/* LSQ store */
+	 struct RUU_station *ld)		/* LSQ load */
+{
+  int *st_ssid = &ss_ssit[SSIT_INDEX(st->PC)];
+  int *ld_ssid = &ss_ssit[SSIT_INDEX(ld->PC)];
+
+  if (*st_ssid == -1 && *ld_ssid == -1)
+    {
+      /* a new store set, named after the load */
+      *st_ssid = *ld_ssid = SSIT_INDEX(ld->PC) & (ss_lfst_size - 1);
+    }
+  else if (*st_ssid == -1)
+    *st_ssid = *ld_ssid;
+  else if (*ld_ssid == -1)
+    *ld_ssid = *st_ssid;
+  else
+    {
+      /* merge the two store sets, the smaller id wins */
+      *st_ssid = *ld_ssid = MIN(*st_ssid, *ld_ssid);
+    }
+}
+
+
+/*
+ * the create vector maps a logical register to a creator in the RUU (and
+ * specific output operand) or the architected register file (if RS_link
+ * is NULL)
+ */
+
+/* an entry in the create vector */
+struct CV_link {
+  struct RUU_station *rs;               /* creator's reservation station */
+  int odep_num;                         /* specific output operand */
+};
+
+/* a NULL create vector entry */
+static struct CV_link CVLINK_NULL = { NULL, 0 };
+
+/* get a new create vector link */
+#define CVLINK_INIT(CV, RS,ONUM)	((CV).rs = (RS), (CV).odep_num = (ONUM))
+
+/* size of the create vector (one entry per architected register) */
+#define CV_BMAP_SZ              (BITMAP_SIZE(MD_TOTAL_REGS))
+
+/* the create vector, NOTE: speculative copy on write storage provided
+   for fast recovery during wrong path execute (see tracer_recover() for
+   details on this process */
+static BITMAP_TYPE(MD_TOTAL_REGS, use_spec_cv);
+static struct CV_link create_vector[MD_TOTAL_REGS];
+static struct CV_link spec_create_vector[MD_TOTAL_REGS];
+
+/* these arrays shadow the create vector an indicate when a register was
+   last created */
+static tick_t create_vector_rt[MD_TOTAL_REGS];
+static tick_t spec_create_vector_rt[MD_TOTAL_REGS];
+
+/* read a create vector entry */
+#define CREATE_VECTOR(N)        (BITMAP_SET_P(use_spec_cv, CV_BMAP_SZ, (N))\
+				 ? spec_create_vector[N]                \
+				 : create_vector[N])
+
+/* read a create vector timestamp entry */
+#define CREATE_VECTOR_RT(N)     (BITMAP_SET_P(use_spec_cv, CV_BMAP_SZ, (N))\
+				 ? spec_create_vector_rt[N]             \
+				 : create_vector_rt[N])
 
 /* set a create vector entry */
 #define SET_CREATE_VECTOR(N, L) (spec_mode                              \
@@ -2187,7 +3083,8 @@ ruu_commit(void)
 		      /* commit store value to D-cache */
 		      lat =
 			cache_access(cache_dl1, Write, (LSQ[LSQ_head].addr&~3),
-				     NULL, 4, sim_cycle, NULL, NULL);
+				     NULL, 4, sim_cycle, NULL, NULL,
+				     /* !prefetch */0);
 		      if (lat > cache_dl1_lat)
 			events |= PEV_CACHEMISS;
 		    }
@@ -2198,7 +3095,8 @@ ruu_commit(void)
 		      /* access the D-TLB */
 		      lat =
 			cache_access(dtlb, Read, (LSQ[LSQ_head].addr & ~3),
-				     NULL, 4, sim_cycle, NULL, NULL);
+				     NULL, 4, sim_cycle, NULL, NULL,
+				     /* !prefetch */0);
 		      if (lat > 1)
 			events |= PEV_TLBMISS;
 		    }
@@ -2210,6 +3108,15 @@ ruu_commit(void)
 		}
 	    }
 
+	  /* the store leaves the address index, the LSQ head moves past the
+	     entries lsq_refresh() passed */
+	  if (LSQ_IS_STORE(&LSQ[LSQ_head]))
+	    lsq_store_forget(&LSQ[LSQ_head]);
+	  else
+	    lsq_load_forget(&LSQ[LSQ_head]);
+	  if (LSQ_sta_known > 0)
+	    LSQ_sta_known--;
+
 	  /* invalidate load/store operation instance */
 	  LSQ[LSQ_head].tag++;
           sim_slip += (sim_cycle - LSQ[LSQ_head].slip);
@@ -2278,6 +3185,33 @@ ruu_commit(void)
  *  RUU_RECOVER() - squash mispredicted microarchitecture state
  */
 
+/* RUU entry RS of a non-speculative inst is squashed, after the inst
+   executed at dispatch; keep it for ruu_dispatch() to dispatch it again,
+   and take it out of the committed inst counts */
+static void
+replay_squash(struct RUU_station *rs)		/* squashed RUU entry */
+{
+  struct replay_rec *rec = &rs->replay;
+
+  if (replay_num == RUU_size)
+    panic("replay buffer overflow");
+
+  /* insts are squashed from the youngest on */
+  replay_head = (replay_head + (RUU_size-1)) % RUU_size;
+  replay_buf[replay_head] = *rec;
+  replay_num++;
+
+  sim_num_insn = rec->num - 1;
+  if (MD_OP_FLAGS(rec->op) & F_MEM)
+    {
+      sim_num_refs--;
+      if (!(MD_OP_FLAGS(rec->op) & F_STORE))
+	sim_num_loads--;
+    }
+  if (MD_OP_FLAGS(rec->op) & F_CTRL)
+    sim_num_branches--;
+}
+
 /* recover processor microarchitecture state back to point of the
    mis-predicted branch at RUU[BRANCH_INDEX] */
 static void
@@ -2320,7 +3254,17 @@ ruu_recover(int branch_index)			/* index of mis-pred branch */
 	      LSQ[LSQ_index].odep_list[i] = NULL;
 	    }
       
+	  /* the loads waiting for a squashed store are squashed as well */
+	  RSLINK_FREE_LIST(LSQ[LSQ_index].ld_wait_list);
+	  LSQ[LSQ_index].ld_wait_list = NULL;
+	  if (!LSQ_IS_STORE(&LSQ[LSQ_index]))
+	    lsq_load_forget(&LSQ[LSQ_index]);
+	  else if (STORE_ADDR_READY(&LSQ[LSQ_index]))
+	    lsq_store_forget(&LSQ[LSQ_index]);
+
 	  /* squash this LSQ entry */
+	  if (LSQ[LSQ_index].queued)
+	    readyq_remove(&LSQ[LSQ_index]);
 	  LSQ[LSQ_index].tag++;
 
 	  /* indicate in pipetrace that this instruction was squashed */
@@ -2340,7 +3284,13 @@ ruu_recover(int branch_index)			/* index of mis-pred branch */
 	  RUU[RUU_index].odep_list[i] = NULL;
 	}
       
+      /* only a memory order violation squashes non-speculative insts */
+      if (!RUU[RUU_index].spec_mode)
+	replay_squash(&RUU[RUU_index]);
+
       /* squash this RUU entry */
+      if (RUU[RUU_index].queued)
+	readyq_remove(&RUU[RUU_index]);
       RUU[RUU_index].tag++;
 
       /* indicate in pipetrace that this instruction was squashed */
@@ -2355,6 +3305,7 @@ ruu_recover(int branch_index)			/* index of mis-pred branch */
   /* reset head/tail pointers to point to the mis-predicted branch */
   RUU_tail = RUU_prev_tail;
   LSQ_tail = LSQ_prev_tail;
+  LSQ_sta_known = MIN(LSQ_sta_known, LSQ_num);
 
   /* revert create vector back to last precise create vector state, NOTE:
      this is accomplished by resetting all the copied-on-write bits in the
@@ -2371,6 +3322,87 @@ ruu_recover(int branch_index)			/* index of mis-pred branch */
 
 /* forward declarations */
 static void tracer_recover(void);
+static void fetch_squash(md_addr_t PC);
+
+/* the PC of the next inst to fetch on recovery */
+static md_addr_t recover_PC;
+
+/* load LD issued before an older store to its address, squash it and all
+   later insts and fetch again from the load; the non-speculative insts
+   squashed are dispatched again without executing them twice (see
+   replay_squash()) */
+static void
+lsq_recover(struct RUU_station *ld)		/* LSQ load */
+{
+  int i, n, RUU_index, LSQ_index;
+  struct RUU_station *rs;
+
+  /* locate the effective address computation of the load in the RUU */
+  RUU_index = RUU_tail;
+  LSQ_index = LSQ_tail;
+  do
+    {
+      RUU_index = (RUU_index + (RUU_size-1)) % RUU_size;
+      if (RUU[RUU_index].ea_comp)
+	LSQ_index = (LSQ_index + (LSQ_size-1)) % LSQ_size;
+    }
+  while (LSQ_index != ld - LSQ || !RUU[RUU_index].ea_comp);
+
+  /* the store is older than the load, so some RUU entry is as well */
+  if (RUU_index == RUU_head)
+    panic("memory order violation of the oldest inst");
+
+  /* squash all insts from the load on */
+  bpred_recover(pred, ld->PC, RUU[RUU_index].stack_recover_idx);
+  n = RUU_num;
+  ruu_recover((RUU_index + (RUU_size-1)) % RUU_size);
+  lsq_violation_squash += n - RUU_num;
+
+  /* the non-speculative create vector may point to squashed insts, it is
+     rebuilt from the remaining ones, which are all non-speculative */
+  for (i=0; i < MD_TOTAL_REGS; i++)
+    create_vector[i] = CVLINK_NULL;
+  for (n=0, RUU_index=RUU_head, LSQ_index=LSQ_head; n < RUU_num; n++)
+    {
+      rs = &RUU[RUU_index];
+      do
+	{
+	  for (i=0; i<MAX_ODEPS; i++)
+	    {
+	      if (rs->onames[i] == NA)
+		continue;
+	      if (rs->completed)
+		create_vector[rs->onames[i]] = CVLINK_NULL;
+	      else
+		{
+		  create_vector[rs->onames[i]].rs = rs;
+		  create_vector[rs->onames[i]].odep_num = i;
+		}
+	    }
+
+	  /* the load or store follows its address computation */
+	  if (rs->ea_comp)
+	    {
+	      rs = &LSQ[LSQ_index];
+	      LSQ_index = (LSQ_index + 1) % LSQ_size;
+	    }
+	  else
+	    rs = NULL;
+	}
+      while (rs);
+      RUU_index = (RUU_index + 1) % RUU_size;
+    }
+
+  /* fetch again from the load */
+  recover_PC = ld->PC;
+  if (spec_mode)
+    tracer_recover();
+  else
+    fetch_squash(recover_PC);
+
+  /* stall fetch until I-fetch and I-decode recover */
+  ruu_fetch_issue_delay = ruu_branch_penalty;
+}
 
 /* writeback completed operation results from the functional units to RUU,
    at this point, the output dependency chains of completing instructions
@@ -2381,7 +3413,7 @@ static void
 ruu_writeback(void)
 {
   int i;
-  struct RUU_station *rs;
+  struct RUU_station *rs, *ld;
 
   /* service all completed events */
   while ((rs = eventq_next_event()))
@@ -2485,17 +3517,40 @@ ruu_writeback(void)
 		      /* input is now ready */
 		      olink->rs->idep_ready[olink->x.opnum] = TRUE;
 
+		      /* a store address is now known, index it, and squash
+			 any non-speculative load that issued too early */
+		      if (olink->rs->in_LSQ
+			  && olink->x.opnum == STORE_ADDR_INDEX
+			  && LSQ_IS_STORE(olink->rs))
+			{
+			  ld = lsq_store_known(olink->rs);
+			  if (ld && !ld->spec_mode)
+			    {
+			      lsq_violations++;
+			      ss_train(olink->rs, ld);
+			      lsq_recover(ld);
+			    }
+			}
+
 		      /* are all the register operands of target ready? */
 		      if (OPERANDS_READY(olink->rs))
 			{
 			  /* yes! enqueue instruction as ready, NOTE: stores
 			     complete at dispatch, so no need to enqueue
 			     them */
-			  if (!olink->rs->in_LSQ
-			      || ((MD_OP_FLAGS(olink->rs->op)&(F_MEM|F_STORE))
-				  == (F_MEM|F_STORE)))
+			  if (!olink->rs->in_LSQ)
 			    readyq_enqueue(olink->rs);
-			  /* else, ld op, issued when no mem conflict */
+			  else if (LSQ_IS_STORE(olink->rs))
+			    {
+			      readyq_enqueue(olink->rs);
+			      /* loads waiting for its data may issue */
+			      lsq_store_ready(olink->rs);
+			    }
+			  else
+			    {
+			      /* ld op, issued when no mem conflict */
+			      lsq_check_load(olink->rs);
+			    }
 			}
 		    }
 
@@ -2522,76 +3577,32 @@ ruu_writeback(void)
  */
 
 /* this function locates ready instructions whose memory dependencies have
-   been satisfied, this is accomplished by walking the LSQ for loads, looking
-   for blocking memory dependency condition (e.g., earlier store with an
-   unknown address) */
-#define MAX_STD_UNKNOWNS		64
+   been satisfied; a load may issue once all the older stores have a known
+   address (STA known) and the youngest older store to the same address, if
+   any, has its data (STD known); rather than walking the whole LSQ every
+   cycle, the stores with a known address are kept in an index by address
+   (see lsq_store_known()), a load that finds the data of its store unknown
+   waits on that store (see lsq_store_ready()), and this function only walks
+   the LSQ entries that the oldest unknown store address held back, looking
+   at the loads it passes; each entry is passed once */
 static void
 lsq_refresh(void)
 {
-  int i, j, index, n_std_unknowns;
-  md_addr_t std_unknowns[MAX_STD_UNKNOWNS];
-
-  /* scan entire queue for ready loads: scan from oldest instruction
-     (head) until we reach the tail or an unresolved store, after which no
-     other instruction will become ready */
-  for (i=0, index=LSQ_head, n_std_unknowns=0;
-       i < LSQ_num;
-       i++, index=(index + 1) % LSQ_size)
-    {
-      /* terminate search for ready loads after first unresolved store,
-	 as no later load could be resolved in its presence */
-      if (/* store? */
-	  (MD_OP_FLAGS(LSQ[index].op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE))
-	{
-	  if (!STORE_ADDR_READY(&LSQ[index]))
-	    {
-	      /* FIXME: a later STD + STD known could hide the STA unknown */
-	      /* sta unknown, blocks all later loads, stop search */
-	      break;
-	    }
-	  else if (!OPERANDS_READY(&LSQ[index]))
-	    {
-	      /* sta known, but std unknown, may block a later store, record
-		 this address for later referral, we use an array here because
-		 for most simulations the number of entries to search will be
-		 very small */
-	      if (n_std_unknowns == MAX_STD_UNKNOWNS)
-		fatal("STD unknown array overflow, increase MAX_STD_UNKNOWNS");
-	      std_unknowns[n_std_unknowns++] = LSQ[index].addr;
-	    }
-	  else /* STORE_ADDR_READY() && OPERANDS_READY() */
-	    {
-	      /* a later STD known hides an earlier STD unknown */
-	      for (j=0; j<n_std_unknowns; j++)
-		{
-		  if (std_unknowns[j] == /* STA/STD known */LSQ[index].addr)
-		    std_unknowns[j] = /* bogus addr */0;
-		}
-	    }
-	}
+  struct RUU_station *rs;
 
-      if (/* load? */
-	  ((MD_OP_FLAGS(LSQ[index].op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD))
-	  && /* queued? */!LSQ[index].queued
-	  && /* waiting? */!LSQ[index].issued
-	  && /* completed? */!LSQ[index].completed
-	  && /* regs ready? */OPERANDS_READY(&LSQ[index]))
-	{
-	  /* no STA unknown conflict (because we got to this check), check for
-	     a STD unknown conflict */
-	  for (j=0; j<n_std_unknowns; j++)
-	    {
-	      /* found a relevant STD unknown? */
-	      if (std_unknowns[j] == LSQ[index].addr)
-		break;
-	    }
-	  if (j == n_std_unknowns)
-	    {
-	      /* no STA or STD unknown conflicts, put load on ready queue */
-	      readyq_enqueue(&LSQ[index]);
-	    }
-	}
+  /* pass the entries up to the first store with an unknown address, after
+     which no other load could be resolved */
+  while (LSQ_sta_known < LSQ_num)
+    {
+      rs = &LSQ[(LSQ_head + LSQ_sta_known) % LSQ_size];
+
+      /* FIXME: a later STD + STD known could hide the STA unknown */
+      if (LSQ_IS_STORE(rs) && !STORE_ADDR_READY(rs))
+	break;
+
+      LSQ_sta_known++;
+      if (LSQ_IS_LOAD(rs))
+	lsq_check_load(rs);
     }
 }
 
@@ -2610,239 +3621,179 @@ lsq_refresh(void)
 static void
 ruu_issue(void)
 {
-  int i, load_lat, tlb_lat, n_issued;
-  struct RS_link *node, *next_node;
+  int load_lat, tlb_lat, n_issued;
+  struct readyq_sel sel;
+  struct RUU_station *rs;
   struct res_template *fu;
 
-  /* FIXME: could be a little more efficient when scanning the ready queue */
-
-  /* copy and then blow away the ready list, NOTE: the ready list is
-     always totally reclaimed each cycle, and instructions that are not
-     issue are explicitly reinserted into the ready instruction queue,
-     this management strategy ensures that the ready instruction queue
-     is always properly sorted */
-  node = ready_queue;
-  ready_queue = NULL;
-
-  /* visit all ready instructions (i.e., insts whose register input
-     dependencies have been satisfied, stop issue when no more instructions
-     are available or issue bandwidth is exhausted */
+  /* visit the ready instructions (i.e., insts whose register input
+     dependencies have been satisfied) in priority order, stop issue when no
+     more instructions are available or issue bandwidth is exhausted; the
+     instructions that do not issue stay in the ready queue */
+  readyq_sel_init(&sel);
   for (n_issued=0;
-       node && n_issued < ruu_issue_width;
-       node = next_node)
+       n_issued < ruu_issue_width && (rs = readyq_select(&sel)) != NULL;
+       )
     {
-      next_node = node->next;
+      /* issue operation, both reg and mem deps have been satisfied */
+      if (!OPERANDS_READY(rs) || !rs->queued
+	  || rs->issued || rs->completed)
+	panic("issued inst !ready, issued, or completed");
 
-      /* still valid? */
-      if (RSLINK_VALID(node))
-	{
-	  struct RUU_station *rs = RSLINK_RS(node);
-
-	  /* issue operation, both reg and mem deps have been satisfied */
-	  if (!OPERANDS_READY(rs) || !rs->queued
-	      || rs->issued || rs->completed)
-	    panic("issued inst !ready, issued, or completed");
+      /* node is now un-queued */
+      readyq_remove(rs);
 
-	  /* node is now un-queued */
-	  rs->queued = FALSE;
-
-	  if (rs->in_LSQ
-	      && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE)))
+      if (rs->in_LSQ
+	  && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE)))
+	{
+	  /* stores complete in effectively zero time, result is
+	     written into the load/store queue, the actual store into
+	     the memory system occurs when the instruction is retired
+	     (see ruu_commit()) */
+	  rs->issued = TRUE;
+	  rs->completed = TRUE;
+	  if (rs->onames[0] || rs->onames[1])
+	    panic("store creates result");
+
+	  if (rs->recover_inst)
+	    panic("mis-predicted store");
+
+	  /* entered execute stage, indicate in pipe trace */
+	  ptrace_newstage(rs->ptrace_seq, PST_WRITEBACK, 0);
+
+	  /* one more inst issued */
+	  n_issued++;
+	}
+      else
+	{
+	  /* issue the instruction to a functional unit */
+	  if (MD_OP_FUCLASS(rs->op) != NA)
 	    {
-	      /* stores complete in effectively zero time, result is
-		 written into the load/store queue, the actual store into
-		 the memory system occurs when the instruction is retired
-		 (see ruu_commit()) */
-	      rs->issued = TRUE;
-	      rs->completed = TRUE;
-	      if (rs->onames[0] || rs->onames[1])
-		panic("store creates result");
-
-	      if (rs->recover_inst)
-		panic("mis-predicted store");
+	      fu = res_get(fu_pool, MD_OP_FUCLASS(rs->op));
+	      if (fu)
+		{
+		  /* got one! issue inst to functional unit */
+		  rs->issued = TRUE;
+		  /* reserve the functional unit */
+		  if (fu->master->busy)
+		    panic("functional unit already in use");
 
-	      /* entered execute stage, indicate in pipe trace */
-	      ptrace_newstage(rs->ptrace_seq, PST_WRITEBACK, 0);
+		  /* schedule functional unit release event */
+		  fu->master->busy = fu->issuelat;
 
-	      /* one more inst issued */
-	      n_issued++;
-	    }
-	  else
-	    {
-	      /* issue the instruction to a functional unit */
-	      if (MD_OP_FUCLASS(rs->op) != NA)
-		{
-		  fu = res_get(fu_pool, MD_OP_FUCLASS(rs->op));
-		  if (fu)
+		  /* schedule a result writeback event */
+		  if (rs->in_LSQ
+		      && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_LOAD))
+			  == (F_MEM|F_LOAD)))
 		    {
-		      /* got one! issue inst to functional unit */
-		      rs->issued = TRUE;
-		      /* reserve the functional unit */
-		      if (fu->master->busy)
-			panic("functional unit already in use");
-
-		      /* schedule functional unit release event */
-		      fu->master->busy = fu->issuelat;
-
-		      /* schedule a result writeback event */
-		      if (rs->in_LSQ
-			  && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_LOAD))
-			      == (F_MEM|F_LOAD)))
+		      int events = 0;
+
+		      /* for loads, determine cache access latency:
+			 first scan LSQ to see if a store forward is
+			 possible, if not, access the data cache */
+		      load_lat = 0;
+		      lsq_load_issued(rs);
+
+		      /* look the load address up in the index of the older
+			 stores, all of them have known addresses by now
+			 unless loads speculate past unknown ones */
+		      /* FIXME: not dealing with partials! */
+		      if (lsq_last_store(rs))
 			{
-			  int events = 0;
-
-			  /* for loads, determine cache access latency:
-			     first scan LSQ to see if a store forward is
-			     possible, if not, access the data cache */
-			  load_lat = 0;
-			  i = (rs - LSQ);
-			  if (i != LSQ_head)
-			    {
-			      for (;;)
-				{
-				  /* go to next earlier LSQ entry */
-				  i = (i + (LSQ_size-1)) % LSQ_size;
-
-				  /* FIXME: not dealing with partials! */
-				  if ((MD_OP_FLAGS(LSQ[i].op) & F_STORE)
-				      && (LSQ[i].addr == rs->addr))
-				    {
-				      /* hit in the LSQ */
-				      load_lat = 1;
-				      break;
-				    }
-
-				  /* scan finished? */
-				  if (i == LSQ_head)
-				    break;
-				}
-			    }
+			  /* hit in the LSQ */
+			  load_lat = 1;
+			}
+
+		      /* was the value store forwared from the LSQ? */
+		      if (!load_lat)
+			{
+			  int valid_addr = MD_VALID_ADDR(rs->addr);
+
+			  if (!spec_mode && !valid_addr)
+			    sim_invalid_addrs++;
 
-			  /* was the value store forwared from the LSQ? */
-			  if (!load_lat)
+			  /* no! go to the data cache if addr is valid */
+			  if (cache_dl1 && valid_addr)
 			    {
-			      int valid_addr = MD_VALID_ADDR(rs->addr);
-
-			      if (!spec_mode && !valid_addr)
-				sim_invalid_addrs++;
-
-			      /* no! go to the data cache if addr is valid */
-			      if (cache_dl1 && valid_addr)
-				{
-				  /* access the cache if non-faulting */
-				  load_lat =
-				    cache_access(cache_dl1, Read,
-						 (rs->addr & ~3), NULL, 4,
-						 sim_cycle, NULL, NULL);
-				  if (load_lat > cache_dl1_lat)
-				    events |= PEV_CACHEMISS;
-				}
-			      else
-				{
-				  /* no caches defined, just use op latency */
-				  load_lat = fu->oplat;
-				}
+			      /* access the cache if non-faulting */
+			      load_lat =
+				cache_access(cache_dl1, Read,
+					     (rs->addr & ~3), NULL, 4,
+					     sim_cycle, NULL, NULL, /* !prefetch */0);
+			      if (load_lat > cache_dl1_lat)
+				events |= PEV_CACHEMISS;
 			    }
-
-			  /* all loads and stores must to access D-TLB */
-			  if (dtlb && MD_VALID_ADDR(rs->addr))
+			  else
 			    {
-			      /* access the D-DLB, NOTE: this code will
-				 initiate speculative TLB misses */
-			      tlb_lat =
-				cache_access(dtlb, Read, (rs->addr & ~3),
-					     NULL, 4, sim_cycle, NULL, NULL);
-			      if (tlb_lat > 1)
-				events |= PEV_TLBMISS;
-
-			      /* D-cache/D-TLB accesses occur in parallel */
-			      load_lat = MAX(tlb_lat, load_lat);
+			      /* no caches defined, just use op latency */
+			      load_lat = fu->oplat;
 			    }
-
-			  /* use computed cache access latency */
-			  eventq_queue_event(rs, sim_cycle + load_lat);
-
-			  /* entered execute stage, indicate in pipe trace */
-			  ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
-					  ((rs->ea_comp ? PEV_AGEN : 0)
-					   | events));
 			}
-		      else /* !load && !store */
-			{
-			  /* use deterministic functional unit latency */
-			  eventq_queue_event(rs, sim_cycle + fu->oplat);
 
-			  /* entered execute stage, indicate in pipe trace */
-			  ptrace_newstage(rs->ptrace_seq, PST_EXECUTE, 
-					  rs->ea_comp ? PEV_AGEN : 0);
+		      /* all loads and stores must to access D-TLB */
+		      if (dtlb && MD_VALID_ADDR(rs->addr))
+			{
+			  /* access the D-DLB, NOTE: this code will
+			     initiate speculative TLB misses */
+			  tlb_lat =
+			    cache_access(dtlb, Read, (rs->addr & ~3),
+					 NULL, 4, sim_cycle, NULL, NULL,
+				 /* !prefetch */0);
+			  if (tlb_lat > 1)
+			    events |= PEV_TLBMISS;
+
+			  /* D-cache/D-TLB accesses occur in parallel */
+			  load_lat = MAX(tlb_lat, load_lat);
 			}
 
-		      /* one more inst issued */
-		      n_issued++;
+		      /* use computed cache access latency */
+		      eventq_queue_event(rs, sim_cycle + load_lat);
+
+		      /* entered execute stage, indicate in pipe trace */
+		      ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
+				      ((rs->ea_comp ? PEV_AGEN : 0)
+				       | events));
 		    }
-		  else /* no functional unit */
+		  else /* !load && !store */
 		    {
-		      /* insufficient functional unit resources, put operation
-			 back onto the ready list, we'll try to issue it
-			 again next cycle */
-		      readyq_enqueue(rs);
-		    }
-		}
-	      else /* does not require a functional unit! */
-		{
-		  /* FIXME: need better solution for these */
-		  /* the instruction does not need a functional unit */
-		  rs->issued = TRUE;
+		      /* use deterministic functional unit latency */
+		      eventq_queue_event(rs, sim_cycle + fu->oplat);
 
-		  /* schedule a result event */
-		  eventq_queue_event(rs, sim_cycle + 1);
-
-		  /* entered execute stage, indicate in pipe trace */
-		  ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
-				  rs->ea_comp ? PEV_AGEN : 0);
+		      /* entered execute stage, indicate in pipe trace */
+		      ptrace_newstage(rs->ptrace_seq, PST_EXECUTE, 
+				      rs->ea_comp ? PEV_AGEN : 0);
+		    }
 
 		  /* one more inst issued */
 		  n_issued++;
 		}
-	    } /* !store */
-
-	}
-      /* else, RUU entry was squashed */
+	      else /* no functional unit */
+		{
+		  /* insufficient functional unit resources, put operation
+		     back onto the ready list, we'll try to issue it
+		     again next cycle */
+		  readyq_enqueue(rs);
+		}
+	    }
+	  else /* does not require a functional unit! */
+	    {
+	      /* FIXME: need better solution for these */
+	      /* the instruction does not need a functional unit */
+	      rs->issued = TRUE;
 
-      /* reclaim ready list entry, NOTE: this is done whether or not the
-         instruction issued, since the instruction was once again reinserted
-         into the ready queue if it did not issue, this ensures that the ready
-         queue is always properly sorted */
-      RSLINK_FREE(node);
-    }
+	      /* schedule a result event */
+	      eventq_queue_event(rs, sim_cycle + 1);
 
-  /* put any instruction not issued back into the ready queue, go through
-     normal channels to ensure instruction stay ordered correctly */
-  for (; node; node = next_node)
-    {
-      next_node = node->next;
+	      /* entered execute stage, indicate in pipe trace */
+	      ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
+			      rs->ea_comp ? PEV_AGEN : 0);
 
-      /* still valid? */
-      if (RSLINK_VALID(node))
-        {
-	  struct RUU_station *rs = RSLINK_RS(node);
-
-          /* node is now un-queued */
-          rs->queued = FALSE;
-
-	  /* not issued, put operation back onto the ready list, we'll try to
-	     issue it again next cycle */
-          readyq_enqueue(rs);
-        }
-      /* else, RUU entry was squashed */
-
-      /* reclaim ready list entry, NOTE: this is done whether or not the
-         instruction issued, since the instruction was once again reinserted
-         into the ready queue if it did not issue, this ensures that the ready
-         queue is always properly sorted */
-      RSLINK_FREE(node);
-    }
-}
+	      /* one more inst issued */
+	      n_issued++;
+	    }
+	} /* !store */
+    }
+}
 
 
 /*
@@ -2910,28 +3861,34 @@ rspec_dump(FILE *stream)			/* output stream */
 }
 
 
-/* speculative memory hash table size, NOTE: this must be a power-of-two */
-#define STORE_HASH_SIZE		32
+/* speculative memory blocks are this many bytes, aligned, the largest
+   access size, so an aligned access never spans two blocks */
+#define SPEC_MEM_BLK		8
 
-/* speculative memory hash table definition, accesses go through this hash
-   table when accessing memory in speculative mode, the hash table flush the
-   table when recovering from mispredicted branches */
+/* speculative memory table definition, accesses go through this table when
+   accessing memory in speculative mode; it is an open addressing table of
+   the blocks written, an entry is live only if it carries the current epoch,
+   so recovering from mispredicted branches clears it by moving to the next
+   epoch */
 struct spec_mem_ent {
-  struct spec_mem_ent *next;		/* ptr to next hash table bucket */
-  md_addr_t addr;			/* virtual address of spec state */
-  unsigned int data[2];			/* spec buffer, up to 8 bytes */
+  md_addr_t addr;			/* block address of spec state */
+  unsigned int epoch;			/* epoch written, 0 if never */
+  unsigned int mask;			/* bytes of the block written */
+  byte_t data[SPEC_MEM_BLK];		/* spec buffer, one block */
 };
 
-/* speculative memory hash table */
-static struct spec_mem_ent *store_htable[STORE_HASH_SIZE];
+/* speculative memory table, spec_mem_size entries, a power of two, at most
+   half of them live */
+static struct spec_mem_ent *spec_mem_table;
+static int spec_mem_size;
+static int spec_mem_used;
 
-/* speculative memory hash table bucket free list */
-static struct spec_mem_ent *bucket_free_list = NULL;
+/* epoch of the live entries of the speculative memory table */
+static unsigned int spec_mem_epoch;
 
 
 /* program counter */
 static md_addr_t pred_PC;
-static md_addr_t recover_PC;
 
 /* fetch unit next fetch address */
 static md_addr_t fetch_regs_PC;
@@ -2952,12 +3909,11 @@ static int fetch_tail, fetch_head;	/* head and tail pointers of queue */
 /* recover instruction trace generator state to precise state state immediately
    before the first mis-predicted branch; this is accomplished by resetting
    all register value copied-on-write bitmasks are reset, and the speculative
-   memory hash table is cleared */
+   memory table is cleared */
 static void
 tracer_recover(void)
 {
   int i;
-  struct spec_mem_ent *ent, *ent_next;
 
   /* better be in mis-speculative trace generation mode */
   if (!spec_mode)
@@ -2971,20 +3927,25 @@ tracer_recover(void)
   BITMAP_CLEAR_MAP(use_spec_F, F_BMAP_SZ);
   BITMAP_CLEAR_MAP(use_spec_C, C_BMAP_SZ);
 
-  /* reset memory state back to non-speculative state */
-  /* FIXME: could version stamps be used here?!?!? */
-  for (i=0; i<STORE_HASH_SIZE; i++)
+  /* reset memory state back to non-speculative state, entries of older
+     epochs are free, the epochs start over once they wrap */
+  spec_mem_used = 0;
+  if (++spec_mem_epoch == 0)
     {
-      /* release all hash table buckets */
-      for (ent=store_htable[i]; ent; ent=ent_next)
-	{
-	  ent_next = ent->next;
-	  ent->next = bucket_free_list;
-	  bucket_free_list = ent;
-	}
-      store_htable[i] = NULL;
+      for (i=0; i < spec_mem_size; i++)
+	spec_mem_table[i].epoch = 0;
+      spec_mem_epoch = 1;
     }
 
+  /* reset IFETCH state */
+  fetch_squash(recover_PC);
+}
+
+/* squash the instructions in the IFETCH -> DISPATCH queue and fetch next
+   from PC */
+static void
+fetch_squash(md_addr_t PC)			/* next PC to fetch */
+{
   /* if pipetracing, indicate squash of instructions in the inst fetch queue */
   if (ptrace_active)
     {
@@ -3002,15 +3963,13 @@ tracer_recover(void)
   /* reset IFETCH state */
   fetch_num = 0;
   fetch_tail = fetch_head = 0;
-  fetch_pred_PC = fetch_regs_PC = recover_PC;
+  fetch_pred_PC = fetch_regs_PC = PC;
 }
 
 /* initialize the speculative instruction state generator state */
 static void
 tracer_init(void)
 {
-  int i;
-
   /* initially in non-speculative mode */
   spec_mode = FALSE;
 
@@ -3019,25 +3978,69 @@ tracer_init(void)
   BITMAP_CLEAR_MAP(use_spec_F, F_BMAP_SZ);
   BITMAP_CLEAR_MAP(use_spec_C, C_BMAP_SZ);
 
-  /* memory state is from non-speculative memory pages */
-  for (i=0; i<STORE_HASH_SIZE; i++)
-    store_htable[i] = NULL;
+  /* memory state is from non-speculative memory pages; a mis-speculated
+     path writes to at most as many blocks as the LSQ holds stores, the table
+     grows if DLite writes more */
+  for (spec_mem_size = 16; spec_mem_size < 2*LSQ_size; spec_mem_size <<= 1)
+    /* nada */;
+  spec_mem_table = calloc(spec_mem_size, sizeof(struct spec_mem_ent));
+  if (!spec_mem_table)
+    fatal("out of virtual memory");
+  spec_mem_used = 0;
+  spec_mem_epoch = 1;
+}
+
+
+/* speculative memory table index of block address ADDR */
+#define SPEC_MEM_HASH(ADDR)						\
+  ((((ADDR) / SPEC_MEM_BLK) * 2654435761u) & (spec_mem_size - 1))
+
+/* returns the entry of block address ADDR in the speculative memory table,
+   or the free entry it goes to */
+static struct spec_mem_ent *
+spec_mem_find(md_addr_t addr)			/* block address */
+{
+  int i = SPEC_MEM_HASH(addr);
+
+  while (spec_mem_table[i].epoch == spec_mem_epoch
+	 && spec_mem_table[i].addr != addr)
+    i = (i + 1) & (spec_mem_size - 1);
+  return &spec_mem_table[i];
 }
 
+/* double the size of the speculative memory table, keeping its live
+   entries */
+static void
+spec_mem_grow(void)
+{
+  struct spec_mem_ent *old_table = spec_mem_table, *ent;
+  int i, old_size = spec_mem_size;
 
-/* speculative memory hash table address hash function */
-#define HASH_ADDR(ADDR)							\
-  ((((ADDR) >> 24)^((ADDR) >> 16)^((ADDR) >> 8)^(ADDR)) & (STORE_HASH_SIZE-1))
+  spec_mem_size = 2 * old_size;
+  spec_mem_table = calloc(spec_mem_size, sizeof(struct spec_mem_ent));
+  if (!spec_mem_table)
+    fatal("out of virtual memory");
+  for (i=0; i < old_size; i++)
+    {
+      if (old_table[i].epoch == spec_mem_epoch)
+	{
+	  ent = spec_mem_find(old_table[i].addr);
+	  *ent = old_table[i];
+	}
+    }
+  free(old_table);
+}
 
 /* this functional provides a layer of mis-speculated state over the
    non-speculative memory state, when in mis-speculation trace generation mode,
    the simulator will call this function to access memory, instead of the
    non-speculative memory access interfaces defined in memory.h; when storage
-   is written, an entry is allocated in the speculative memory hash table,
-   future reads and writes while in mis-speculative trace generation mode will
-   access this buffer instead of non-speculative memory state; when the trace
-   generator transitions back to non-speculative trace generation mode,
-   tracer_recover() clears this table, returns any access fault */
+   is written, the bytes written are kept in the speculative memory table,
+   future reads while in mis-speculative trace generation mode will take the
+   bytes written from this table and the others from non-speculative memory
+   state; when the trace generator transitions back to non-speculative trace
+   generation mode, tracer_recover() clears this table, returns any access
+   fault */
 static enum md_fault_type
 spec_mem_access(struct mem_t *mem,		/* memory space to access */
 		enum mem_cmd cmd,		/* Read or Write access cmd */
@@ -3045,11 +4048,9 @@ spec_mem_access(struct mem_t *mem,		/* memory space to access */
 		void *p,			/* input/output buffer */
 		int nbytes)			/* number of bytes to access */
 {
-  int i, index;
-  struct spec_mem_ent *ent, *prev;
-
-  /* FIXME: partially overlapping writes are not combined... */
-  /* FIXME: partially overlapping reads are not handled correctly... */
+  int i, off;
+  unsigned int need;
+  struct spec_mem_ent *ent;
 
   /* check alignments, even speculative this test should always pass */
   if ((nbytes & (nbytes-1)) != 0 || (addr & (nbytes-1)) != 0)
@@ -3073,141 +4074,90 @@ spec_mem_access(struct mem_t *mem,		/* memory space to access */
       return md_fault_none;
     }
 
-  /* has this memory state been copied on mis-speculative write? */
-  index = HASH_ADDR(addr);
-  for (prev=NULL,ent=store_htable[index]; ent; prev=ent,ent=ent->next)
+  if (nbytes > SPEC_MEM_BLK)
+    panic("access size not supported in mis-speculative mode");
+
+  /* has this memory block been written to on the mis-speculated path? */
+  ent = spec_mem_find(addr & ~(md_addr_t)(SPEC_MEM_BLK-1));
+  off = addr & (SPEC_MEM_BLK-1);
+
+  if (cmd == Write)
     {
-      if (ent->addr == addr)
+      /* mis-speculated writes are lost in bug compatible mode */
+      if (bugcompat_mode)
+	return md_fault_none;
+
+      /* no, allocate an entry to hold the data */
+      if (ent->epoch != spec_mem_epoch)
 	{
-	  /* reorder chains to speed access into hash table */
-	  if (prev != NULL)
+	  if (2*(spec_mem_used+1) > spec_mem_size)
 	    {
-	      /* not at head of list, relink the hash table entry at front */
-	      prev->next = ent->next;
-              ent->next = store_htable[index];
-              store_htable[index] = ent;
+	      spec_mem_grow();
+	      ent = spec_mem_find(addr & ~(md_addr_t)(SPEC_MEM_BLK-1));
 	    }
-	  break;
+	  ent->addr = addr & ~(md_addr_t)(SPEC_MEM_BLK-1);
+	  ent->epoch = spec_mem_epoch;
+	  ent->mask = 0;
+	  spec_mem_used++;
 	}
-    }
 
-  /* no, if it is a write, allocate a hash table entry to hold the data */
-  if (!ent && cmd == Write)
-    {
-      /* try to get an entry from the free list, if available */
-      if (!bucket_free_list)
+      /* always write into mis-speculated state buffer, partially
+	 overlapping writes are merged in the block */
+      for (i=0; i < nbytes; i++)
 	{
-	  /* otherwise, call calloc() to get the needed storage */
-	  bucket_free_list = calloc(1, sizeof(struct spec_mem_ent));
-	  if (!bucket_free_list)
-	    fatal("out of virtual memory");
+	  ent->data[off+i] = ((byte_t *)p)[i];
+	  ent->mask |= 1 << (off+i);
 	}
-      ent = bucket_free_list;
-      bucket_free_list = bucket_free_list->next;
+      return md_fault_none;
+    }
 
-      if (!bugcompat_mode)
-	{
-	  /* insert into hash table */
-	  ent->next = store_htable[index];
-	  store_htable[index] = ent;
-	  ent->addr = addr;
-	  ent->data[0] = 0; ent->data[1] = 0;
-	}
+  /* read entirely from the mis-speculated state buffer if it has all the
+     bytes */
+  need = ((1 << nbytes) - 1) << off;
+  if (ent->epoch == spec_mem_epoch && (ent->mask & need) == need)
+    {
+      for (i=0; i < nbytes; i++)
+	((byte_t *)p)[i] = ent->data[off+i];
+      return md_fault_none;
     }
 
-  /* handle the read or write to speculative or non-speculative storage */
-  switch (nbytes)
+  if (func_thread)
     {
-    case 1:
-      if (cmd == Read)
-	{
-	  if (ent)
-	    {
-	      /* read from mis-speculated state buffer */
-	      *((byte_t *)p) = *((byte_t *)(&ent->data[0]));
-	    }
-	  else
-	    {
-	      /* read from non-speculative memory state, don't allocate
-	         memory pages with speculative loads */
-	      *((byte_t *)p) = MEM_READ_BYTE(mem, addr);
-	    }
-	}
-      else
-	{
-	  /* always write into mis-speculated state buffer */
-	  *((byte_t *)(&ent->data[0])) = *((byte_t *)p);
-	}
-      break;
-    case 2:
-      if (cmd == Read)
-	{
-	  if (ent)
-	    {
-	      /* read from mis-speculated state buffer */
-	      *((half_t *)p) = *((half_t *)(&ent->data[0]));
-	    }
-	  else
-	    {
-	      /* read from non-speculative memory state, don't allocate
-	         memory pages with speculative loads */
-	      *((half_t *)p) = MEM_READ_HALF(mem, addr);
-	    }
-	}
-      else
-	{
-	  /* always write into mis-speculated state buffer */
-	  *((half_t *)&ent->data[0]) = *((half_t *)p);
-	}
-      break;
-    case 4:
-      if (cmd == Read)
-	{
-	  if (ent)
-	    {
-	      /* read from mis-speculated state buffer */
-	      *((word_t *)p) = *((word_t *)&ent->data[0]);
-	    }
-	  else
-	    {
-	      /* read from non-speculative memory state, don't allocate
-	         memory pages with speculative loads */
-	      *((word_t *)p) = MEM_READ_WORD(mem, addr);
-	    }
-	}
-      else
-	{
-	  /* always write into mis-speculated state buffer */
-	  *((word_t *)&ent->data[0]) = *((word_t *)p);
-	}
-      break;
-    case 8:
-      if (cmd == Read)
-	{
-	  if (ent)
-	    {
-	      /* read from mis-speculated state buffer */
-	      *((word_t *)p) = *((word_t *)&ent->data[0]);
-	      *(((word_t *)p)+1) = *((word_t *)&ent->data[1]);
-	    }
-	  else
-	    {
-	      /* read from non-speculative memory state, don't allocate
-	         memory pages with speculative loads */
-	      *((word_t *)p) = MEM_READ_WORD(mem, addr);
-	      *(((word_t *)p)+1) =
-		MEM_READ_WORD(mem, addr + sizeof(word_t));
-	    }
-	}
-      else
+      /* the functional thread owns memory, the bytes not written on the
+	 mis-speculated path read as zero */
+      for (i=0; i < nbytes; i++)
+	((byte_t *)p)[i] = 0;
+    }
+  else
+    {
+      /* else, read from non-speculative memory state, don't allocate
+	 memory pages with speculative loads */
+      switch (nbytes)
 	{
-	  /* always write into mis-speculated state buffer */
-	  *((word_t *)&ent->data[0]) = *((word_t *)p);
-	  *((word_t *)&ent->data[1]) = *(((word_t *)p)+1);
+	case 1:
+	  *((byte_t *)p) = MEM_READ_BYTE(mem, addr);
+	  break;
+	case 2:
+	  *((half_t *)p) = MEM_READ_HALF(mem, addr);
+	  break;
+	case 4:
+	  *((word_t *)p) = MEM_READ_WORD(mem, addr);
+	  break;
+	case 8:
+	  *((word_t *)p) = MEM_READ_WORD(mem, addr);
+	  *(((word_t *)p)+1) = MEM_READ_WORD(mem, addr + sizeof(word_t));
+	  break;
+	default:
+	  panic("access size not supported in mis-speculative mode");
 	}
-      break;
-    default:
-      panic("access size not supported in mis-speculative mode");
+    }
+
+  /* then take any bytes written from the mis-speculated state buffer */
+  if (ent->epoch == spec_mem_epoch)
+    {
+      for (i=0; i < nbytes; i++)
+	if (ent->mask & (1 << (off+i)))
+	  ((byte_t *)p)[i] = ent->data[off+i];
     }
 
   return md_fault_none;
@@ -3217,7 +4167,7 @@ spec_mem_access(struct mem_t *mem,		/* memory space to access */
 static void
 mspec_dump(FILE *stream)			/* output stream */
 {
-  int i;
+  int i, j;
   struct spec_mem_ent *ent;
 
   if (!stream)
@@ -3227,16 +4177,22 @@ mspec_dump(FILE *stream)			/* output stream */
 
   fprintf(stream, "spec_mode: %s\n", spec_mode ? "t" : "f");
 
-  for (i=0; i<STORE_HASH_SIZE; i++)
+  for (i=0; i < spec_mem_size; i++)
     {
-      /* dump contents of all hash table buckets */
-      for (ent=store_htable[i]; ent; ent=ent->next)
+      /* dump contents of all live blocks, bytes not written as -- */
+      ent = &spec_mem_table[i];
+      if (ent->epoch != spec_mem_epoch)
+	continue;
+
+      myfprintf(stream, "[0x%08p]:", ent->addr);
+      for (j=0; j < SPEC_MEM_BLK; j++)
 	{
-	  myfprintf(stream, "[0x%08p]: %12.0f/0x%08x:%08x\n",
-		    ent->addr, (double)(*((double *)ent->data)),
-		    *((unsigned int *)&ent->data[0]),
-		    *(((unsigned int *)&ent->data[0]) + 1));
+	  if (ent->mask & (1 << j))
+	    fprintf(stream, " %02x", ent->data[j]);
+	  else
+	    fprintf(stream, " --");
 	}
+      fprintf(stream, "\n");
     }
 }
 
@@ -3274,6 +4230,159 @@ simoo_mem_obj(struct mem_t *mem,		/* memory space to access */
 }
 
 
+/*
+ *  the functional thread, with -func:thread the program executes on a
+ *  thread of its own ahead of the timing model, which dispatches the correct
+ *  path insts from the records the thread leaves in a ring; the functional
+ *  thread owns the architected register and memory state, the timing thread
+ *  fetches from a copy of the program text and executes the wrong path on
+ *  the registers recorded at the mis-predicted branch (see spec_mem_access()
+ *  for memory); the functional thread stops before each trap, and once it
+ *  executed max_insts insts, the timing thread then executes the next insts
+ *  itself, in program order, so system calls happen in the same order and
+ *  the same number as without the thread
+ */
+
+/* an inst executed by the functional thread */
+struct func_rec {
+  md_addr_t PC, NPC;			/* inst address, next PC */
+  md_addr_t target_PC;			/* branch target address */
+  md_addr_t addr;			/* effective address of load/store */
+  enum md_fault_type fault;		/* fault of the inst */
+  struct regs_t regs;			/* registers after a control inst */
+};
+
+/* load and store of the variables the threads share */
+#define FUNC_LOAD(X)		__atomic_load_n(&(X), __ATOMIC_ACQUIRE)
+#define FUNC_STORE(X, V)	__atomic_store_n(&(X), (V), __ATOMIC_RELEASE)
+
+/* single producer single consumer ring of the insts executed, the
+   functional thread writes at func_ring_tail, the timing thread reads at
+   func_ring_head, both count up and wrap at func_ring_size */
+static struct func_rec *func_ring;
+static unsigned int func_ring_head;
+static unsigned int func_ring_tail;
+
+/* set by the functional thread when it stops, before a trap or once it is
+   done, and cleared by the timing thread to resume it after a trap */
+static int func_parked;
+
+/* set by the functional thread once it executed max_insts insts */
+static int func_done;
+
+/* architected register state of the functional thread, and the number of
+   insts it executed */
+static struct regs_t func_regs;
+static counter_t func_num_insn;
+
+/* copy of the program text the timing thread fetches from */
+static md_inst_t *func_text;
+
+/* functional thread main, see the end of this file */
+static void *func_main(void *arg);
+
+/* copy the program text and start the functional thread from the current
+   architected state */
+static void
+func_start(void)
+{
+  md_inst_t inst;
+  pthread_t tid;
+  int i;
+
+  func_text = calloc(ld_text_size / sizeof(md_inst_t), sizeof(md_inst_t));
+  func_ring = calloc(func_ring_size, sizeof(struct func_rec));
+  if (!func_text || !func_ring)
+    fatal("out of virtual memory");
+  for (i=0; i < ld_text_size / sizeof(md_inst_t); i++)
+    {
+      MD_FETCH_INST(inst, mem, ld_text_base + i * sizeof(md_inst_t));
+      func_text[i] = inst;
+    }
+
+  func_regs = regs;
+  func_num_insn = sim_num_insn;
+  func_ring_head = func_ring_tail = 0;
+  func_parked = func_done = FALSE;
+
+  if (pthread_create(&tid, NULL, func_main, NULL) != 0
+      || pthread_detach(tid) != 0)
+    fatal("cannot start the functional thread");
+}
+
+/* returns the record of the next inst the functional thread executed, or
+   NULL if it stopped before it, waiting for it as needed */
+static struct func_rec *
+func_next(void)
+{
+  int parked;
+
+  for (;;)
+    {
+      /* records written before the thread stopped are seen */
+      parked = FUNC_LOAD(func_parked);
+      if (FUNC_LOAD(func_ring_tail) != func_ring_head)
+	return &func_ring[func_ring_head & (func_ring_size - 1)];
+      if (parked)
+	return NULL;
+      sched_yield();
+    }
+}
+
+/* release the record func_next() returned */
+static void
+func_release(void)
+{
+  FUNC_STORE(func_ring_head, func_ring_head + 1);
+}
+
+/* copy the registers of FROM to TO, but for the PC and NPC */
+static void
+func_copy_regs(struct regs_t *to,		/* registers to write */
+	       struct regs_t *from)		/* registers to read */
+{
+  md_addr_t PC = to->regs_PC, NPC = to->regs_NPC;
+
+  *to = *from;
+  to->regs_PC = PC;
+  to->regs_NPC = NPC;
+}
+
+/* the timing thread executed in XREGS the inst the functional thread
+   stopped before, hand the state back and resume the thread if it is not
+   done */
+static void
+func_sync_done(struct regs_t *xregs)		/* registers after the inst */
+{
+  func_regs = *xregs;
+  func_regs.regs_PC = xregs->regs_NPC;
+  func_regs.regs_NPC = xregs->regs_NPC + sizeof(md_inst_t);
+  func_num_insn++;
+  func_sync_insn++;
+
+  if (!FUNC_LOAD(func_done))
+    FUNC_STORE(func_parked, FALSE);
+}
+
+
+/*
+ * sampled simulation state, see sample_step()
+ */
+
+/* phases of the detailed part of a sample */
+enum sample_phase_t {
+  sp_warmup,			/* detailed warm-up */
+  sp_measure,			/* measured window */
+  sp_drain			/* nothing dispatched until the pipeline
+				   drains */
+};
+static enum sample_phase_t sample_phase = sp_warmup;
+
+/* correct next PC after the last non-speculative inst dispatched,
+   functional simulation resumes there once the pipeline drained */
+static md_addr_t sample_next_PC;
+
+
 /*
  *  RUU_DISPATCH() - decode instructions and allocate RUU and LSQ resources
  */
@@ -3716,6 +4825,8 @@ ruu_dispatch(void)
   int made_check;			/* used to ensure DLite entry */
   int br_taken, br_pred_taken;		/* if br, taken?  predicted taken? */
   int fetch_redirected = FALSE;
+  int replay;				/* dispatched again, not executed? */
+  struct func_rec *frec;		/* record of the functional thread */
   byte_t temp_byte = 0;			/* temp variable for spec mem access */
   half_t temp_half = 0;			/* " ditto " */
   word_t temp_word = 0;			/* " ditto " */
@@ -3733,7 +4844,9 @@ ruu_dispatch(void)
 	 /* insts still available from fetch unit? */
 	 && fetch_num != 0
 	 /* on an acceptable trace path */
-	 && (ruu_include_spec || !spec_mode))
+	 && (ruu_include_spec || !spec_mode)
+	 /* not draining for sampling, but to dispatch squashed insts again */
+	 && (sample_phase != sp_drain || replay_num != 0))
     {
       /* if issuing in-order, block until last op issues if inorder issue */
       if (ruu_inorder_issue
@@ -3788,6 +4901,23 @@ ruu_dispatch(void)
       /* set default fault - none */
       fault = md_fault_none;
 
+      /* a non-speculative inst squashed by a memory order violation has
+	 executed already, it is only decoded again */
+      replay = (!spec_mode && replay_num != 0
+		&& replay_buf[replay_head].PC == regs.regs_PC);
+
+      /* a functional thread executed the inst already, unless it stopped
+	 before it, then the inst executes here on the thread's state */
+      frec = NULL;
+      if (func_thread && !spec_mode && !replay)
+	{
+	  frec = func_next();
+	  if ((frec ? frec->PC : func_regs.regs_PC) != regs.regs_PC)
+	    panic("functional thread out of sync with dispatch");
+	  if (!frec)
+	    func_copy_regs(&regs, &func_regs);
+	}
+
       /* more decoding and execution */
       switch (op)
 	{
@@ -3796,8 +4926,12 @@ ruu_dispatch(void)
 	  /* compute output/input dependencies to out1-2 and in1-3 */	\
 	  out1 = O1; out2 = O2;						\
 	  in1 = I1; in2 = I2; in3 = I3;					\
-	  /* execute the instruction */					\
-	  SYMCAT(OP,_IMPL);						\
+	  /* execute the instruction, unless it is dispatched again */	\
+	  /* or the functional thread executed it */			\
+	  if (!replay && !frec)						\
+	    {								\
+	      SYMCAT(OP,_IMPL);						\
+	    }								\
 	  break;
 #define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
 	case OP:							\
@@ -3832,6 +4966,41 @@ ruu_dispatch(void)
 	}
       /* operation sets next PC */
 
+      if (replay)
+	{
+	  /* the inst executed as recorded */
+	  regs.regs_NPC = replay_buf[replay_head].NPC;
+	  target_PC = replay_buf[replay_head].target_PC;
+	  addr = replay_buf[replay_head].addr;
+	  replay_head = (replay_head + 1) % RUU_size;
+	  replay_num--;
+	}
+      else if (!spec_mode && replay_num != 0 && op != MD_NOP_OP)
+	panic("inst dispatched again out of program order");
+      else if (frec)
+	{
+	  /* the inst executed as the functional thread recorded */
+	  regs.regs_NPC = frec->NPC;
+	  target_PC = frec->target_PC;
+	  addr = frec->addr;
+	  fault = frec->fault;
+
+	  /* a mis-predicted branch starts the wrong path from its
+	     registers */
+	  if ((MD_OP_FLAGS(op) & F_CTRL) && pred_PC != regs.regs_NPC)
+	    func_copy_regs(&regs, &frec->regs);
+	  func_release();
+	}
+      else if (func_thread && !spec_mode)
+	{
+	  /* the inst executed here, the functional thread takes over */
+	  func_sync_done(&regs);
+	}
+
+      /* where functional simulation resumes after a sampling drain */
+      if (!spec_mode)
+	sample_next_PC = regs.regs_NPC;
+
       /* print retirement trace if in verbose mode */
       if (!spec_mode && verbose)
         {
@@ -3931,6 +5100,14 @@ ruu_dispatch(void)
 	  rs->queued = rs->issued = rs->completed = FALSE;
 	  rs->ptrace_seq = pseq;
 
+	  /* record the outcome of the inst, to dispatch it again */
+	  rs->replay.PC = regs.regs_PC;
+	  rs->replay.NPC = regs.regs_NPC;
+	  rs->replay.target_PC = target_PC;
+	  rs->replay.addr = addr;
+	  rs->replay.op = op;
+	  rs->replay.num = sim_num_insn;
+
 	  /* split ld/st's into two operations: eff addr comp + mem access */
 	  if (MD_OP_FLAGS(op) & F_MEM)
 	    {
@@ -3999,14 +5176,25 @@ ruu_dispatch(void)
 	      /* issue may continue when the load/store is issued */
 	      RSLINK_INIT(last_op, lsq);
 
-	      /* issue stores only, loads are issued by lsq_refresh() */
-	      if (((MD_OP_FLAGS(op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE))
-		  && OPERANDS_READY(lsq))
+	      /* issue stores only, loads are issued once their memory
+		 dependences are satisfied (see lsq_refresh()) */
+	      lsq->ld_wait_list = NULL;
+	      lsq->ld_waiting = lsq->ld_spec = FALSE;
+	      ss_dispatch(lsq);
+	      if (LSQ_IS_STORE(lsq))
 		{
-		  /* panic("store immediately ready"); */
-		  /* put operation on ready list, ruu_issue() issue it later */
-		  readyq_enqueue(lsq);
+		  if (STORE_ADDR_READY(lsq))
+		    lsq_store_known(lsq);
+		  if (OPERANDS_READY(lsq))
+		    {
+		      /* panic("store immediately ready"); */
+		      /* put operation on ready list, ruu_issue() issue it
+			 later */
+		      readyq_enqueue(lsq);
+		    }
 		}
+	      else
+		lsq_check_load(lsq);
 	    }
 	  else /* !(MD_OP_FLAGS(op) & F_MEM) */
 	    {
@@ -4222,8 +5410,13 @@ ruu_fetch(void)
 	  && fetch_regs_PC < (ld_text_base+ld_text_size)
 	  && !(fetch_regs_PC & (sizeof(md_inst_t)-1)))
 	{
-	  /* read instruction from memory */
-	  MD_FETCH_INST(inst, mem, fetch_regs_PC);
+	  /* read instruction from memory, or from the copy of the text if a
+	     functional thread owns memory */
+	  if (func_text)
+	    inst = func_text[(fetch_regs_PC - ld_text_base)
+			     / sizeof(md_inst_t)];
+	  else
+	    MD_FETCH_INST(inst, mem, fetch_regs_PC);
 
 	  /* address is within program text, read instruction from memory */
 	  lat = cache_il1_lat;
@@ -4233,7 +5426,7 @@ ruu_fetch(void)
 	      lat =
 		cache_access(cache_il1, Read, IACOMPRESS(fetch_regs_PC),
 			     NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle,
-			     NULL, NULL);
+			     NULL, NULL, /* !prefetch */0);
 	      if (lat > cache_il1_lat)
 		last_inst_missed = TRUE;
 	    }
@@ -4245,7 +5438,7 @@ ruu_fetch(void)
 	      tlb_lat =
 		cache_access(itlb, Read, IACOMPRESS(fetch_regs_PC),
 			     NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle,
-			     NULL, NULL);
+			     NULL, NULL, /* !prefetch */0);
 	      if (tlb_lat > 1)
 		last_inst_tmissed = TRUE;
 
@@ -4292,7 +5485,12 @@ ruu_fetch(void)
 			   /* updt */&(fetch_data[fetch_tail].dir_update),
 			   /* RSB index */&stack_recover_idx);
 	  else
-	    fetch_pred_PC = 0;
+	    {
+	      fetch_pred_PC = 0;
+	      /* the RSB is left as is, a memory order violation recovers it
+		 to this top of stack (see lsq_recover()) */
+	      stack_recover_idx = pred->retstack.tos;
+	    }
 
 	  /* valid address returned from branch predictor? */
 	  if (!fetch_pred_PC)
@@ -4339,71 +5537,793 @@ ruu_fetch(void)
     }
 }
 
-/* default machine state accessor, used by DLite */
-static char *					/* err str, NULL for no err */
-simoo_mstate_obj(FILE *stream,			/* output stream */
-		 char *cmd,			/* optional command string */
-		 struct regs_t *regs,		/* registers to access */
-		 struct mem_t *mem)		/* memory space to access */
+/* returns the cycle the pipeline is idle until: until then no instruction
+   can commit, complete, become ready, issue, dispatch or be fetched, only
+   the FU busy timers and the fetch delay count down; returns sim_cycle if
+   the pipeline is not idle in this cycle, or if nothing ends the idle time */
+static tick_t
+ruu_idle_until(void)
 {
-  if (!cmd || !strcmp(cmd, "help"))
-    fprintf(stream,
-"mstate commands:\n"
-"\n"
-"    mstate help   - show all machine-specific commands (this list)\n"
-"    mstate stats  - dump all statistical variables\n"
-"    mstate res    - dump current functional unit resource states\n"
-"    mstate ruu    - dump contents of the register update unit\n"
-"    mstate lsq    - dump contents of the load/store queue\n"
-"    mstate eventq - dump contents of event queue\n"
-"    mstate readyq - dump contents of ready instruction queue\n"
-"    mstate cv     - dump contents of the register create vector\n"
-"    mstate rspec  - dump contents of speculative regs\n"
-"    mstate mspec  - dump contents of speculative memory\n"
-"    mstate fetch  - dump contents of fetch stage registers and fetch queue\n"
-"\n"
-	    );
-  else if (!strcmp(cmd, "stats"))
-    {
-      /* just dump intermediate stats */
-      sim_print_stats(stream);
-    }
-  else if (!strcmp(cmd, "res"))
-    {
-      /* dump resource state */
-      res_dump(fu_pool, stream);
-    }
-  else if (!strcmp(cmd, "ruu"))
-    {
-      /* dump RUU contents */
-      ruu_dump(stream);
-    }
-  else if (!strcmp(cmd, "lsq"))
-    {
-      /* dump LSQ contents */
-      lsq_dump(stream);
-    }
-  else if (!strcmp(cmd, "eventq"))
+  tick_t until = 0, when;
+  struct RUU_station *rs;
+  enum md_opcode op;
+
+  /* the RUU head, and its LSQ entry, must not be complete */
+  if (RUU_num > 0 && RUU[RUU_head].completed
+      && (!RUU[RUU_head].ea_comp || LSQ[LSQ_head].completed))
+    return sim_cycle;
+
+  /* no instruction may be ready to issue, or become ready in
+     lsq_refresh() */
+  if (readyq_num > 0)
+    return sim_cycle;
+  if (LSQ_sta_known < LSQ_num)
     {
-      /* dump event queue contents */
-      eventq_dump(stream);
+      rs = &LSQ[(LSQ_head + LSQ_sta_known) % LSQ_size];
+      if (!LSQ_IS_STORE(rs) || STORE_ADDR_READY(rs))
+	return sim_cycle;
     }
-  else if (!strcmp(cmd, "readyq"))
+
+  /* dispatch must be stalled, see ruu_dispatch() */
+  if (RUU_num < RUU_size && LSQ_num < LSQ_size && fetch_num != 0
+      && (ruu_include_spec || !spec_mode)
+      && (sample_phase != sp_drain || replay_num != 0))
     {
-      /* dump event queue contents */
-      readyq_dump(stream);
+      /* a trap waits for the RUU to drain */
+      MD_SET_OPCODE(op, fetch_data[fetch_head].IR);
+      if (!(MD_OP_FLAGS(op) & F_TRAP) || RUU_num == 0)
+	return sim_cycle;
     }
-  else if (!strcmp(cmd, "cv"))
+
+  /* fetch must be blocked until the fetch delay is over, or the IFQ full */
+  if (fetch_num < ruu_ifq_size)
     {
-      /* dump event queue contents */
-      cv_dump(stream);
+      if (!ruu_fetch_issue_delay)
+	return sim_cycle;
+      until = sim_cycle + ruu_fetch_issue_delay;
     }
-  else if (!strcmp(cmd, "rspec"))
+
+  /* and the next event must be in the future */
+  when = eventq_next_cycle();
+  if (when && (!until || when < until))
+    until = when;
+
+  return until ? until : sim_cycle;
+}
+
+/* skip the idle cycles from sim_cycle up to UNTIL, see ruu_idle_until(),
+   updating the state that changes in them as if they were simulated */
+static void
+ruu_skip_idle(tick_t until)			/* first cycle not idle */
+{
+  counter_t n = until - sim_cycle;
+  int i;
+
+  /* count down the FU busy timers, see ruu_release_fu() */
+  for (i=0; i<fu_pool->num_resources; i++)
     {
-      /* dump event queue contents */
-      rspec_dump(stream);
+      if (fu_pool->resources[i].busy > n)
+	fu_pool->resources[i].busy -= n;
+      else
+	fu_pool->resources[i].busy = 0;
     }
-  else if (!strcmp(cmd, "mspec"))
+
+  /* and the fetch delay */
+  if (ruu_fetch_issue_delay > n)
+    ruu_fetch_issue_delay -= n;
+  else
+    ruu_fetch_issue_delay = 0;
+
+  /* update buffer occupancy stats, occupancy does not change */
+  IFQ_count += n * fetch_num;
+  IFQ_fcount += ((fetch_num == ruu_ifq_size) ? n : 0);
+  RUU_count += n * RUU_num;
+  RUU_fcount += ((RUU_num == RUU_size) ? n : 0);
+  LSQ_count += n * LSQ_num;
+  LSQ_fcount += ((LSQ_num == LSQ_size) ? n : 0);
+
+  sim_idle_cycles += n;
+  sim_cycle = until;
+}
+
+
+/*
+ * functional simulation, used to fast forward and between the detailed
+ * parts of samples
+ */
+
+/* execute N insts from regs.regs_PC on the architected state, without
+   timing; with WARM, the insts access the caches and TLBs and train the
+   branch predictor as they would in order, their stats count these; with
+   sampling, sim_num_insn counts the insts, as EIO traces expect */
+static void
+sim_fastfwd(counter_t n,			/* insts to execute */
+	    int warm)				/* warm the caches and bpred? */
+{
+  counter_t icount;
+  md_inst_t inst;			/* actual instruction bits */
+  enum md_opcode op;			/* decoded opcode enum */
+  md_addr_t target_PC;			/* actual next/target PC address */
+  md_addr_t addr;			/* effective address, if load/store */
+  int is_write;				/* store? */
+  byte_t temp_byte = 0;			/* temp variable for spec mem access */
+  half_t temp_half = 0;			/* " ditto " */
+  word_t temp_word = 0;			/* " ditto " */
+#ifdef HOST_HAS_QWORD
+  qword_t temp_qword = 0;		/* " ditto " */
+#endif /* HOST_HAS_QWORD */
+  enum md_fault_type fault;
+
+  for (icount=0; icount < n; icount++)
+    {
+      /* maintain $r0 semantics */
+      regs.regs_R[MD_REG_ZERO] = 0;
+#ifdef TARGET_ALPHA
+      regs.regs_F.d[MD_REG_ZERO] = 0.0;
+#endif /* TARGET_ALPHA */
+
+      /* get the next instruction to execute */
+      MD_FETCH_INST(inst, mem, regs.regs_PC);
+
+      /* set default reference address */
+      addr = 0; is_write = FALSE;
+
+      /* set default fault - none */
+      fault = md_fault_none;
+
+      /* decode the instruction */
+      MD_SET_OPCODE(op, inst);
+
+      if (sample_period)
+	{
+	  sim_num_insn++;
+	  sample_func_insn++;
+	}
+
+      /* execute the instruction */
+      switch (op)
+	{
+#define DEFINST(OP,MSK,NAME,OPFORM,RES,FLAGS,O1,O2,I1,I2,I3)		\
+	case OP:							\
+	  SYMCAT(OP,_IMPL);						\
+	  break;
+#define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
+	case OP:							\
+	  panic("attempted to execute a linking opcode");
+#define CONNECT(OP)
+#undef DECLARE_FAULT
+#define DECLARE_FAULT(FAULT)						\
+	  { fault = (FAULT); break; }
+#include "machine.def"
+	default:
+	  panic("attempted to execute a bogus opcode");
+	}
+
+      if (fault != md_fault_none)
+	fatal("fault (%d) detected @ 0x%08p", fault, regs.regs_PC);
+
+      /* update memory access stats */
+      if (MD_OP_FLAGS(op) & F_MEM)
+	{
+	  if (MD_OP_FLAGS(op) & F_STORE)
+	    is_write = TRUE;
+	}
+
+      if (warm)
+	{
+	  /* fetch through the I-cache and I-TLB */
+	  if (cache_il1)
+	    cache_access(cache_il1, Read, IACOMPRESS(regs.regs_PC),
+			 NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle,
+			 NULL, NULL, /* !prefetch */0);
+	  if (itlb)
+	    cache_access(itlb, Read, IACOMPRESS(regs.regs_PC),
+			 NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle,
+			 NULL, NULL, /* !prefetch */0);
+
+	  /* loads and stores access the D-cache and D-TLB */
+	  if ((MD_OP_FLAGS(op) & F_MEM) && MD_VALID_ADDR(addr))
+	    {
+	      if (cache_dl1)
+		cache_access(cache_dl1, is_write ? Write : Read, (addr & ~3),
+			     NULL, 4, sim_cycle, NULL, NULL, /* !prefetch */0);
+	      if (dtlb)
+		cache_access(dtlb, Read, (addr & ~3),
+			     NULL, 4, sim_cycle, NULL, NULL, /* !prefetch */0);
+	    }
+
+	  /* control insts update the predictor with their outcome */
+	  if (pred && (MD_OP_FLAGS(op) & F_CTRL))
+	    {
+	      struct bpred_update_t dir_update;
+	      int stack_recover_idx;
+	      md_addr_t pred_PC;
+
+	      pred_PC = bpred_lookup(pred,
+				     /* branch address */regs.regs_PC,
+				     /* target address */target_PC,
+				     /* opcode */op,
+				     /* call? */MD_IS_CALL(op),
+				     /* return? */MD_IS_RETURN(op),
+				     /* updt */&dir_update,
+				     /* RSB index */&stack_recover_idx);
+	      if (!pred_PC)
+		pred_PC = regs.regs_PC + sizeof(md_inst_t);
+	      bpred_update(pred,
+			   /* branch address */regs.regs_PC,
+			   /* actual target address */regs.regs_NPC,
+			   /* taken? */regs.regs_NPC != (regs.regs_PC +
+							 sizeof(md_inst_t)),
+			   /* pred taken? */pred_PC != (regs.regs_PC +
+							sizeof(md_inst_t)),
+			   /* correct pred? */pred_PC == regs.regs_NPC,
+			   /* opcode */op,
+			   /* predictor update ptr */&dir_update);
+	    }
+	}
+
+      /* check for DLite debugger entry condition */
+      if (dlite_check_break(regs.regs_NPC,
+			    is_write ? ACCESS_WRITE : ACCESS_READ,
+			    addr, sim_num_insn, sim_num_insn))
+	dlite_main(regs.regs_PC, regs.regs_NPC, sim_num_insn, &regs, mem);
+
+      /* go to the next instruction */
+      regs.regs_PC = regs.regs_NPC;
+      regs.regs_NPC += sizeof(md_inst_t);
+    }
+
+  /* the warming accesses did not advance time, the fills they started are
+     complete when the timing resumes */
+  if (warm)
+    {
+      if (cache_il1)
+	cache_settle(cache_il1, sim_cycle);
+      if (cache_il2 && cache_il2 != cache_dl2)
+	cache_settle(cache_il2, sim_cycle);
+      if (cache_dl1)
+	cache_settle(cache_dl1, sim_cycle);
+      if (cache_dl2)
+	cache_settle(cache_dl2, sim_cycle);
+      if (itlb)
+	cache_settle(itlb, sim_cycle);
+      if (dtlb)
+	cache_settle(dtlb, sim_cycle);
+    }
+}
+
+
+/*
+ * sampled simulation: every sample period executes functionally, warming
+ * the caches and predictor, and then in detail, a warm-up and a measured
+ * window; the CPI of the windows estimates the CPI of the program
+ */
+
+/* least measured windows before the error can stop simulation */
+#define SAMPLE_MIN_NUM		30
+
+/* sim_num_insn at the start of the detailed part of the sample, and at the
+   end of its current phase */
+static counter_t sample_detail_start;
+static counter_t sample_mark;
+
+/* start of the measured window */
+static tick_t sample_start_cycle;
+static counter_t sample_start_insn;
+
+/* execute N insts functionally from regs.regs_PC, then start the detailed
+   part of a sample; returns TRUE if max_insts insts executed */
+static int
+sample_skip(counter_t n)			/* insts to execute */
+{
+  int done = FALSE;
+  counter_t left;
+
+  if (max_insts)
+    {
+      left = sim_num_insn < max_insts ? max_insts - sim_num_insn : 0;
+      if (n >= left)
+	{
+	  n = left;
+	  done = TRUE;
+	}
+    }
+
+  sim_fastfwd(n, /* warm */TRUE);
+
+  sample_phase = sp_warmup;
+  sample_detail_start = sim_num_insn;
+  sample_mark = sim_num_insn + sample_warmup;
+
+  return done;
+}
+
+/* add the CPI of a measured window to the estimate, returns TRUE if the
+   estimate is within the requested error */
+static int
+sample_record(double cpi)			/* CPI of the window */
+{
+  double n, var;
+
+  sample_num++;
+  sample_cpi_sum += cpi;
+  sample_cpi_sum2 += cpi * cpi;
+
+  n = (double)sample_num;
+  sample_cpi = sample_cpi_sum / n;
+  if (sample_num > 1)
+    {
+      var = (sample_cpi_sum2 - n * sample_cpi * sample_cpi) / (n - 1.0);
+      sample_cpi_stddev = var > 0.0 ? sqrt(var) : 0.0;
+    }
+  if (sample_cpi > 0.0)
+    sample_cpi_error = sample_z * sample_cpi_stddev / (sample_cpi * sqrt(n));
+
+  return (sample_error > 0.0
+	  && sample_num >= SAMPLE_MIN_NUM
+	  && sample_cpi_error <= sample_error);
+}
+
+/* advance the sample at the end of a cycle of detailed simulation, returns
+   TRUE if simulation is done */
+static int
+sample_step(void)
+{
+  counter_t n;
+
+  switch (sample_phase)
+    {
+    case sp_warmup:
+      if (sim_num_insn >= sample_mark)
+	{
+	  sample_phase = sp_measure;
+	  sample_mark = sim_num_insn + sample_size;
+	  sample_start_cycle = sim_cycle;
+	  sample_start_insn = sim_num_insn;
+	}
+      break;
+
+    case sp_measure:
+      if (sim_num_insn >= sample_mark)
+	{
+	  if (sample_record((double)(sim_cycle - sample_start_cycle)
+			    / (double)(sim_num_insn - sample_start_insn)))
+	    return TRUE;
+
+	  /* stop dispatch, see ruu_dispatch() */
+	  sample_phase = sp_drain;
+	}
+      break;
+
+    case sp_drain:
+      /* once the pipeline drained, every inst dispatched committed and the
+	 mis-speculated paths are squashed */
+      if (RUU_num == 0 && replay_num == 0)
+	{
+	  if (spec_mode)
+	    panic("drained and speculative");
+
+	  /* execute the rest of the period functionally */
+	  regs.regs_PC = sample_next_PC;
+	  regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
+	  n = sim_num_insn - sample_detail_start;
+	  if (sample_skip(n < sample_period ? sample_period - n : 0))
+	    return TRUE;
+
+	  /* and fetch from the next inst again */
+	  fetch_squash(regs.regs_PC);
+	  ruu_fetch_issue_delay = 0;
+	  regs.regs_PC = regs.regs_PC - sizeof(md_inst_t);
+	}
+      break;
+
+    default:
+      panic("bogus sample phase");
+    }
+
+  return FALSE;
+}
+
+/*
+ * checkpoints of the timing state, taken between two cycles of the main
+ * loop: the architected state and the complete state of the pipeline, the
+ * caches and TLBs, the predictor and the stats; a simulation resumed from a
+ * checkpoint goes on exactly as the one that saved it would have, so a long
+ * simulation survives preemption (SIGUSR2 stops it at the end of a cycle)
+ * or runs as chunks, each to a larger -max:inst; pointers are saved as
+ * indices and the RS_LINKs of the lists are allocated again on restore; the
+ * host files a program opened are not saved, only programs run from EIO
+ * traces resume exactly
+ */
+
+/* checkpoint file magic and format version, bump the version when the
+   state saved changes */
+#define CHKPT_MAGIC		"sim-outorder timing checkpoint"
+#define CHKPT_VERSION		3
+
+/* cycle the next periodic checkpoint is saved at */
+static tick_t chkpt_next_cycle;
+
+/* save RUU station pointer *PRS to checkpoint CK as an index, of the RUU
+   then of the LSQ entries, or restore it */
+static void
+chkpt_rs(struct chkpt_t *ck,			/* checkpoint */
+	 struct RUU_station **prs)		/* RUU station pointer */
+{
+  int index = -1;
+
+  if (!ck->restore && *prs)
+    {
+      if (*prs >= RUU && *prs < RUU + RUU_size)
+	index = *prs - RUU;
+      else if (*prs >= LSQ && *prs < LSQ + LSQ_size)
+	index = RUU_size + (*prs - LSQ);
+      else
+	panic("bogus RUU station pointer");
+    }
+
+  CHKPT_XFER(ck, index);
+
+  if (ck->restore)
+    {
+      if (index < -1 || index >= RUU_size + LSQ_size)
+	fatal("checkpoint `%s' has a bogus RUU station", ck->fname);
+      *prs = (index < 0 ? NULL
+	      : index < RUU_size ? &RUU[index] : &LSQ[index - RUU_size]);
+    }
+}
+
+/* save RS_LINK list *PLIST to checkpoint CK, or restore it with links from
+   the free list */
+static void
+chkpt_rslist(struct chkpt_t *ck,		/* checkpoint */
+	     struct RS_link **plist)		/* RS_LINK list */
+{
+  int n = 0;
+  struct RS_link *link, **tail;
+  struct RUU_station *rs;
+
+  if (!ck->restore)
+    {
+      for (link = *plist; link; link = link->next)
+	n++;
+      CHKPT_XFER(ck, n);
+      for (link = *plist; link; link = link->next)
+	{
+	  chkpt_rs(ck, &link->rs);
+	  CHKPT_XFER(ck, link->tag);
+	  CHKPT_XFER(ck, link->x);
+	}
+      return;
+    }
+
+  CHKPT_XFER(ck, n);
+  for (tail = plist; n > 0; n--)
+    {
+      chkpt_rs(ck, &rs);
+      if (!rs)
+	fatal("checkpoint `%s' has a bogus RS link", ck->fname);
+      RSLINK_NEW(link, rs);
+      CHKPT_XFER(ck, link->tag);
+      CHKPT_XFER(ck, link->x);
+      *tail = link;
+      tail = &link->next;
+    }
+  *tail = NULL;
+}
+
+/* save RUU or LSQ station RS to checkpoint CK, or restore it, the pointers
+   of a station that holds no inst (!IN_USE) are not saved */
+static void
+chkpt_station(struct chkpt_t *ck,		/* checkpoint */
+	      struct RUU_station *rs,		/* RUU or LSQ station */
+	      int in_use)			/* station holds an inst? */
+{
+  int i;
+
+  CHKPT_XFER(ck, *rs);
+
+  if (in_use)
+    {
+      bpred_chkpt_update(pred, &rs->dir_update, ck);
+      for (i=0; i < MAX_ODEPS; i++)
+	chkpt_rslist(ck, &rs->odep_list[i]);
+      chkpt_rslist(ck, &rs->ld_wait_list);
+      chkpt_rs(ck, &rs->ss_store);
+    }
+  else if (ck->restore)
+    {
+      rs->dir_update.pdir1 = rs->dir_update.pdir2 = NULL;
+      rs->dir_update.pmeta = NULL;
+      for (i=0; i < MAX_ODEPS; i++)
+	rs->odep_list[i] = NULL;
+      rs->ld_wait_list = NULL;
+      rs->ss_store = NULL;
+    }
+}
+
+/* save the timing state to checkpoint CK, or restore it from it */
+static void
+sim_chkpt(struct chkpt_t *ck)			/* checkpoint */
+{
+  int i, j, size;
+  counter_t eio_icnt;
+  struct cache_t *caches[6];
+
+  chkpt_name(ck, CHKPT_MAGIC);
+  chkpt_check(ck, "format version", CHKPT_VERSION);
+
+  /* the machine and the program, the other options are up to the user */
+  chkpt_check(ck, "RUU size", RUU_size);
+  chkpt_check(ck, "LSQ size", LSQ_size);
+  chkpt_check(ck, "IFQ size", ruu_ifq_size);
+  chkpt_check(ck, "store sets", ss_enabled);
+  if (ss_enabled)
+    {
+      chkpt_check(ck, "SSIT size", ss_ssit_size);
+      chkpt_check(ck, "LFST size", ss_lfst_size);
+    }
+  chkpt_check(ck, "RUU station size", sizeof(struct RUU_station));
+  chkpt_check(ck, "functional unit count", fu_pool->num_resources);
+  chkpt_check(ck, "perfect prediction", pred_perfect);
+  if (pred)
+    bpred_chkpt_config(pred, ck);
+  chkpt_check(ck, "EIO trace", sim_eio_fd != NULL);
+  chkpt_check(ck, "program entry", ld_prog_entry);
+  chkpt_check(ck, "text size", ld_text_size);
+
+  /* architected state, and the EIO transactions done */
+  CHKPT_XFER(ck, regs);
+  mem_chkpt(mem, ck);
+  CHKPT_XFER(ck, ld_brk_point);
+  eio_icnt = eio_trans_last();
+  CHKPT_XFER(ck, eio_icnt);
+  if (ck->restore && sim_eio_fd && eio_icnt != (counter_t)-1)
+    eio_fast_forward(sim_eio_fd, eio_icnt);
+
+  /* stats, with the counters of the modules below */
+  stat_chkpt(sim_sdb, ck);
+  chkpt_xfer(ck, pcstat_lastvals, sizeof(pcstat_lastvals));
+
+  /* memory hierarchy, each cache once, and predictor */
+  caches[0] = cache_il1; caches[1] = cache_il2;
+  caches[2] = cache_dl1; caches[3] = cache_dl2;
+  caches[4] = itlb; caches[5] = dtlb;
+  for (i=0; i < N_ELT(caches); i++)
+    {
+      for (j=0; j < i && caches[j] != caches[i]; j++)
+	/* nada */;
+      chkpt_check(ck, "cache", caches[i] != NULL && j == i);
+      if (caches[i] && j == i)
+	cache_chkpt(caches[i], ck);
+    }
+  if (pred)
+    bpred_chkpt(pred, ck);
+  myrand_chkpt(ck);
+
+  /* fetch */
+  CHKPT_XFER(ck, fetch_regs_PC);
+  CHKPT_XFER(ck, fetch_pred_PC);
+  CHKPT_XFER(ck, pred_PC);
+  CHKPT_XFER(ck, recover_PC);
+  CHKPT_XFER(ck, fetch_num);
+  CHKPT_XFER(ck, fetch_head);
+  CHKPT_XFER(ck, fetch_tail);
+  for (i=0; i < ruu_ifq_size; i++)
+    {
+      CHKPT_XFER(ck, fetch_data[i]);
+      if (((i - fetch_head) & (ruu_ifq_size - 1)) < fetch_num)
+	bpred_chkpt_update(pred, &fetch_data[i].dir_update, ck);
+      else if (ck->restore)
+	{
+	  fetch_data[i].dir_update.pdir1 = NULL;
+	  fetch_data[i].dir_update.pdir2 = NULL;
+	  fetch_data[i].dir_update.pmeta = NULL;
+	}
+    }
+  CHKPT_XFER(ck, last_inst_missed);
+  CHKPT_XFER(ck, last_inst_tmissed);
+  CHKPT_XFER(ck, ruu_fetch_issue_delay);
+
+  /* speculative state, the table may have grown */
+  CHKPT_XFER(ck, spec_mode);
+  CHKPT_XFER(ck, use_spec_R);
+  CHKPT_XFER(ck, spec_regs_R);
+  CHKPT_XFER(ck, use_spec_F);
+  CHKPT_XFER(ck, spec_regs_F);
+  CHKPT_XFER(ck, use_spec_C);
+  CHKPT_XFER(ck, spec_regs_C);
+  size = spec_mem_size;
+  CHKPT_XFER(ck, size);
+  if (ck->restore && size != spec_mem_size)
+    {
+      free(spec_mem_table);
+      spec_mem_table = calloc(size, sizeof(struct spec_mem_ent));
+      if (!spec_mem_table)
+	fatal("out of virtual memory");
+      spec_mem_size = size;
+    }
+  chkpt_xfer(ck, spec_mem_table, spec_mem_size * sizeof(struct spec_mem_ent));
+  CHKPT_XFER(ck, spec_mem_used);
+  CHKPT_XFER(ck, spec_mem_epoch);
+
+  /* RUU and LSQ */
+  CHKPT_XFER(ck, RUU_head);
+  CHKPT_XFER(ck, RUU_tail);
+  CHKPT_XFER(ck, RUU_num);
+  for (i=0; i < RUU_size; i++)
+    chkpt_station(ck, &RUU[i],
+		  (i - RUU_head + RUU_size) % RUU_size < RUU_num);
+  CHKPT_XFER(ck, LSQ_head);
+  CHKPT_XFER(ck, LSQ_tail);
+  CHKPT_XFER(ck, LSQ_num);
+  for (i=0; i < LSQ_size; i++)
+    chkpt_station(ck, &LSQ[i],
+		  (i - LSQ_head + LSQ_size) % LSQ_size < LSQ_num);
+  CHKPT_XFER(ck, LSQ_sta_known);
+  chkpt_xfer(ck, LSQ_st_hash, 2*LSQ_size * sizeof(int));
+  if (ss_enabled)
+    {
+      chkpt_xfer(ck, LSQ_ld_hash, 2*LSQ_size * sizeof(int));
+      chkpt_xfer(ck, ss_ssit, ss_ssit_size * sizeof(int));
+      for (i=0; i < ss_lfst_size; i++)
+	{
+	  chkpt_rs(ck, &ss_lfst[i].rs);
+	  CHKPT_XFER(ck, ss_lfst[i].tag);
+	}
+      CHKPT_XFER(ck, ss_clear_cycle);
+      chkpt_xfer(ck, replay_buf, RUU_size * sizeof(struct replay_rec));
+      CHKPT_XFER(ck, replay_head);
+      CHKPT_XFER(ck, replay_num);
+    }
+  chkpt_rs(ck, &last_op.rs);
+  CHKPT_XFER(ck, last_op.tag);
+  CHKPT_XFER(ck, inst_seq);
+  CHKPT_XFER(ck, ptrace_seq);
+
+  /* create vector */
+  CHKPT_XFER(ck, use_spec_cv);
+  for (i=0; i < MD_TOTAL_REGS; i++)
+    {
+      chkpt_rs(ck, &create_vector[i].rs);
+      CHKPT_XFER(ck, create_vector[i].odep_num);
+      chkpt_rs(ck, &spec_create_vector[i].rs);
+      CHKPT_XFER(ck, spec_create_vector[i].odep_num);
+    }
+  CHKPT_XFER(ck, create_vector_rt);
+  CHKPT_XFER(ck, spec_create_vector_rt);
+
+  /* event queue, the wheel and the heap beyond it */
+  for (i=0; i < EVENTQ_WHEEL_SIZE; i++)
+    chkpt_rslist(ck, &event_wheel[i]);
+  CHKPT_XFER(ck, event_base);
+  CHKPT_XFER(ck, event_wheel_count);
+  CHKPT_XFER(ck, event_heap_count);
+  if (ck->restore && event_heap_count > event_heap_size)
+    {
+      event_heap_size = event_heap_count;
+      event_heap = realloc(event_heap,
+			   event_heap_size * sizeof(struct eventq_far));
+      if (!event_heap)
+	fatal("out of virtual memory");
+    }
+  for (i=0; i < event_heap_count; i++)
+    {
+      CHKPT_XFER(ck, event_heap[i].when);
+      CHKPT_XFER(ck, event_heap[i].seq);
+      chkpt_rslist(ck, &event_heap[i].ev);
+    }
+  CHKPT_XFER(ck, event_heap_seq);
+
+  /* ready queue */
+  chkpt_xfer(ck, ready_ruu_pri,
+	     BITMAP_SIZE(RUU_size) * sizeof(BITMAP_ENT_TYPE));
+  chkpt_xfer(ck, ready_lsq, BITMAP_SIZE(LSQ_size) * sizeof(BITMAP_ENT_TYPE));
+  chkpt_xfer(ck, ready_ruu, BITMAP_SIZE(RUU_size) * sizeof(BITMAP_ENT_TYPE));
+  CHKPT_XFER(ck, readyq_num);
+
+  /* functional units */
+  for (i=0; i < fu_pool->num_resources; i++)
+    CHKPT_XFER(ck, fu_pool->resources[i].busy);
+
+  /* pipetrace */
+  CHKPT_XFER(ck, ptrace_active);
+  CHKPT_XFER(ck, ptrace_oneshot);
+
+  chkpt_name(ck, "end of checkpoint");
+}
+
+/* save a checkpoint of the timing state to chkpt_save_fname */
+static void
+chkpt_save(void)
+{
+  struct chkpt_t *ck;
+
+  ck = chkpt_open(chkpt_save_fname, /* !restore */FALSE);
+  sim_chkpt(ck);
+  chkpt_close(ck);
+}
+
+/* restore the timing state from checkpoint file FNAME */
+static void
+chkpt_restore(char *fname)			/* checkpoint file */
+{
+  struct chkpt_t *ck;
+
+  if (!sim_eio_fd)
+    warn("the files a program opened are not in a checkpoint, "
+	 "run it from an EIO trace to resume it exactly");
+
+  ck = chkpt_open(fname, /* restore */TRUE);
+  sim_chkpt(ck);
+  chkpt_close(ck);
+}
+
+/* default machine state accessor, used by DLite */
+static char *					/* err str, NULL for no err */
+simoo_mstate_obj(FILE *stream,			/* output stream */
+		 char *cmd,			/* optional command string */
+		 struct regs_t *regs,		/* registers to access */
+		 struct mem_t *mem)		/* memory space to access */
+{
+  if (!cmd || !strcmp(cmd, "help"))
+    fprintf(stream,
+"mstate commands:\n"
+"\n"
+"    mstate help   - show all machine-specific commands (this list)\n"
+"    mstate stats  - dump all statistical variables\n"
+"    mstate res    - dump current functional unit resource states\n"
+"    mstate ruu    - dump contents of the register update unit\n"
+"    mstate lsq    - dump contents of the load/store queue\n"
+"    mstate eventq - dump contents of event queue\n"
+"    mstate readyq - dump contents of ready instruction queue\n"
+"    mstate cv     - dump contents of the register create vector\n"
+"    mstate rspec  - dump contents of speculative regs\n"
+"    mstate mspec  - dump contents of speculative memory\n"
+"    mstate fetch  - dump contents of fetch stage registers and fetch queue\n"
+"\n"
+	    );
+  else if (!strcmp(cmd, "stats"))
+    {
+      /* just dump intermediate stats */
+      sim_print_stats(stream);
+    }
+  else if (!strcmp(cmd, "res"))
+    {
+      /* dump resource state */
+      res_dump(fu_pool, stream);
+    }
+  else if (!strcmp(cmd, "ruu"))
+    {
+      /* dump RUU contents */
+      ruu_dump(stream);
+    }
+  else if (!strcmp(cmd, "lsq"))
+    {
+      /* dump LSQ contents */
+      lsq_dump(stream);
+    }
+  else if (!strcmp(cmd, "eventq"))
+    {
+      /* dump event queue contents */
+      eventq_dump(stream);
+    }
+  else if (!strcmp(cmd, "readyq"))
+    {
+      /* dump event queue contents */
+      readyq_dump(stream);
+    }
+  else if (!strcmp(cmd, "cv"))
+    {
+      /* dump event queue contents */
+      cv_dump(stream);
+    }
+  else if (!strcmp(cmd, "rspec"))
+    {
+      /* dump event queue contents */
+      rspec_dump(stream);
+    }
+  else if (!strcmp(cmd, "mspec"))
     {
       /* dump event queue contents */
       mspec_dump(stream);
@@ -4442,89 +6362,38 @@ sim_main(void)
      FASTFWD_COUNT insts, then turns on performance (timing) simulation */
   if (fastfwd_count > 0)
     {
-      int icount;
-      md_inst_t inst;			/* actual instruction bits */
-      enum md_opcode op;		/* decoded opcode enum */
-      md_addr_t target_PC;		/* actual next/target PC address */
-      md_addr_t addr;			/* effective address, if load/store */
-      int is_write;			/* store? */
-      byte_t temp_byte = 0;		/* temp variable for spec mem access */
-      half_t temp_half = 0;		/* " ditto " */
-      word_t temp_word = 0;		/* " ditto " */
-#ifdef HOST_HAS_QWORD
-      qword_t temp_qword = 0;		/* " ditto " */
-#endif /* HOST_HAS_QWORD */
-      enum md_fault_type fault;
-
       fprintf(stderr, "sim: ** fast forwarding %d insts **\n", fastfwd_count);
+      sim_fastfwd(fastfwd_count, fastfwd_warm);
+    }
 
-      for (icount=0; icount < fastfwd_count; icount++)
-	{
-	  /* maintain $r0 semantics */
-	  regs.regs_R[MD_REG_ZERO] = 0;
-#ifdef TARGET_ALPHA
-	  regs.regs_F.d[MD_REG_ZERO] = 0.0;
-#endif /* TARGET_ALPHA */
-
-	  /* get the next instruction to execute */
-	  MD_FETCH_INST(inst, mem, regs.regs_PC);
-
-	  /* set default reference address */
-	  addr = 0; is_write = FALSE;
-
-	  /* set default fault - none */
-	  fault = md_fault_none;
-
-	  /* decode the instruction */
-	  MD_SET_OPCODE(op, inst);
-
-	  /* execute the instruction */
-	  switch (op)
-	    {
-#define DEFINST(OP,MSK,NAME,OPFORM,RES,FLAGS,O1,O2,I1,I2,I3)		\
-	    case OP:							\
-	      SYMCAT(OP,_IMPL);						\
-	      break;
-#define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
-	    case OP:							\
-	      panic("attempted to execute a linking opcode");
-#define CONNECT(OP)
-#undef DECLARE_FAULT
-#define DECLARE_FAULT(FAULT)						\
-	      { fault = (FAULT); break; }
-#include "machine.def"
-	    default:
-	      panic("attempted to execute a bogus opcode");
-	    }
-
-	  if (fault != md_fault_none)
-	    fatal("fault (%d) detected @ 0x%08p", fault, regs.regs_PC);
+  fprintf(stderr, "sim: ** starting performance simulation **\n");
 
-	  /* update memory access stats */
-	  if (MD_OP_FLAGS(op) & F_MEM)
-	    {
-	      if (MD_OP_FLAGS(op) & F_STORE)
-		is_write = TRUE;
-	    }
+  /* from here on, a functional thread executes the program */
+  if (func_thread)
+    func_start();
 
-	  /* check for DLite debugger entry condition */
-	  if (dlite_check_break(regs.regs_NPC,
-				is_write ? ACCESS_WRITE : ACCESS_READ,
-				addr, sim_num_insn, sim_num_insn))
-	    dlite_main(regs.regs_PC, regs.regs_NPC, sim_num_insn, &regs, mem);
+  /* a sample starts with its functional part */
+  if (sample_period
+      && sample_skip(sample_period - sample_warmup - sample_size))
+    return;
 
-	  /* go to the next instruction */
-	  regs.regs_PC = regs.regs_NPC;
-	  regs.regs_NPC += sizeof(md_inst_t);
-	}
+  if (chkpt_restore_fname)
+    {
+      /* resume the timing simulation saved in the checkpoint */
+      fprintf(stderr, "sim: loading timing checkpoint: %s\n",
+	      chkpt_restore_fname);
+      chkpt_restore(chkpt_restore_fname);
+      myfprintf(stderr, "sim: ** resuming at cycle %n, inst %n **\n",
+		sim_cycle, sim_num_insn);
     }
-
-  fprintf(stderr, "sim: ** starting performance simulation **\n");
-
-  /* set up timing simulation entry state */
-  fetch_regs_PC = regs.regs_PC - sizeof(md_inst_t);
-  fetch_pred_PC = regs.regs_PC;
-  regs.regs_PC = regs.regs_PC - sizeof(md_inst_t);
+  else
+    {
+      /* set up timing simulation entry state */
+      fetch_regs_PC = regs.regs_PC - sizeof(md_inst_t);
+      fetch_pred_PC = regs.regs_PC;
+      regs.regs_PC = regs.regs_PC - sizeof(md_inst_t);
+    }
+  chkpt_next_cycle = sim_cycle + chkpt_period;
 
   /* main simulator loop, NOTE: the pipe stages are traverse in reverse order
      to eliminate this/next state synchronization and relaxation problems */
@@ -4538,6 +6407,16 @@ sim_main(void)
       if (((LSQ_head + LSQ_num) % LSQ_size) != LSQ_tail)
 	panic("LSQ_head/LSQ_tail wedged");
 
+      /* jump over the cycles the pipeline would spend idle, unless each
+	 cycle is pipetraced */
+      if (idle_skip && ptrace_nelt == 0)
+	{
+	  tick_t until = ruu_idle_until();
+
+	  if (until > sim_cycle)
+	    ruu_skip_idle(until);
+	}
+
       /* check if pipetracing is still active */
       ptrace_check_active(regs.regs_PC, sim_num_insn, sim_cycle);
 
@@ -4599,8 +6478,222 @@ sim_main(void)
       /* go to next cycle */
       sim_cycle++;
 
-      /* finish early? */
-      if (max_insts && sim_num_insn >= max_insts)
+      /* next phase of the sample? */
+      if (sample_period && sample_step())
 	return;
+
+      /* finish early? */
+      if ((max_insts && sim_num_insn >= max_insts) || sim_exit_now)
+	break;
+
+      /* save a checkpoint now and then, in case the run is preempted */
+      if (chkpt_period && sim_cycle >= chkpt_next_cycle)
+	{
+	  chkpt_save();
+	  chkpt_next_cycle = sim_cycle + chkpt_period;
+	}
+    }
+
+  /* a later run may go on from here */
+  if (chkpt_save_fname)
+    {
+      chkpt_save();
+      myfprintf(stderr, "sim: ** timing checkpoint saved at cycle %n, "
+		"inst %n: %s **\n", sim_cycle, sim_num_insn, chkpt_save_fname);
     }
 }
+
+
+/*
+ * the functional thread main, it executes the correct path on its own
+ * register state, see func_start(); the inst accessors below replace the
+ * speculative ones of the timing model for the rest of this file
+ */
+
+#undef GPR
+#undef SET_GPR
+#define GPR(N)			(func_regs.regs_R[N])
+#define SET_GPR(N,EXPR)		(func_regs.regs_R[N] = (EXPR))
+
+#if defined(TARGET_PISA)
+
+#undef FPR_L
+#undef SET_FPR_L
+#undef FPR_F
+#undef SET_FPR_F
+#undef FPR_D
+#undef SET_FPR_D
+#define FPR_L(N)		(func_regs.regs_F.l[(N)])
+#define SET_FPR_L(N,EXPR)	(func_regs.regs_F.l[(N)] = (EXPR))
+#define FPR_F(N)		(func_regs.regs_F.f[(N)])
+#define SET_FPR_F(N,EXPR)	(func_regs.regs_F.f[(N)] = (EXPR))
+#define FPR_D(N)		(func_regs.regs_F.d[(N) >> 1])
+#define SET_FPR_D(N,EXPR)	(func_regs.regs_F.d[(N) >> 1] = (EXPR))
+
+#undef HI
+#undef SET_HI
+#undef LO
+#undef SET_LO
+#undef FCC
+#undef SET_FCC
+#define HI			(func_regs.regs_C.hi)
+#define SET_HI(EXPR)		(func_regs.regs_C.hi = (EXPR))
+#define LO			(func_regs.regs_C.lo)
+#define SET_LO(EXPR)		(func_regs.regs_C.lo = (EXPR))
+#define FCC			(func_regs.regs_C.fcc)
+#define SET_FCC(EXPR)		(func_regs.regs_C.fcc = (EXPR))
+
+#elif defined(TARGET_ALPHA)
+
+#undef FPR_Q
+#undef SET_FPR_Q
+#undef FPR
+#undef SET_FPR
+#define FPR_Q(N)		(func_regs.regs_F.q[(N)])
+#define SET_FPR_Q(N,EXPR)	(func_regs.regs_F.q[(N)] = (EXPR))
+#define FPR(N)			(func_regs.regs_F.d[(N)])
+#define SET_FPR(N,EXPR)		(func_regs.regs_F.d[(N)] = (EXPR))
+
+#undef FPCR
+#undef SET_FPCR
+#undef UNIQ
+#undef SET_UNIQ
+#undef FCC
+#undef SET_FCC
+#define FPCR			(func_regs.regs_C.fpcr)
+#define SET_FPCR(EXPR)		(func_regs.regs_C.fpcr = (EXPR))
+#define UNIQ			(func_regs.regs_C.uniq)
+#define SET_UNIQ(EXPR)		(func_regs.regs_C.uniq = (EXPR))
+#define FCC			(func_regs.regs_C.fcc)
+#define SET_FCC(EXPR)		(func_regs.regs_C.fcc = (EXPR))
+
+#else
+#error No ISA target defined...
+#endif
+
+#undef SET_NPC
+#undef CPC
+#define SET_NPC(EXPR)		(func_regs.regs_NPC = (EXPR))
+#define CPC			(func_regs.regs_PC)
+
+/* architected memory state accessors, as the timing model's outside of
+   the wrong path */
+#undef __READ_SPECMEM
+#undef __WRITE_SPECMEM
+#define __READ_SPECMEM(SRC, SRC_V, FAULT)				\
+  (addr = (SRC),							\
+   ((FAULT) = mem_access(mem, Read, addr, &SRC_V, sizeof(SRC_V))),	\
+   SRC_V)
+#define __WRITE_SPECMEM(SRC, DST, DST_V, FAULT)				\
+  (DST_V = (SRC), addr = (DST),						\
+   ((FAULT) = mem_access(mem, Write, addr, &DST_V, sizeof(DST_V))))
+
+/* traps execute on the timing thread */
+#undef SYSCALL
+#define SYSCALL(INST)							\
+  (panic("system call on the functional thread"), (void) 0)
+
+/* stop until the timing thread resumes the functional thread */
+static void
+func_park(void)
+{
+  FUNC_STORE(func_parked, TRUE);
+  while (FUNC_LOAD(func_parked))
+    sched_yield();
+}
+
+static void *
+func_main(void *arg)
+{
+  md_inst_t inst;			/* actual instruction bits */
+  enum md_opcode op;			/* decoded opcode enum */
+  md_addr_t target_PC;			/* actual next/target PC address */
+  md_addr_t addr;			/* effective address, if load/store */
+  byte_t temp_byte = 0;			/* temp variable for spec mem access */
+  half_t temp_half = 0;			/* " ditto " */
+  word_t temp_word = 0;			/* " ditto " */
+#if defined(HOST_HAS_QWORD) && defined(TARGET_ALPHA)
+  /* only the Alpha has quadword loads and stores */
+  qword_t temp_qword = 0;		/* " ditto " */
+#endif /* HOST_HAS_QWORD && TARGET_ALPHA */
+  enum md_fault_type fault;
+  struct func_rec *rec;
+
+  for (;;)
+    {
+      /* done once max_insts insts executed, the timing thread may need a
+	 few more, it executes them itself */
+      if (max_insts && func_num_insn >= max_insts)
+	break;
+
+      /* get the next instruction to execute */
+      MD_FETCH_INST(inst, mem, func_regs.regs_PC);
+      MD_SET_OPCODE(op, inst);
+
+      /* traps execute on the timing thread, in program order */
+      if (MD_OP_FLAGS(op) & F_TRAP)
+	{
+	  func_park();
+	  continue;
+	}
+
+      /* wait for room in the ring */
+      while (func_ring_tail - FUNC_LOAD(func_ring_head)
+	     == (unsigned int)func_ring_size)
+	sched_yield();
+
+      /* maintain $r0 semantics */
+      func_regs.regs_R[MD_REG_ZERO] = 0;
+#ifdef TARGET_ALPHA
+      func_regs.regs_F.d[MD_REG_ZERO] = 0.0;
+#endif /* TARGET_ALPHA */
+
+      /* set default next PC, reference address and fault */
+      func_regs.regs_NPC = func_regs.regs_PC + sizeof(md_inst_t);
+      target_PC = func_regs.regs_NPC;
+      addr = 0;
+      fault = md_fault_none;
+
+      /* execute the instruction */
+      switch (op)
+	{
+#define DEFINST(OP,MSK,NAME,OPFORM,RES,FLAGS,O1,O2,I1,I2,I3)		\
+	case OP:							\
+	  SYMCAT(OP,_IMPL);						\
+	  break;
+#define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
+	case OP:							\
+	  /* a bogus inst, a NOP to the timing model */		\
+	  break;
+#define CONNECT(OP)
+#undef DECLARE_FAULT
+#define DECLARE_FAULT(FAULT)						\
+	  { fault = (FAULT); break; }
+#include "machine.def"
+	default:
+	  /* a bogus inst, a NOP to the timing model */
+	  break;
+	}
+
+      /* record the outcome of the inst, and the registers a wrong path
+	 following it would start from */
+      rec = &func_ring[func_ring_tail & (func_ring_size - 1)];
+      rec->PC = func_regs.regs_PC;
+      rec->NPC = func_regs.regs_NPC;
+      rec->target_PC = target_PC;
+      rec->addr = addr;
+      rec->fault = fault;
+      if (MD_OP_FLAGS(op) & F_CTRL)
+	rec->regs = func_regs;
+      FUNC_STORE(func_ring_tail, func_ring_tail + 1);
+      func_num_insn++;
+
+      /* go to the next instruction */
+      func_regs.regs_PC = func_regs.regs_NPC;
+      func_regs.regs_NPC += sizeof(md_inst_t);
+    }
+
+  FUNC_STORE(func_done, TRUE);
+  FUNC_STORE(func_parked, TRUE);
+  return NULL;
+}
@@ -1026,6 +1026,105 @@ stat_find_stat(struct stat_sdb_t *sdb,	/* stat database */
   return stat;
 }
 
+/* save the values of all stat variables in stat database SDB to checkpoint
+   CK, or restore them from it; the database must register the same stats
+   as the one saved, formulas have no value of their own */
+void
+stat_chkpt(struct stat_sdb_t *sdb,	/* stat database */
+	   struct chkpt_t *ck)		/* checkpoint to save to or restore */
+{
+  int i, n;
+  struct stat_stat_t *stat;
+  struct bucket_t *bucket, **tail;
+  md_addr_t index;
+  unsigned int count;
+
+  for (stat = sdb->stats; stat != NULL; stat = stat->next)
+    {
+      chkpt_name(ck, stat->name);
+      chkpt_check(ck, "a stat class", stat->sc);
+
+      switch (stat->sc)
+	{
+	case sc_int:
+	  CHKPT_XFER(ck, *stat->variant.for_int.var);
+	  break;
+	case sc_uint:
+	  CHKPT_XFER(ck, *stat->variant.for_uint.var);
+	  break;
+#ifdef HOST_HAS_QWORD
+	case sc_qword:
+	  CHKPT_XFER(ck, *stat->variant.for_qword.var);
+	  break;
+	case sc_sqword:
+	  CHKPT_XFER(ck, *stat->variant.for_sqword.var);
+	  break;
+#endif /* HOST_HAS_QWORD */
+	case sc_float:
+	  CHKPT_XFER(ck, *stat->variant.for_float.var);
+	  break;
+	case sc_double:
+	  CHKPT_XFER(ck, *stat->variant.for_double.var);
+	  break;
+	case sc_dist:
+	  chkpt_check(ck, "a distribution size", stat->variant.for_dist.arr_sz);
+	  chkpt_xfer(ck, stat->variant.for_dist.arr,
+		     stat->variant.for_dist.arr_sz * sizeof(unsigned int));
+	  CHKPT_XFER(ck, stat->variant.for_dist.overflows);
+	  break;
+	case sc_sdist:
+	  /* the buckets of each hash chain in order, they print in that
+	     order */
+	  for (i=0; i<HTAB_SZ; i++)
+	    {
+	      n = 0;
+	      for (bucket = stat->variant.for_sdist.sarr[i];
+		   bucket != NULL;
+		   bucket = bucket->next)
+		n++;
+	      CHKPT_XFER(ck, n);
+
+	      if (!ck->restore)
+		{
+		  for (bucket = stat->variant.for_sdist.sarr[i];
+		       bucket != NULL;
+		       bucket = bucket->next)
+		    {
+		      CHKPT_XFER(ck, bucket->index);
+		      CHKPT_XFER(ck, bucket->count);
+		    }
+		  continue;
+		}
+
+	      while ((bucket = stat->variant.for_sdist.sarr[i]) != NULL)
+		{
+		  stat->variant.for_sdist.sarr[i] = bucket->next;
+		  free(bucket);
+		}
+	      for (tail = &stat->variant.for_sdist.sarr[i]; n > 0; n--)
+		{
+		  CHKPT_XFER(ck, index);
+		  CHKPT_XFER(ck, count);
+		  bucket = (struct bucket_t *)calloc(1, sizeof(struct bucket_t));
+		  if (!bucket)
+		    fatal("out of virtual memory");
+		  bucket->index = index;
+		  bucket->count = count;
+		  *tail = bucket;
+		  tail = &bucket->next;
+		}
+	    }
+	  break;
+	case sc_formula:
+	  /* nada */
+	  break;
+	default:
+	  panic("bogus stat class");
+	}
+    }
+  chkpt_name(ck, "end of stats");
+}
+
 #ifdef TESTIT
 
 void
@@ -55,6 +55,7 @@
 #include <stdio.h>
 
 #include "host.h"
+#include "chkpt.h"
 #include "machine.h"
 #include "eval.h"
 
@@ -328,5 +329,12 @@ stat_print_stats(struct stat_sdb_t *sdb,/* stat database */
 struct stat_stat_t *
 stat_find_stat(struct stat_sdb_t *sdb,	/* stat database */
 	       char *stat_name);	/* stat name */
+
+/* save the values of all stat variables in stat database SDB to checkpoint
+   CK, or restore them from it; the database must register the same stats
+   as the one saved, formulas have no value of their own */
+void
+stat_chkpt(struct stat_sdb_t *sdb,	/* stat database */
+	   struct chkpt_t *ck);		/* checkpoint to save to or restore */
 	       
 #endif /* STAT_H */
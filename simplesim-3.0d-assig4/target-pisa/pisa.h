@@ -201,8 +201,8 @@ extern md_inst_t MD_NOP_INST;
 
 /* fetch an instruction */
 #define MD_FETCH_INST(INST, MEM, PC)					\
-  { inst.a = MEM_READ_WORD(mem, (PC));					\
-    inst.b = MEM_READ_WORD(mem, (PC) + sizeof(word_t)); }
+  { (INST).a = MEM_READ_WORD((MEM), (PC));				\
+    (INST).b = MEM_READ_WORD((MEM), (PC) + sizeof(word_t)); }
 
 /*
  * target-dependent loader module configuration